@@ -23,3 +23,4 @@
 #include "source/kbextra/geometry.cpp"
 #include "source/kbextra/vertex.cpp"
 #include "source/kbextra/texture.cpp"
+#include "source/kbextra/pixel.cpp"
@@ -0,0 +1,45 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+#pragma once
+
+#include <kb/foundation/core.h>
+
+// A benchmark does its own setup, brackets the measured loop with
+// kb_bench_start and kb_bench_stop, then tears down. The harness picks
+// state->iterations so a run lasts at least the minimum run time and reports
+// nanoseconds per iteration across runs.
+
+typedef struct kb_bench_state {
+  uint64_t        iterations;
+  uint64_t        arg;
+  int64_t         start;
+  int64_t         elapsed;    // Nanoseconds between start and stop, accumulated
+} kb_bench_state;
+
+typedef void (*kb_bench_func)(kb_bench_state* state);
+
+void kb_bench_register  (const char* name, kb_bench_func func, uint64_t arg);
+void kb_bench_start     (kb_bench_state* state);
+void kb_bench_stop      (kb_bench_state* state);
+
+// Keeps the compiler from dropping a computation whose result is unused
+template <typename T>
+inline void kb_bench_keep(const T& value) {
+  asm volatile("" : : "r"(&value) : "memory");
+}
+
+struct kb_bench_registrar {
+  kb_bench_registrar(const char* name, kb_bench_func func, uint64_t arg) {
+    kb_bench_register(name, func, arg);
+  }
+};
+
+#define KB_BENCH_CONCAT_IMPL(_a, _b)  _a##_b
+#define KB_BENCH_CONCAT(_a, _b)       KB_BENCH_CONCAT_IMPL(_a, _b)
+
+#define KB_BENCH(_name, _func, _arg) \
+  static kb_bench_registrar KB_BENCH_CONCAT(bench_registrar_, __LINE__)(_name, _func, _arg)
@@ -0,0 +1,239 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+#include "bench.h"
+
+#include <kb/foundation/alloc.h>
+#include <kb/foundation/array.h>
+#include <kb/foundation/crt.h>
+#include <kb/foundation/freelist.h>
+#include <kb/foundation/hash.h>
+#include <kb/foundation/rand.h>
+#include <kb/foundation/sampler.h>
+#include <kb/foundation/table.h>
+#include <kb/foundation/thread.h>
+
+#define BENCH_TABLE_CAPACITY 4096
+
+KB_INTERNAL uint32_t* bench_random_keys(uint32_t count, uint32_t seed) {
+  kb_rng rng { seed };
+
+  uint32_t* keys = KB_DEFAULT_ALLOC_TYPE(uint32_t, count);
+  for (uint32_t i = 0; i < count; ++i) {
+    keys[i] = kb_rand_gen(&rng);
+  }
+
+  return keys;
+}
+
+// Fills the table to arg percent of its capacity
+KB_INTERNAL uint32_t bench_table_fill(kb_table* table, const uint32_t* keys, uint64_t load) {
+  uint32_t count = (uint32_t) (BENCH_TABLE_CAPACITY * load / 100);
+
+  kb_table_create(table, BENCH_TABLE_CAPACITY);
+  for (uint32_t i = 0; i < count; ++i) {
+    kb_table_insert(table, keys[i], i);
+  }
+
+  return count;
+}
+
+KB_INTERNAL void bench_table_lookup_hit(kb_bench_state* state) {
+  uint32_t* keys = bench_random_keys(BENCH_TABLE_CAPACITY, 1);
+
+  kb_table table {};
+  uint32_t count = bench_table_fill(&table, keys, state->arg);
+
+  kb_bench_start(state);
+  for (uint64_t i = 0; i < state->iterations; ++i) {
+    uint32_t handle = kb_table_get(&table, keys[i % count]);
+    kb_bench_keep(handle);
+  }
+  kb_bench_stop(state);
+
+  kb_table_destroy(&table);
+  KB_DEFAULT_FREE(keys);
+}
+
+KB_INTERNAL void bench_table_lookup_miss(kb_bench_state* state) {
+  uint32_t* keys    = bench_random_keys(BENCH_TABLE_CAPACITY, 1);
+  uint32_t* misses  = bench_random_keys(BENCH_TABLE_CAPACITY, 2);
+
+  kb_table table {};
+  bench_table_fill(&table, keys, state->arg);
+
+  kb_bench_start(state);
+  for (uint64_t i = 0; i < state->iterations; ++i) {
+    uint32_t handle = kb_table_get(&table, misses[i % BENCH_TABLE_CAPACITY]);
+    kb_bench_keep(handle);
+  }
+  kb_bench_stop(state);
+
+  kb_table_destroy(&table);
+  KB_DEFAULT_FREE(misses);
+  KB_DEFAULT_FREE(keys);
+}
+
+// One insert plus one remove per iteration, which keeps the load constant
+KB_INTERNAL void bench_table_insert_remove(kb_bench_state* state) {
+  uint32_t* keys    = bench_random_keys(BENCH_TABLE_CAPACITY, 1);
+  uint32_t* extra   = bench_random_keys(BENCH_TABLE_CAPACITY, 3);
+
+  kb_table table {};
+  bench_table_fill(&table, keys, state->arg);
+
+  kb_bench_start(state);
+  for (uint64_t i = 0; i < state->iterations; ++i) {
+    kb_hash key = extra[i % BENCH_TABLE_CAPACITY];
+    kb_table_insert(&table, key, UINT32_MAX - 1);
+    kb_table_remove(&table, key);
+  }
+  kb_bench_stop(state);
+
+  kb_table_destroy(&table);
+  KB_DEFAULT_FREE(extra);
+  KB_DEFAULT_FREE(keys);
+}
+
+KB_BENCH("kb_table_lookup_hit/load_25",       bench_table_lookup_hit,     25);
+KB_BENCH("kb_table_lookup_hit/load_50",       bench_table_lookup_hit,     50);
+KB_BENCH("kb_table_lookup_hit/load_75",       bench_table_lookup_hit,     75);
+KB_BENCH("kb_table_lookup_hit/load_90",       bench_table_lookup_hit,     90);
+KB_BENCH("kb_table_lookup_miss/load_25",      bench_table_lookup_miss,    25);
+KB_BENCH("kb_table_lookup_miss/load_50",      bench_table_lookup_miss,    50);
+KB_BENCH("kb_table_lookup_miss/load_75",      bench_table_lookup_miss,    75);
+KB_BENCH("kb_table_lookup_miss/load_90",      bench_table_lookup_miss,    90);
+KB_BENCH("kb_table_insert_remove/load_25",    bench_table_insert_remove,  25);
+KB_BENCH("kb_table_insert_remove/load_50",    bench_table_insert_remove,  50);
+KB_BENCH("kb_table_insert_remove/load_75",    bench_table_insert_remove,  75);
+KB_BENCH("kb_table_insert_remove/load_90",    bench_table_insert_remove,  90);
+
+// Grows an empty array to arg elements, per iteration
+KB_INTERNAL void bench_array_growth(kb_bench_state* state) {
+  kb_bench_start(state);
+  for (uint64_t i = 0; i < state->iterations; ++i) {
+    kb_array array {};
+    kb_array_create(&array, sizeof(uint32_t), 0);
+
+    for (uint32_t value = 0; value < state->arg; ++value) {
+      kb_array_push_back(&array, &value);
+    }
+
+    kb_bench_keep(array.data);
+    kb_array_destroy(&array);
+  }
+  kb_bench_stop(state);
+}
+
+KB_BENCH("kb_array_growth/16",                bench_array_growth,         16);
+KB_BENCH("kb_array_growth/1024",              bench_array_growth,         1024);
+KB_BENCH("kb_array_growth/65536",             bench_array_growth,         65536);
+
+KB_INTERNAL void bench_hash_string(kb_bench_state* state) {
+  char* str = KB_DEFAULT_ALLOC_TYPE(char, state->arg + 1);
+  kb_memset(str, 'a', state->arg);
+  str[state->arg] = '\0';
+
+  kb_bench_start(state);
+  for (uint64_t i = 0; i < state->iterations; ++i) {
+    kb_hash hash = kb_hash_string(str);
+    kb_bench_keep(hash);
+  }
+  kb_bench_stop(state);
+
+  KB_DEFAULT_FREE(str);
+}
+
+KB_BENCH("kb_hash_string/16",                 bench_hash_string,          16);
+KB_BENCH("kb_hash_string/64",                 bench_hash_string,          64);
+KB_BENCH("kb_hash_string/256",                bench_hash_string,          256);
+
+// Half full list, one take plus one free per iteration
+KB_INTERNAL void bench_freelist_take_free(kb_bench_state* state) {
+  kb_freelist freelist {};
+  kb_freelist_create(&freelist, (uint32_t) state->arg);
+
+  for (uint32_t i = 0; i < state->arg / 2; ++i) {
+    kb_freelist_take(&freelist);
+  }
+
+  kb_bench_start(state);
+  for (uint64_t i = 0; i < state->iterations; ++i) {
+    uint32_t handle = kb_freelist_take(&freelist);
+    kb_freelist_free(&freelist, handle);
+  }
+  kb_bench_stop(state);
+
+  kb_freelist_destroy(&freelist);
+}
+
+KB_BENCH("kb_freelist_take_free/1024",        bench_freelist_take_free,   1024);
+KB_BENCH("kb_freelist_take_free/65536",       bench_freelist_take_free,   65536);
+
+KB_INTERNAL void bench_sampler_push(kb_bench_state* state) {
+  kb_sampler sampler;
+  kb_sampler_create(&sampler, (uint32_t) state->arg);
+
+  kb_bench_start(state);
+  for (uint64_t i = 0; i < state->iterations; ++i) {
+    kb_sampler_push(&sampler, (float) (i & 1023));
+  }
+  kb_bench_stop(state);
+
+  kb_bench_keep(sampler.avg);
+  kb_sampler_destroy(&sampler);
+}
+
+KB_BENCH("kb_sampler_push/120",               bench_sampler_push,         120);
+KB_BENCH("kb_sampler_push/1024",              bench_sampler_push,         1024);
+
+KB_INTERNAL void bench_empty_job(void* userdata) {}
+
+// Submit plus execution of an empty job, the final wait is included
+KB_INTERNAL void bench_threadpool_add_job(kb_bench_state* state) {
+  kb_thread_pool* pool = kb_threadpool_create((int) state->arg);
+  kb_job_counter counter {};
+
+  kb_bench_start(state);
+  for (uint64_t i = 0; i < state->iterations; ++i) {
+    kb_threadpool_add_counted_job(pool, NULL, bench_empty_job, &counter);
+  }
+  kb_job_wait(pool, &counter);
+  kb_bench_stop(state);
+
+  kb_threadpool_destroy(pool);
+}
+
+KB_BENCH("kb_threadpool_add_job/1_thread",    bench_threadpool_add_job,   1);
+KB_BENCH("kb_threadpool_add_job/4_threads",   bench_threadpool_add_job,   4);
+
+KB_INTERNAL int bench_compare_u32(const void* a, const void* b) {
+  uint32_t ua = *(const uint32_t*) a;
+  uint32_t ub = *(const uint32_t*) b;
+  return (ua > ub) - (ua < ub);
+}
+
+KB_INTERNAL void bench_sort(kb_bench_state* state) {
+  uint32_t  count   = (uint32_t) state->arg;
+  uint32_t* source  = bench_random_keys(count, 1);
+  uint32_t* data    = KB_DEFAULT_ALLOC_TYPE(uint32_t, count);
+
+  for (uint64_t i = 0; i < state->iterations; ++i) {
+    kb_memcpy(data, source, count * sizeof(uint32_t));
+
+    kb_bench_start(state);
+    kb_sort(data, count, sizeof(uint32_t), bench_compare_u32);
+    kb_bench_stop(state);
+  }
+
+  kb_bench_keep(data[0]);
+  KB_DEFAULT_FREE(data);
+  KB_DEFAULT_FREE(source);
+}
+
+KB_BENCH("kb_sort/256",                       bench_sort,                 256);
+KB_BENCH("kb_sort/4096",                      bench_sort,                 4096);
+KB_BENCH("kb_sort/65536",                     bench_sort,                 65536);
@@ -0,0 +1,200 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+// Runs whole frames of a synthetic scene against the null graphics backend and
+// reports percentiles for each CPU phase: recording, bucketing plus sorting
+// plus submission (kb_graphics_run_encoders) and kb_graphics_frame itself.
+
+#include "frame_scene.h"
+
+#include <kb/foundation.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum frame_phase {
+  FRAME_PHASE_RECORD        = 0,
+  FRAME_PHASE_RUN_ENCODERS  = 1,
+  FRAME_PHASE_SORT          = 2,
+  FRAME_PHASE_SUBMIT        = 3,
+  FRAME_PHASE_FRAME         = 4,
+  FRAME_PHASE_TOTAL         = 5,
+  FRAME_PHASE_COUNT         = 6,
+} frame_phase;
+
+KB_INTERNAL const char* frame_phase_names[FRAME_PHASE_COUNT] = {
+  "record", "run_encoders", "sort", "submit", "frame", "total",
+};
+
+KB_INTERNAL double elapsed_us(int64_t start) {
+  return (double) (kb_time_get_raw() - start) * 1e-3;
+}
+
+KB_INTERNAL int compare_double(const void* a, const void* b) {
+  double da = *(const double*) a;
+  double db = *(const double*) b;
+  return (da > db) - (da < db);
+}
+
+KB_INTERNAL double percentile(const double* sorted, uint32_t count, double p) {
+  uint32_t index = (uint32_t) (p * (double) (count - 1) + 0.5);
+  return sorted[index];
+}
+
+KB_INTERNAL bool parse_u32(int argc, char** argv, int* i, const char* name, uint32_t* dst) {
+  if (strcmp(argv[*i], name) != 0 || *i + 1 >= argc) return false;
+
+  *dst = (uint32_t) atoi(argv[++*i]);
+  return true;
+}
+
+KB_INTERNAL void print_usage(const char* exe) {
+  fprintf(stderr, "usage: %s [--meshes N] [--materials N] [--text-lines N] [--gizmos N] [--encoders N]\n"
+                  "          [--frames N] [--warmup N] [--render-thread] [--out <file.json>]\n", exe);
+}
+
+int main(int argc, char** argv) {
+  frame_options options {};
+  options.meshes      = 2000;
+  options.materials   = 64;
+  options.text_lines  = 16;
+  options.gizmos      = 64;
+  options.encoders    = 4;
+  options.frames      = 1000;
+  options.warmup      = 60;
+
+  for (int i = 1; i < argc; ++i) {
+    if (parse_u32(argc, argv, &i, "--meshes",     &options.meshes))     continue;
+    if (parse_u32(argc, argv, &i, "--materials",  &options.materials))  continue;
+    if (parse_u32(argc, argv, &i, "--text-lines", &options.text_lines)) continue;
+    if (parse_u32(argc, argv, &i, "--gizmos",     &options.gizmos))     continue;
+    if (parse_u32(argc, argv, &i, "--encoders",   &options.encoders))   continue;
+    if (parse_u32(argc, argv, &i, "--frames",     &options.frames))     continue;
+    if (parse_u32(argc, argv, &i, "--warmup",     &options.warmup))     continue;
+
+    if (strcmp(argv[i], "--render-thread") == 0) {
+      options.render_thread = true;
+    } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+      options.out_path = argv[++i];
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (options.meshes == 0 || options.materials == 0 || options.frames == 0 || options.encoders == 0 || options.encoders >= KB_CONFIG_MAX_ENCODERS) {
+    fprintf(stderr, "meshes, materials and frames must be non-zero, encoders between 1 and %d\n", KB_CONFIG_MAX_ENCODERS - 1);
+    return 1;
+  }
+
+  kb_graphics_init_info init_info {};
+  init_info.resolution            = { 1920, 1080 };
+  init_info.render_thread         = options.render_thread;
+  frame_scene_init_info(&init_info, options);
+
+  kb_graphics_init(init_info);
+
+  frame_scene scene {};
+  frame_scene_create(&scene, options);
+
+  double* samples[FRAME_PHASE_COUNT];
+  for (uint32_t phase = 0; phase < FRAME_PHASE_COUNT; ++phase) {
+    samples[phase] = KB_DEFAULT_ALLOC_TYPE(double, options.frames);
+  }
+
+  kb_graphics_stats stats;
+
+  for (uint32_t frame = 0; frame < options.warmup + options.frames; ++frame) {
+    // Measured frames should not touch the heap, count anything that does
+    if (frame == options.warmup) kb_alloc_set_frame_mode(KB_ALLOC_FRAME_COUNT);
+
+    int64_t frame_start = kb_time_get_raw();
+
+    int64_t start = kb_time_get_raw();
+    frame_scene_record(&scene, options, frame);
+    double record_time = elapsed_us(start);
+
+    start = kb_time_get_raw();
+    kb_graphics_run_encoders();
+    double run_time = elapsed_us(start);
+
+    start = kb_time_get_raw();
+    kb_graphics_frame();
+    double frame_time = elapsed_us(start);
+
+    double total_time = elapsed_us(frame_start);
+
+    if (frame < options.warmup) continue;
+
+    // With a render thread submission overlaps recording, so its numbers
+    // come from the stats and lag one frame
+    kb_graphics_get_stats(&stats);
+
+    double sort_time    = 0.0;
+    double submit_time  = 0.0;
+    for (uint32_t pass_i = 0; pass_i < stats.pass_count; ++pass_i) {
+      sort_time   += stats.passes[pass_i].sort_time   * 1e6;
+      submit_time += stats.passes[pass_i].submit_time * 1e6;
+    }
+
+    uint32_t sample = frame - options.warmup;
+    samples[FRAME_PHASE_RECORD]       [sample] = record_time;
+    samples[FRAME_PHASE_RUN_ENCODERS] [sample] = options.render_thread ? stats.run_encoders_time * 1e6 : run_time;
+    samples[FRAME_PHASE_SORT]         [sample] = sort_time;
+    samples[FRAME_PHASE_SUBMIT]       [sample] = submit_time;
+    samples[FRAME_PHASE_FRAME]        [sample] = frame_time;
+    samples[FRAME_PHASE_TOTAL]        [sample] = total_time;
+  }
+
+  uint64_t allocations = kb_alloc_frame_total();
+  kb_alloc_set_frame_mode(KB_ALLOC_FRAME_OFF);
+
+  FILE* out = options.out_path ? fopen(options.out_path, "w") : stdout;
+  if (out == NULL) {
+    fprintf(stderr, "Could not open %s\n", options.out_path);
+    return 1;
+  }
+
+  fprintf(out, "{\n  \"context\": { \"meshes\": %u, \"materials\": %u, \"text_lines\": %u, \"gizmos\": %u, \"encoders\": %u, "
+               "\"frames\": %u, \"warmup\": %u, \"render_thread\": %s, \"draw_calls\": %u, \"allocations\": %llu },\n  \"phases\": [",
+    options.meshes, options.materials, options.text_lines, options.gizmos, options.encoders,
+    options.frames, options.warmup, options.render_thread ? "true" : "false", stats.draw_calls_used, (unsigned long long) allocations);
+
+  fprintf(stderr, "%-14s %10s %10s %10s %10s %10s   (us, %u frames, %u draw calls, %llu allocations)\n", "phase", "mean", "p50", "p90", "p99", "max",
+    options.frames, stats.draw_calls_used, (unsigned long long) allocations);
+
+  for (uint32_t phase = 0; phase < FRAME_PHASE_COUNT; ++phase) {
+    double* values = samples[phase];
+
+    double sum = 0.0;
+    for (uint32_t i = 0; i < options.frames; ++i) sum += values[i];
+
+    kb_sort(values, options.frames, sizeof(double), compare_double);
+
+    double mean = sum / options.frames;
+    double p50  = percentile(values, options.frames, 0.50);
+    double p90  = percentile(values, options.frames, 0.90);
+    double p99  = percentile(values, options.frames, 0.99);
+    double max  = values[options.frames - 1];
+
+    fprintf(out, "%s\n    { \"name\": \"%s\", \"unit\": \"us\", \"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f }",
+      phase == 0 ? "" : ",", frame_phase_names[phase], mean, p50, p90, p99, max);
+
+    fprintf(stderr, "%-14s %10.2f %10.2f %10.2f %10.2f %10.2f\n", frame_phase_names[phase], mean, p50, p90, p99, max);
+
+    KB_DEFAULT_FREE(values);
+  }
+
+  fprintf(out, "\n  ]\n}\n");
+
+  if (out != stdout) fclose(out);
+
+  frame_scene_destroy(&scene, options);
+  kb_graphics_deinit();
+
+  return 0;
+}
@@ -0,0 +1,62 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+#include "bench.h"
+
+#include <kb/graphics.h>
+
+#define BENCH_DRAW_CALLS 4096
+
+KB_INTERNAL kb_pipeline bench_pipeline;
+
+// Graphics is global state, set it up once against the null backend and keep
+// it for every run
+KB_INTERNAL void bench_graphics_init() {
+  static bool initialized = false;
+  if (initialized) return;
+
+  kb_graphics_init_info info {};
+  info.resolution           = { 1280, 720 };
+  info.pipe.pass_count      = 1;
+  info.capacity.draw_calls  = BENCH_DRAW_CALLS;
+
+  kb_graphics_init(info);
+
+  kb_pipeline_create_info pipeline_info {};
+  pipeline_info.pass        = 0;
+  pipeline_info.debug_label = "bench";
+
+  bench_pipeline = kb_pipeline_create(pipeline_info);
+  initialized = true;
+}
+
+// Encoders hold BENCH_DRAW_CALLS calls, the frame that drains them is not timed
+KB_INTERNAL void bench_encoder_submit_draw(kb_bench_state* state) {
+  bench_graphics_init();
+
+  uint64_t remaining = state->iterations;
+
+  while (remaining > 0) {
+    uint64_t batch = remaining < BENCH_DRAW_CALLS ? remaining : BENCH_DRAW_CALLS;
+
+    kb_encoder encoder = kb_encoder_begin();
+    kb_encoder_bind_pipeline(encoder, bench_pipeline);
+
+    kb_bench_start(state);
+    for (uint64_t i = 0; i < batch; ++i) {
+      kb_encoder_submit_draw(encoder, 0, 0, 36, (uint32_t) state->arg);
+    }
+    kb_bench_stop(state);
+
+    kb_encoder_end(encoder);
+    kb_graphics_run_encoders();
+    kb_graphics_frame();
+
+    remaining -= batch;
+  }
+}
+
+KB_BENCH("kb_encoder_submit_draw",            bench_encoder_submit_draw,  1);
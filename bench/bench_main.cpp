@@ -0,0 +1,181 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+#include "bench.h"
+
+#include <kb/foundation/crt.h>
+#include <kb/foundation/time.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define KB_BENCH_MAX_CASES  256
+#define KB_BENCH_MAX_RUNS   1024
+
+typedef struct bench_case {
+  const char*     name;
+  kb_bench_func   func;
+  uint64_t        arg;
+} bench_case;
+
+typedef struct bench_result {
+  uint64_t        iterations;
+  uint32_t        runs;
+  double          min;
+  double          max;
+  double          mean;
+  double          median;
+  double          stddev;
+} bench_result;
+
+KB_INTERNAL bench_case  bench_cases[KB_BENCH_MAX_CASES];
+KB_INTERNAL uint32_t    bench_case_count;
+
+void kb_bench_register(const char* name, kb_bench_func func, uint64_t arg) {
+  KB_ASSERT(bench_case_count < KB_BENCH_MAX_CASES, "Too many benchmarks");
+
+  bench_cases[bench_case_count++] = { name, func, arg };
+}
+
+void kb_bench_start(kb_bench_state* state) {
+  state->start = kb_time_get_raw();
+}
+
+void kb_bench_stop(kb_bench_state* state) {
+  state->elapsed += kb_time_get_raw() - state->start;
+}
+
+KB_INTERNAL int64_t bench_run_once(const bench_case& bench, uint64_t iterations) {
+  kb_bench_state state {};
+  state.iterations  = iterations;
+  state.arg         = bench.arg;
+
+  bench.func(&state);
+
+  return state.elapsed;
+}
+
+KB_INTERNAL int bench_compare_double(const void* a, const void* b) {
+  double da = *(const double*) a;
+  double db = *(const double*) b;
+  return (da > db) - (da < db);
+}
+
+// Doubles the iteration count until a run lasts min_time, which also warms
+// caches and the allocator
+KB_INTERNAL uint64_t bench_calibrate(const bench_case& bench, int64_t min_time) {
+  uint64_t iterations = 1;
+
+  while (true) {
+    int64_t elapsed = bench_run_once(bench, iterations);
+    if (elapsed >= min_time) return iterations;
+
+    // Jump close to the target once a run takes measurable time
+    uint64_t next     = iterations * 2;
+    uint64_t estimate = elapsed > 0 ? (uint64_t) ((double) iterations * (double) min_time * 1.2 / (double) elapsed) : 0;
+
+    if (estimate > next)            next = estimate;
+    if (next > iterations * 100)    next = iterations * 100;
+
+    iterations = next;
+  }
+}
+
+KB_INTERNAL bench_result bench_measure(const bench_case& bench, uint32_t runs, int64_t min_time) {
+  double samples[KB_BENCH_MAX_RUNS];
+
+  bench_result result {};
+  result.iterations = bench_calibrate(bench, min_time);
+  result.runs       = runs;
+
+  double sum = 0.0;
+  for (uint32_t run_i = 0; run_i < runs; ++run_i) {
+    samples[run_i] = (double) bench_run_once(bench, result.iterations) / (double) result.iterations;
+    sum += samples[run_i];
+  }
+
+  kb_sort(samples, runs, sizeof(double), bench_compare_double);
+
+  result.min    = samples[0];
+  result.max    = samples[runs - 1];
+  result.mean   = sum / runs;
+  result.median = runs % 2 ? samples[runs / 2] : (samples[runs / 2 - 1] + samples[runs / 2]) * 0.5;
+
+  double variance = 0.0;
+  for (uint32_t run_i = 0; run_i < runs; ++run_i) {
+    variance += (samples[run_i] - result.mean) * (samples[run_i] - result.mean);
+  }
+  result.stddev = runs > 1 ? sqrt(variance / (runs - 1)) : 0.0;
+
+  return result;
+}
+
+KB_INTERNAL void print_usage(const char* exe) {
+  fprintf(stderr, "usage: %s [--filter <substring>] [--runs <count>] [--min-time <ms>] [--out <file.json>]\n", exe);
+}
+
+int main(int argc, char** argv) {
+  const char* filter    = NULL;
+  const char* out_path  = NULL;
+  uint32_t    runs      = 10;
+  uint32_t    min_time  = 20;
+
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+
+    if      (strcmp(argv[i], "--filter")    == 0 && has_value) filter   = argv[++i];
+    else if (strcmp(argv[i], "--out")       == 0 && has_value) out_path = argv[++i];
+    else if (strcmp(argv[i], "--runs")      == 0 && has_value) runs     = (uint32_t) atoi(argv[++i]);
+    else if (strcmp(argv[i], "--min-time")  == 0 && has_value) min_time = (uint32_t) atoi(argv[++i]);
+    else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (runs == 0 || runs > KB_BENCH_MAX_RUNS) {
+    fprintf(stderr, "--runs must be between 1 and %d\n", KB_BENCH_MAX_RUNS);
+    return 1;
+  }
+
+  FILE* out = out_path ? fopen(out_path, "w") : stdout;
+  if (out == NULL) {
+    fprintf(stderr, "Could not open %s\n", out_path);
+    return 1;
+  }
+
+  fprintf(out, "{\n  \"context\": { \"runs\": %u, \"min_time_ms\": %u, \"tsc\": %s },\n  \"benchmarks\": [",
+    runs, min_time, kb_time_fast_is_tsc() ? "true" : "false");
+
+  fprintf(stderr, "%-40s %14s %12s %12s %12s %10s\n", "benchmark", "iterations", "median ns", "min ns", "max ns", "stddev %");
+
+  bool first = true;
+
+  for (uint32_t case_i = 0; case_i < bench_case_count; ++case_i) {
+    const bench_case& bench = bench_cases[case_i];
+    if (filter != NULL && strstr(bench.name, filter) == NULL) continue;
+
+    bench_result result = bench_measure(bench, runs, (int64_t) min_time * 1000000);
+
+    fprintf(out, "%s\n    { \"name\": \"%s\", \"iterations\": %llu, \"runs\": %u, \"unit\": \"ns/op\", "
+      "\"min\": %.3f, \"max\": %.3f, \"mean\": %.3f, \"median\": %.3f, \"stddev\": %.3f }",
+      first ? "" : ",", bench.name, (unsigned long long) result.iterations, result.runs,
+      result.min, result.max, result.mean, result.median, result.stddev);
+
+    fprintf(stderr, "%-40s %14llu %12.2f %12.2f %12.2f %10.2f\n", bench.name, (unsigned long long) result.iterations,
+      result.median, result.min, result.max, result.mean > 0.0 ? result.stddev / result.mean * 100.0 : 0.0);
+
+    first = false;
+  }
+
+  fprintf(out, "\n  ]\n}\n");
+
+  if (out != stdout) fclose(out);
+
+  return 0;
+}
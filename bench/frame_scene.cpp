@@ -0,0 +1,227 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+#include "frame_scene.h"
+
+#include <kb/foundation/alloc.h>
+#include <kb/foundation/crt.h>
+#include <kb/foundation/stream.h>
+
+#define FRAME_ATLAS_SIZE  64
+#define FRAME_FIRST_CHAR  32
+#define FRAME_LAST_CHAR   126
+
+KB_INTERNAL kb_pipeline create_pipeline(uint32_t pass, const char* label) {
+  kb_pipeline_create_info info {};
+  info.pass         = pass;
+  info.stages       = (kb_shader_stage) (KB_SHADER_STAGE_VERTEX | KB_SHADER_STAGE_FRAGMENT);
+  info.debug_label  = label;
+
+  return kb_pipeline_create(info);
+}
+
+// Cube sized vertex and index ranges shared by every mesh
+KB_INTERNAL void create_meshes(frame_scene* scene, const frame_options& options) {
+  scene->vertex_buffer = kb_buffer_create({
+    .rwops        = NULL,
+    .size         = 24 * sizeof(kb_simple_vertex),
+    .usage        = KB_BUFFER_USAGE_VERTEX_BUFFER,
+    .debug_label  = "frame bench vertices",
+  });
+
+  scene->index_buffer = kb_buffer_create({
+    .rwops        = NULL,
+    .size         = 36 * sizeof(uint32_t),
+    .usage        = KB_BUFFER_USAGE_INDEX_BUFFER,
+    .debug_label  = "frame bench indices",
+  });
+
+  kb_primitive_data primitive {};
+  primitive.vertex_count  = 24;
+  primitive.index_count   = 36;
+  primitive.material      = 0;
+
+  kb_mesh_set_capacity(options.meshes);
+  scene->meshes = KB_DEFAULT_ALLOC_TYPE(kb_mesh, options.meshes);
+
+  for (uint32_t i = 0; i < options.meshes; ++i) {
+    kb_mesh_create_info info {};
+    info.vertex_memory    = { scene->vertex_buffer, 0 };
+    info.index_memory     = { scene->index_buffer, 0 };
+    info.primitive_count  = 1;
+    info.primitives       = &primitive;
+    info.material_count   = 1;
+    info.materials        = &scene->materials[i % options.materials];
+
+    scene->meshes[i] = kb_mesh_create(info);
+  }
+}
+
+KB_INTERNAL void create_materials(frame_scene* scene, const frame_options& options) {
+  kb_float4 params[4] = {
+    { 1.0f, 1.0f, 1.0f, 1.0f },
+    { 0.5f, 0.5f, 0.5f, 1.0f },
+    { 0.0f, 0.0f, 0.0f, 0.0f },
+    { 1.0f, 0.0f, 0.0f, 0.0f },
+  };
+
+  kb_uniform_slot slot {};
+  slot.stage  = (kb_shader_stage) (KB_SHADER_STAGE_VERTEX | KB_SHADER_STAGE_FRAGMENT);
+  slot.type   = KB_BINDING_TYPE_UNIFORM_BUFFER;
+
+  kb_pipeline_set_capacity(options.materials + 2);
+  kb_material_set_capacity(options.materials);
+
+  scene->pipelines = KB_DEFAULT_ALLOC_TYPE(kb_pipeline, options.materials);
+  scene->materials = KB_DEFAULT_ALLOC_TYPE(kb_material, options.materials);
+
+  for (uint32_t i = 0; i < options.materials; ++i) {
+    scene->pipelines[i] = create_pipeline(0, "frame bench material");
+
+    kb_material_create_info info {};
+    info.pipeline             = scene->pipelines[i];
+    info.uniforms[0].slot     = slot;
+    info.uniforms[0].data     = params;
+    info.uniforms[0].size     = sizeof(params);
+
+    scene->materials[i] = kb_material_create(info);
+  }
+}
+
+// Monospaced printable ASCII, serialized and read back through the regular
+// font path
+KB_INTERNAL kb_font create_font(kb_pipeline pipeline) {
+  kb_font_data data {};
+  data.info.ascent        = 24;
+  data.info.descent       = -8;
+  data.info.line_gap      = 4;
+  data.info.scale_factor  = 1.0f;
+  data.info.pixel_height  = 32.0f;
+  data.info.padding       = 1.0f;
+  data.info.char_count    = FRAME_LAST_CHAR - FRAME_FIRST_CHAR + 1;
+  data.info.chars         = KB_DEFAULT_ALLOC_TYPE(kb_font_char, data.info.char_count);
+
+  for (uint32_t i = 0; i < data.info.char_count; ++i) {
+    kb_font_char& c = data.info.chars[i];
+    c = {};
+    c.codepoint     = FRAME_FIRST_CHAR + i;
+    c.advance       = 16;
+    c.rect          = { { (int) (i % 8) * 8, (int) (i / 8) * 8 }, { 8, 8 } };
+    c.bbox_from     = { 0, -24 };
+    c.bbox_to       = { 16, 8 };
+    c.uv_rect_from  = { (float) (i % 8) / 8.0f, (float) (i / 8) / 16.0f };
+    c.uv_rect_to    = { (float) (i % 8 + 1) / 8.0f, (float) (i / 8 + 1) / 16.0f };
+  }
+
+  data.atlas_bitmap_width   = FRAME_ATLAS_SIZE;
+  data.atlas_bitmap_height  = FRAME_ATLAS_SIZE;
+  data.atlas_bitmap_size    = FRAME_ATLAS_SIZE * FRAME_ATLAS_SIZE * 4;
+  data.atlas_bitmap         = KB_DEFAULT_ALLOC(data.atlas_bitmap_size);
+  kb_memset(data.atlas_bitmap, 0xff, data.atlas_bitmap_size);
+
+  int64_t serialized_size = 64 + sizeof(kb_font_char) * data.info.char_count + data.atlas_bitmap_size;
+  void* serialized = KB_DEFAULT_ALLOC(serialized_size);
+
+  kb_stream* stream = kb_stream_open_mem(serialized, serialized_size);
+  kb_font_data_write(&data, stream);
+  kb_stream_seek(stream, 0, KB_RWOPS_SEEK_BEG);
+
+  kb_uniform_slot atlas_slot {};
+  atlas_slot.stage  = KB_SHADER_STAGE_FRAGMENT;
+  atlas_slot.type   = KB_BINDING_TYPE_TEXTURE;
+
+  kb_font_create_info info {};
+  info.pipeline     = pipeline;
+  info.data         = stream;
+  info.atlas_slot   = atlas_slot;
+
+  kb_font font = kb_font_create(info);
+
+  kb_stream_close(stream);
+  KB_DEFAULT_FREE(serialized);
+  KB_DEFAULT_FREE(data.atlas_bitmap);
+  KB_DEFAULT_FREE(data.info.chars);
+
+  return font;
+}
+
+void frame_scene_init_info(kb_graphics_init_info* info, const frame_options& options) {
+  info->pipe.pass_count       = 2;
+  info->capacity.draw_calls   = options.meshes + options.text_lines + options.gizmos + 256;
+}
+
+void frame_scene_create(frame_scene* scene, const frame_options& options) {
+  create_materials(scene, options);
+  create_meshes(scene, options);
+
+  scene->text_pipeline  = create_pipeline(1, "frame bench text");
+  scene->gizmo_pipeline = create_pipeline(1, "frame bench gizmo");
+  scene->font           = create_font(scene->text_pipeline);
+
+  kb_gizmo_create(&scene->gizmo);
+}
+
+// Handles go back to their pools, so a scene can be created again after a
+// graphics restart
+void frame_scene_destroy(frame_scene* scene, const frame_options& options) {
+  kb_gizmo_destroy(&scene->gizmo);
+  kb_font_destroy(scene->font);
+  kb_pipeline_destroy(scene->gizmo_pipeline);
+  kb_pipeline_destroy(scene->text_pipeline);
+
+  for (uint32_t i = 0; i < options.meshes; ++i) {
+    kb_mesh_destroy(scene->meshes[i]);
+  }
+
+  for (uint32_t i = 0; i < options.materials; ++i) {
+    kb_material_destroy(scene->materials[i]);
+    kb_pipeline_destroy(scene->pipelines[i]);
+  }
+
+  kb_buffer_destroy(scene->index_buffer);
+  kb_buffer_destroy(scene->vertex_buffer);
+
+  KB_DEFAULT_FREE(scene->meshes);
+  KB_DEFAULT_FREE(scene->materials);
+  KB_DEFAULT_FREE(scene->pipelines);
+  *scene = {};
+}
+
+void frame_scene_record(frame_scene* scene, const frame_options& options, uint32_t frame) {
+  // Meshes are split evenly between encoders
+  uint32_t per_encoder = (options.meshes + options.encoders - 1) / options.encoders;
+
+  for (uint32_t encoder_i = 0; encoder_i < options.encoders; ++encoder_i) {
+    uint32_t first  = encoder_i * per_encoder;
+    uint32_t last   = first + per_encoder < options.meshes ? first + per_encoder : options.meshes;
+
+    kb_encoder encoder = kb_encoder_begin();
+    for (uint32_t mesh_i = first; mesh_i < last; ++mesh_i) {
+      kb_encoder_submit_mesh(encoder, scene->meshes[mesh_i], 1, true);
+    }
+    kb_encoder_end(encoder);
+  }
+
+  kb_encoder overlay = kb_encoder_begin();
+
+  char line[64];
+  for (uint32_t line_i = 0; line_i < options.text_lines; ++line_i) {
+    int32_t len = kb_snprintf(line, sizeof(line), "frame %u line %u: the quick brown fox", frame, line_i);
+    kb_encoder_submit_text(overlay, scene->font, line, (uint32_t) len, { 0.0f, (float) line_i * 0.05f }, { 0.05f, 0.05f }, { 0.0f, 0.0f }, { 0.0f, 0.0f }, 1);
+  }
+
+  kb_gizmo_begin(&scene->gizmo, overlay, scene->gizmo_pipeline);
+  for (uint32_t gizmo_i = 0; gizmo_i < options.gizmos; ++gizmo_i) {
+    kb_float3 center = { (float) gizmo_i, 0.0f, 0.0f };
+
+    kb_gizmo_set_color(&scene->gizmo, { 1.0f, 0.5f, 0.0f, 1.0f });
+    kb_gizmo_draw_aabb(&scene->gizmo, { center - kb_float3 { 0.5f, 0.5f, 0.5f }, center + kb_float3 { 0.5f, 0.5f, 0.5f } });
+    kb_gizmo_draw_circle(&scene->gizmo, { 0.0f, 1.0f, 0.0f }, center, 0.75f, 0.0f);
+  }
+  kb_gizmo_end(&scene->gizmo);
+
+  kb_encoder_end(overlay);
+}
@@ -0,0 +1,48 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+#pragma once
+
+// Synthetic scene shared by the frame benchmark and the steady state
+// allocation test: per-material pipelines, meshes sharing one cube, a few
+// lines of text and gizmo shapes drawn over them.
+
+#include <kb/graphics.h>
+
+#include <kbextra/font.h>
+#include <kbextra/gizmo.h>
+#include <kbextra/material.h>
+#include <kbextra/geometry.h>
+
+typedef struct frame_options {
+  uint32_t        meshes;
+  uint32_t        materials;
+  uint32_t        text_lines;
+  uint32_t        gizmos;
+  uint32_t        encoders;
+  uint32_t        frames;
+  uint32_t        warmup;
+  bool            render_thread;
+  const char*     out_path;
+} frame_options;
+
+typedef struct frame_scene {
+  kb_pipeline*    pipelines;
+  kb_material*    materials;
+  kb_mesh*        meshes;
+  kb_buffer       vertex_buffer;
+  kb_buffer       index_buffer;
+  kb_pipeline     text_pipeline;
+  kb_pipeline     gizmo_pipeline;
+  kb_font         font;
+  kb_gizmo        gizmo;
+} frame_scene;
+
+// Graphics capacity the scene needs, on top of the caller's settings
+void frame_scene_init_info    (kb_graphics_init_info* info, const frame_options& options);
+void frame_scene_create       (frame_scene* scene, const frame_options& options);
+void frame_scene_destroy      (frame_scene* scene, const frame_options& options);
+void frame_scene_record       (frame_scene* scene, const frame_options& options, uint32_t frame);
@@ -0,0 +1,75 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+// Graphics backend that records nothing, so the CPU side of the frontend can
+// be measured without a GPU. Buffers are backed by host memory so mapped
+// writes behave like they do on a real device.
+
+#include <kb/platform.h>
+#include <kb/foundation/alloc.h>
+
+KB_INTERNAL kb_int2   null_extent;
+KB_INTERNAL void**    null_buffers;
+KB_INTERNAL uint32_t  null_buffer_capacity;
+
+KB_API void kb_platform_graphics_init(const kb_graphics_init_info info) {
+  null_extent = info.resolution;
+  if (null_extent.x == 0 || null_extent.y == 0) null_extent = { 1280, 720 };
+}
+
+KB_API void kb_platform_graphics_deinit() {
+  for (uint32_t i = 0; i < null_buffer_capacity; ++i) {
+    KB_DEFAULT_FREE(null_buffers[i]);
+  }
+
+  KB_DEFAULT_FREE(null_buffers);
+  null_buffers          = NULL;
+  null_buffer_capacity  = 0;
+}
+
+KB_API void kb_platform_graphics_frame() {}
+
+KB_API kb_int2 kb_platform_graphics_surface_extent() {
+  return null_extent;
+}
+
+KB_API float kb_platform_graphics_surface_scale() {
+  return 1.0f;
+}
+
+KB_API void kb_platform_graphics_submit_render_pass(uint32_t pass, kb_render_call* calls, uint32_t call_count) {}
+KB_API void kb_platform_graphics_submit_compute_pass(uint32_t pass, kb_compute_call* calls, uint32_t call_count) {}
+
+KB_API void* kb_platform_graphics_buffer_mapped(kb_buffer_memory memory) {
+  return (uint8_t*) null_buffers[kb_to_arr(memory.buffer)] + memory.offset;
+}
+
+// Buffer storage grows with the handle range, like the resource allocator does
+KB_API void kb_platform_graphics_buffer_construct(kb_buffer handle, const kb_buffer_create_info info) {
+  uint32_t index = kb_to_arr(handle);
+
+  if (index >= null_buffer_capacity) {
+    uint32_t capacity = null_buffer_capacity * 2 > index + 1 ? null_buffer_capacity * 2 : index + 1;
+    null_buffers = KB_DEFAULT_REALLOC_TYPE(void*, null_buffers, capacity);
+
+    for (uint32_t i = null_buffer_capacity; i < capacity; ++i) {
+      null_buffers[i] = NULL;
+    }
+    null_buffer_capacity = capacity;
+  }
+
+  null_buffers[index] = KB_DEFAULT_ALLOC(info.size);
+}
+
+KB_API void kb_platform_graphics_buffer_destruct(kb_buffer handle) {
+  KB_DEFAULT_FREE(null_buffers[kb_to_arr(handle)]);
+  null_buffers[kb_to_arr(handle)] = NULL;
+}
+
+KB_API void kb_platform_graphics_pipeline_construct(kb_pipeline handle, const kb_pipeline_create_info info) {}
+KB_API void kb_platform_graphics_pipeline_destruct(kb_pipeline handle) {}
+KB_API void kb_platform_graphics_texture_construct(kb_texture handle, const kb_texture_create_info info) {}
+KB_API void kb_platform_graphics_texture_destruct(kb_texture handle) {}
@@ -7,7 +7,7 @@
 // #include <kb/graphics.h>
 #include <kb/input.h>
 #include <kb/log.h>
-#include <kb/time.h>
+#include <kb/foundation/time.h>
 #include <kb/platform.h>
 // #include <kb/geometry.h>
 // #include <kb/font.h>
@@ -20,6 +20,7 @@ const bool      hide_cursor       = false;
 const uint32_t  msaa              = 0;
 const kb_int2      resolution        = { 1600, 900 };
 const float     max_frametime     = 0.33f;
+const double    max_framerate     = 144.0; // Without vsync, zero for uncapped
 
 // int main(int argc, char** argv) {
 
@@ -44,7 +45,11 @@ int main(int argc, char** argv) {
   double current_time = kb_time();
   double accumulator = 0.0;
 
+  kb_frame_limiter limiter;
+  kb_frame_limiter_create(&limiter, vsync ? 0.0 : max_framerate, 120);
+
   while (!kb_platform_should_close()) {
+    kb_frame_limiter_wait(&limiter);
     kb_platform_pump_events();
 
     double new_time = kb_time();
@@ -66,6 +71,7 @@ int main(int argc, char** argv) {
   }
 
   kb_graphics_wait_device_idle();
+  kb_frame_limiter_destroy(&limiter);
   
   // kb_input_deinit();
   kb_graphics_deinit();
@@ -9,14 +9,21 @@
 #include "foundation/algo.h"
 #include "foundation/alloc.h"
 #include "foundation/array.h"
+#include "foundation/atomic.h"
 #include "foundation/build.h"
 #include "foundation/core.h"
 #include "foundation/crt.h"
 #include "foundation/freelist.h"
 #include "foundation/hash.h"
 #include "foundation/math.h"
+#include "foundation/metrics.h"
+#include "foundation/parallel.h"
+#include "foundation/profile.h"
 #include "foundation/rand.h"
 #include "foundation/resource.h"
+#include "foundation/sampler.h"
+#include "foundation/segmented_array.h"
+#include "foundation/sync.h"
 #include "foundation/table.h"
 #include "foundation/time.h"
 #include "foundation/thread.h"
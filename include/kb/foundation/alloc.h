@@ -20,6 +20,16 @@ typedef struct kb_alloc_stats {
   uint64_t        high_water_mark;
 } kb_alloc_stats;
 
+// Steady state frames should not touch the heap. Between two
+// kb_alloc_frame_mark calls, which kb_graphics_frame makes once per frame,
+// every allocation and reallocation is counted, or trapped with abort() in
+// any build type.
+typedef enum kb_alloc_frame_mode {
+  KB_ALLOC_FRAME_OFF    = 0,
+  KB_ALLOC_FRAME_COUNT  = 1,
+  KB_ALLOC_FRAME_TRAP   = 2,
+} kb_alloc_frame_mode;
+
 typedef struct kb_allocator {
   void* (*realloc) (struct kb_allocator*, void*, size_t, size_t);
   kb_alloc_stats  stats;
@@ -34,6 +44,12 @@ KB_API uint32_t kb_alloc_count              (kb_allocator* alloc);
 KB_API uint64_t kb_alloc_mem                (kb_allocator* alloc);
 KB_API uint64_t kb_alloc_high_water_mark    (kb_allocator* alloc);
 
+KB_API void     kb_alloc_set_frame_mode     (kb_alloc_frame_mode mode);
+KB_API void     kb_alloc_frame_mark         (void);
+// Allocations in the last complete frame, and in every frame since the mode was set
+KB_API uint64_t kb_alloc_frame_count        (void);
+KB_API uint64_t kb_alloc_frame_total        (void);
+
 #define KB_ALLOC(alloc, size)                               kb_alloc    (alloc, size,                      KB_DEFAULT_ALIGN, NULL, NULL)
 #define KB_ALLOC_ALIGN(alloc, size, align)                  kb_alloc    (alloc, size,                      align, NULL, NULL)
 #define KB_ALLOC_TYPE(alloc, type, count)           (type*) kb_alloc    (alloc, sizeof(type) * count,      KB_DEFAULT_ALIGN, NULL, NULL)
@@ -0,0 +1,95 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+#pragma once
+
+#include "core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Plain structs so atomics can be embedded and zero-initialized from C and
+// C++ alike. Access only through the functions below.
+typedef struct kb_atomic_u32 {
+  uint32_t          value;
+} kb_atomic_u32;
+
+typedef struct kb_atomic_u64 {
+  uint64_t          value;
+} kb_atomic_u64;
+
+typedef struct kb_atomic_ptr {
+  void*             value;
+} kb_atomic_ptr;
+
+#define KB_ATOMIC_FUNCS(_name, _type)                                                                               \
+  KB_API_INLINE _type kb_atomic_load_##_name(const kb_atomic_##_name* a) {                                          \
+    return __atomic_load_n(&a->value, __ATOMIC_SEQ_CST);                                                            \
+  }                                                                                                                 \
+  KB_API_INLINE _type kb_atomic_load_relaxed_##_name(const kb_atomic_##_name* a) {                                  \
+    return __atomic_load_n(&a->value, __ATOMIC_RELAXED);                                                            \
+  }                                                                                                                 \
+  KB_API_INLINE _type kb_atomic_load_acquire_##_name(const kb_atomic_##_name* a) {                                  \
+    return __atomic_load_n(&a->value, __ATOMIC_ACQUIRE);                                                            \
+  }                                                                                                                 \
+  KB_API_INLINE void kb_atomic_store_##_name(kb_atomic_##_name* a, _type v) {                                       \
+    __atomic_store_n(&a->value, v, __ATOMIC_SEQ_CST);                                                               \
+  }                                                                                                                 \
+  KB_API_INLINE void kb_atomic_store_relaxed_##_name(kb_atomic_##_name* a, _type v) {                               \
+    __atomic_store_n(&a->value, v, __ATOMIC_RELAXED);                                                               \
+  }                                                                                                                 \
+  KB_API_INLINE void kb_atomic_store_release_##_name(kb_atomic_##_name* a, _type v) {                               \
+    __atomic_store_n(&a->value, v, __ATOMIC_RELEASE);                                                               \
+  }                                                                                                                 \
+  KB_API_INLINE _type kb_atomic_exchange_##_name(kb_atomic_##_name* a, _type v) {                                   \
+    return __atomic_exchange_n(&a->value, v, __ATOMIC_SEQ_CST);                                                     \
+  }                                                                                                                 \
+  /* On failure `expected` receives the current value */                                                           \
+  KB_API_INLINE bool kb_atomic_cas_##_name(kb_atomic_##_name* a, _type* expected, _type desired) {                  \
+    return __atomic_compare_exchange_n(&a->value, expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);    \
+  }
+
+#define KB_ATOMIC_ARITH_FUNCS(_name, _type)                                                                         \
+  /* Fetch functions return the previous value */                                                                   \
+  KB_API_INLINE _type kb_atomic_fetch_add_##_name(kb_atomic_##_name* a, _type v) {                                  \
+    return __atomic_fetch_add(&a->value, v, __ATOMIC_SEQ_CST);                                                      \
+  }                                                                                                                 \
+  KB_API_INLINE _type kb_atomic_fetch_sub_##_name(kb_atomic_##_name* a, _type v) {                                  \
+    return __atomic_fetch_sub(&a->value, v, __ATOMIC_SEQ_CST);                                                      \
+  }                                                                                                                 \
+  KB_API_INLINE _type kb_atomic_fetch_or_##_name(kb_atomic_##_name* a, _type v) {                                   \
+    return __atomic_fetch_or(&a->value, v, __ATOMIC_SEQ_CST);                                                       \
+  }                                                                                                                 \
+  KB_API_INLINE _type kb_atomic_fetch_and_##_name(kb_atomic_##_name* a, _type v) {                                  \
+    return __atomic_fetch_and(&a->value, v, __ATOMIC_SEQ_CST);                                                      \
+  }
+
+KB_ATOMIC_FUNCS       (u32, uint32_t)
+KB_ATOMIC_FUNCS       (u64, uint64_t)
+KB_ATOMIC_FUNCS       (ptr, void*)
+KB_ATOMIC_ARITH_FUNCS (u32, uint32_t)
+KB_ATOMIC_ARITH_FUNCS (u64, uint64_t)
+
+#undef KB_ATOMIC_FUNCS
+#undef KB_ATOMIC_ARITH_FUNCS
+
+KB_API_INLINE void kb_atomic_fence(void) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+// Spin-wait hint
+KB_API_INLINE void kb_cpu_relax(void) {
+#if KB_CPU_X86
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -138,6 +138,25 @@
 #endif
 
 
+//#####################################################################################################################
+// SIMD
+//#####################################################################################################################
+
+
+#define KB_SIMD_SSE2  0
+#define KB_SIMD_NEON  0
+
+#if defined(__SSE2__)  \
+ || defined(_M_X64)    \
+ || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	undef  KB_SIMD_SSE2
+#	define KB_SIMD_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#	undef  KB_SIMD_NEON
+#	define KB_SIMD_NEON 1
+#endif
+
+
 //#####################################################################################################################
 // Arch
 //#####################################################################################################################
@@ -317,6 +336,7 @@
 #define KB_CONFIG_MAX_GEOMS                     512
 #define KB_CONFIG_MAX_AUDIO_TRACKS              512
 #define KB_CONFIG_MAX_DRAW_CALLS                512
+#define KB_CONFIG_MAX_METRICS                   256
 #define KB_CONFIG_TRANSIENT_BUFFER_SIZE         16 * 1024 * KB_CONFIG_MAX_DRAW_CALLS
 #define KB_CONFIG_STATS_SAMPLE_COUNT            120
 #define KB_CONFIG_GIZMO_CACHE_SIZE              4096
@@ -331,3 +351,14 @@
 # undef  KB_CONFIG_ALLOC_DEBUG
 # define KB_CONFIG_ALLOC_DEBUG 1
 #endif
+
+// Lock contention profiling for kb_mutex and kb_semaphore, off unless the
+// build asks for it
+#ifndef KB_CONFIG_LOCK_PROFILE
+# define KB_CONFIG_LOCK_PROFILE 0
+#endif
+
+// KB_PROFILE_* instrumentation macros, compiled out unless enabled
+#ifndef KB_CONFIG_PROFILE
+# define KB_CONFIG_PROFILE 0
+#endif
@@ -27,6 +27,16 @@ typedef int   (*kb_compare)(const void*, const void*);
 KB_API void     kb_memset             (void* dst, uint8_t ch, size_t count);
 KB_API void     kb_memcpy             (void* dst, const void* src, size_t count);
 KB_API void     kb_memcpy_with_stride (void* dst, const void* src, size_t count, size_t index, size_t stride, size_t offset);
+// Strided, gathered and scattered copies move 4, 8, 12 and 16 byte elements
+// as single fixed size moves, other sizes fall back to memcpy per element.
+// Interleave transposes equal 4 or 8 byte streams (two or four of 4 bytes, two
+// of 8) packed without padding in SIMD registers, anything else goes through
+// the strided copies a chunk of every stream at a time.
+KB_API void     kb_memcpy_strided     (void* dst, size_t dst_stride, const void* src, size_t src_stride, size_t elem_size, size_t count);
+KB_API void     kb_memcpy_gather      (void* dst, size_t dst_stride, const void* src, size_t src_stride, const uint32_t* indices, size_t elem_size, size_t count);
+KB_API void     kb_memcpy_scatter     (void* dst, size_t dst_stride, const void* src, size_t src_stride, const uint32_t* indices, size_t elem_size, size_t count);
+KB_API void     kb_interleave         (void* dst, size_t dst_stride, const void* const* srcs, const size_t* sizes, uint32_t stream_count, size_t count);
+KB_API void     kb_deinterleave       (void* const* dsts, const size_t* sizes, const void* src, size_t src_stride, uint32_t stream_count, size_t count);
 KB_API int      kb_strcmp             (const char* a, const char* b);
 KB_API uint64_t kb_strlen             (const char* a);
 KB_API char*    kb_strcpy             (char* dst, const char* src);
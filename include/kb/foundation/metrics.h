@@ -0,0 +1,83 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+#pragma once
+
+#include "core.h"
+#include "hash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Metrics are registered once by name and then updated through the returned
+// handle. Counters accumulate into a per-thread shard without atomic
+// read-modify-writes and are summed on read, gauges hold a single value.
+// kb_metric_frame snapshots every metric into a sampler, counters as their
+// change since the previous snapshot, kb_graphics_frame calls it once per
+// frame. Names must outlive the registry, string literals are best.
+// Adding to a counter takes a kb_thread_index, threads not started with
+// kb_thread_create must call kb_thread_unregister before they exit.
+
+typedef uint32_t kb_metric;
+
+typedef enum kb_metric_type {
+  KB_METRIC_COUNTER = 0,
+  KB_METRIC_GAUGE   = 1,
+} kb_metric_type;
+
+typedef struct kb_metric_info {
+  const char*       name;
+  kb_hash           hash;
+  kb_metric_type    type;
+  int64_t           value;    // Counter total or current gauge value
+  int64_t           frame;    // Value sampled by the last kb_metric_frame
+  float             avg;      // Over the last KB_CONFIG_STATS_SAMPLE_COUNT frames
+  float             min;
+  float             max;
+} kb_metric_info;
+
+KB_API kb_metric  kb_metric_register  (const char* name, kb_metric_type type);
+KB_API kb_metric  kb_metric_find      (kb_hash hash);
+KB_API void       kb_metric_add       (kb_metric metric, int64_t value);
+KB_API void       kb_metric_set       (kb_metric metric, int64_t value);
+KB_API int64_t    kb_metric_value     (kb_metric metric);
+
+KB_API void       kb_metric_frame     (void);
+
+// Handles are dense, iterate with 0 <= metric < kb_metric_count()
+KB_API uint32_t   kb_metric_count     (void);
+KB_API void       kb_metric_get_info  (kb_metric metric, kb_metric_info* dst);
+KB_API void       kb_metric_dump      (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define KB_METRIC_INVALID UINT32_MAX
+
+#ifdef __cplusplus
+
+namespace kb {
+  struct counter {
+    counter(const char* name) : id(kb_metric_register(name, KB_METRIC_COUNTER)) {}
+    void add(int64_t value = 1) { kb_metric_add(id, value); }
+    int64_t value() const       { return kb_metric_value(id); }
+
+    kb_metric id;
+  };
+
+  struct gauge {
+    gauge(const char* name) : id(kb_metric_register(name, KB_METRIC_GAUGE)) {}
+    void set(int64_t value)     { kb_metric_set(id, value); }
+    void add(int64_t value)     { kb_metric_add(id, value); }
+    int64_t value() const       { return kb_metric_value(id); }
+
+    kb_metric id;
+  };
+};
+
+#endif
@@ -0,0 +1,76 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+#pragma once
+
+#include "core.h"
+#include "thread.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Range is split into chunks of `grain` elements (0 picks one from the pool
+// size). The calling thread runs chunks too, so these are safe to call from
+// inside a pool job. A NULL pool runs everything on the calling thread.
+// Reduce, prefix sum and sort scratch is kept per calling thread and reused,
+// the largest size seen stays allocated until that thread exits.
+
+typedef void(*kb_parallel_for_func)     (uint64_t begin, uint64_t end, void* userdata);
+typedef void(*kb_parallel_reduce_func)  (uint64_t begin, uint64_t end, void* partial, void* userdata);
+typedef void(*kb_parallel_combine_func) (void* dst, const void* src, void* userdata);
+
+KB_API void     kb_parallel_for             (kb_thread_pool* pool, uint64_t count, uint64_t grain, kb_parallel_for_func func, void* userdata);
+KB_API void     kb_parallel_reduce          (kb_thread_pool* pool, uint64_t count, uint64_t grain, void* result, uint64_t result_size, kb_parallel_reduce_func func, kb_parallel_combine_func combine, void* userdata);
+KB_API uint64_t kb_parallel_prefix_sum_u32  (kb_thread_pool* pool, uint32_t* dst, const uint32_t* src, uint64_t count);
+KB_API uint64_t kb_parallel_prefix_sum_u64  (kb_thread_pool* pool, uint64_t* dst, const uint64_t* src, uint64_t count);
+KB_API void     kb_parallel_sort_u32        (kb_thread_pool* pool, uint32_t* data, uint64_t count);
+KB_API void     kb_parallel_sort_u64        (kb_thread_pool* pool, uint64_t* data, uint64_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __cplusplus
+
+#include <type_traits>
+
+namespace kb {
+  template <typename F>
+  void parallel_for(kb_thread_pool* pool, uint64_t count, uint64_t grain, F&& func) {
+    kb_parallel_for(pool, count, grain, [](uint64_t begin, uint64_t end, void* userdata) {
+      (*(typename std::remove_reference<F>::type*) userdata)(begin, end);
+    }, (void*) &func);
+  }
+
+  // `partial` starts as a copy of `identity` for every chunk and chunk results
+  // are combined in range order, so non-commutative combines are fine.
+  template <typename T, typename F, typename C>
+  T parallel_reduce(kb_thread_pool* pool, uint64_t count, uint64_t grain, const T& identity, F&& func, C&& combine) {
+    static_assert(std::is_trivially_copyable<T>::value, "Reduce value must be trivially copyable");
+
+    struct ctx_t {
+      typename std::remove_reference<F>::type* func;
+      typename std::remove_reference<C>::type* combine;
+    } ctx { &func, &combine };
+
+    T result = identity;
+
+    kb_parallel_reduce(pool, count, grain, &result, sizeof(T),
+      [](uint64_t begin, uint64_t end, void* partial, void* userdata) {
+        (*((ctx_t*) userdata)->func)(begin, end, *(T*) partial);
+      },
+      [](void* dst, const void* src, void* userdata) {
+        (*((ctx_t*) userdata)->combine)(*(T*) dst, *(const T*) src);
+      },
+      &ctx
+    );
+
+    return result;
+  }
+};
+
+#endif
@@ -0,0 +1,69 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+#pragma once
+
+#include "core.h"
+#include "stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Each thread records into its own buffer, nothing is shared on the hot path.
+// Names are stored as pointers and must outlive the capture, string literals
+// are best. Recording only happens between kb_profile_start and
+// kb_profile_stop, starting a capture discards the previous one.
+//
+// The first event on a thread allocates its buffer, 128 KB for 4096 events,
+// growing in steps of the same size to at most 32 MB. Buffers are kept
+// between captures. Once a thread has exited its buffer goes to the next
+// thread that starts recording after a kb_profile_start.
+
+KB_API void     kb_profile_start            (void);
+KB_API void     kb_profile_stop             (void);
+KB_API bool     kb_profile_is_capturing     (void);
+
+KB_API void     kb_profile_begin            (const char* name);
+KB_API void     kb_profile_end              (void);
+KB_API void     kb_profile_frame_mark       (void);
+KB_API void     kb_profile_counter          (const char* name, double value);
+KB_API void     kb_profile_set_thread_name  (const char* name);
+
+// Chrome trace event JSON, loads in chrome://tracing and Perfetto
+KB_API bool     kb_profile_write_json       (kb_stream* dst);
+// Compact form, see profile.cpp for the layout
+KB_API bool     kb_profile_write_binary     (kb_stream* dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __cplusplus
+
+namespace kb {
+  struct profile_scope {
+    profile_scope(const char* name) { kb_profile_begin(name); }
+    ~profile_scope()                { kb_profile_end(); }
+  };
+};
+
+#define KB_PROFILE_CONCAT_IMPL(_a, _b)  _a##_b
+#define KB_PROFILE_CONCAT(_a, _b)       KB_PROFILE_CONCAT_IMPL(_a, _b)
+
+#if KB_CONFIG_PROFILE
+# define KB_PROFILE_SCOPE(_name)              kb::profile_scope KB_PROFILE_CONCAT(profile_scope_, __LINE__)(_name)
+# define KB_PROFILE_FRAME_MARK()              kb_profile_frame_mark()
+# define KB_PROFILE_COUNTER(_name, _value)    kb_profile_counter(_name, _value)
+# define KB_PROFILE_THREAD_NAME(_name)        kb_profile_set_thread_name(_name)
+#else
+# define KB_PROFILE_SCOPE(_name)              ((void) 0)
+# define KB_PROFILE_FRAME_MARK()              ((void) 0)
+# define KB_PROFILE_COUNTER(_name, _value)    ((void) 0)
+# define KB_PROFILE_THREAD_NAME(_name)        ((void) 0)
+#endif
+
+#endif
@@ -6,9 +6,11 @@
 
 #pragma once
 
+#include "alloc.h"
 #include "freelist.h"
 #include "table.h"
 #include "crt.h"
+#include "segmented_array.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -26,38 +28,85 @@ extern "C" {
   handle_t kb_##t_name##_create(const create_info_t info);                     \
   void     kb_##t_name##_destroy(handle_t handle);                             \
   uint32_t kb_##t_name##_count(void);                                          \
+  uint32_t kb_##t_name##_capacity(void);                                       \
+  void     kb_##t_name##_set_capacity(uint32_t capacity);                      \
   void     kb_##t_name##_purge(void);                                          \
   void     kb_##t_name##_construct(handle_t h, const create_info_t info);      \
   void     kb_##t_name##_destruct(handle_t h);                                 \
   bool     kb_##t_name##_is_initialized(handle_t h);
   
-#define KB_RESOURCE_STORAGE_DEF(t_name, handle_t, ref_t, cap)                  \
-  ref_t t_name##_refs [cap];                                                   \
+// Storage grows block by block when construct calls t_name##_ref_create,
+// so pointers returned by t_name##_ref stay valid when new handles are added.
+// t_name##_ref is a plain lookup and never grows the storage.
+#define KB_RESOURCE_STORAGE_DEF(t_name, handle_t, ref_t)                       \
+  kb::segmented_array<ref_t, 64> t_name##_refs;                                \
+  ref_t* t_name##_ref_create(handle_t handle) {                                \
+    while (t_name##_refs.count() <= handle.idx) t_name##_refs.push_back({});   \
+    t_name##_refs[handle.idx] = {};                                            \
+    return &t_name##_refs[handle.idx];                                         \
+  }                                                                            \
   ref_t* t_name##_ref(handle_t handle) {                                       \
-    return &t_name##_refs[handle.idx + 1];                                     \
+    KB_ASSERT(handle.idx < t_name##_refs.count(), "Invalid handle");           \
+    return &t_name##_refs[handle.idx];                                         \
   }
-  
+
 #ifdef __cplusplus
 }
 #endif
 
 #ifdef __cplusplus
 
-template <typename kb_handle, typename create_info_t, uint16_t cap>
+// Nothing is allocated until first use or an explicit set_capacity, so unused
+// resource types cost nothing and capacities can be picked at startup.
+template <typename kb_handle, typename create_info_t, uint32_t default_cap>
 struct kb_resource_slot_allocator {
-  kb_resource_slot_allocator() {
-    kb_table_create     (&table, cap);
-    kb_freelist_create  (&freelist, cap);
-  }
-
   ~kb_resource_slot_allocator() {
+    if (capacity == 0) return;
+
     kb_table_destroy     (&table);
     kb_freelist_destroy  (&freelist);
+    KB_DEFAULT_FREE      (initialized);
+  }
+
+  void ensure() {
+    if (capacity == 0) reserve(default_cap);
+  }
+
+  // Grows in place, live handles and hashes are kept
+  void reserve(uint32_t new_cap) {
+    if (new_cap <= capacity) return;
+
+    kb_freelist new_freelist;
+    kb_freelist_create(&new_freelist, new_cap);
+
+    kb_table new_table;
+    kb_table_create(&new_table, new_cap);
+
+    if (capacity > 0) {
+      kb_memcpy(kb_freelist_get_dense(&new_freelist),   kb_freelist_get_dense(&freelist),   sizeof(uint32_t) * capacity);
+      kb_memcpy(kb_freelist_get_sparse(&new_freelist),  kb_freelist_get_sparse(&freelist),  sizeof(uint32_t) * capacity);
+      new_freelist.pos = freelist.pos;
+
+      for (uint32_t i = 0; i < table.capacity; ++i) {
+        if (table.handles[i] != UINT32_MAX) kb_table_insert(&new_table, table.keys[i], table.handles[i]);
+      }
+
+      kb_freelist_destroy (&freelist);
+      kb_table_destroy    (&table);
+    }
+
+    initialized = KB_DEFAULT_REALLOC_TYPE(bool, initialized, new_cap);
+    kb_memset(initialized + capacity, 0, sizeof(bool) * (new_cap - capacity));
+
+    freelist  = new_freelist;
+    table     = new_table;
+    capacity  = new_cap;
   }
 
-  kb_freelist   freelist;
-  kb_table      table;
-  bool          initialized[cap] = { false };
+  uint32_t      capacity    = 0;
+  kb_freelist   freelist    = {};
+  kb_table      table       = {};
+  bool*         initialized = nullptr;
 };
 
 
@@ -67,6 +116,7 @@ struct kb_resource_slot_allocator {
     kb_table_remove(&(t_name##_data.table), kb_to_arr(handle));                   \
   }                                                                               \
   handle_t kb_##t_name##_allocate() {                                             \
+    t_name##_data.ensure();                                                       \
     return (handle_t){ kb_freelist_take(&(t_name##_data.freelist)) + 1 };         \
   }                                                                               \
   void kb_##t_name##_free(handle_t handle) {                                      \
@@ -85,6 +135,12 @@ struct kb_resource_slot_allocator {
   uint32_t kb_##t_name##_count() {                                                \
     return kb_freelist_count(&(t_name##_data.freelist));                          \
   }                                                                               \
+  uint32_t kb_##t_name##_capacity() {                                             \
+    return t_name##_data.capacity;                                                \
+  }                                                                               \
+  void kb_##t_name##_set_capacity(uint32_t capacity) {                            \
+    t_name##_data.reserve(capacity);                                              \
+  }                                                                               \
   void kb_##t_name##_purge() {                                                    \
     uint32_t* dense = kb_freelist_get_dense(&t_name##_data.freelist);             \
     uint32_t count = kb_##t_name##_count();                                       \
@@ -95,6 +151,7 @@ struct kb_resource_slot_allocator {
 
 #define KB_RESOURCE_DATA_HASHED_DEF(t_name, handle_t)                             \
   void kb_##t_name##_mark(handle_t handle, kb_hash _hash) {                       \
+    t_name##_data.ensure();                                                       \
     kb_table_insert(&(t_name##_data.table), _hash, kb_to_arr(handle));            \
   }                                                                               \
   bool kb_##t_name##_has(kb_hash _hash) {                                         \
@@ -110,9 +167,11 @@ struct kb_resource_slot_allocator {
     return handle;                                                                \
   }                                                                               \
   bool kb_##t_name##_is_initialized(handle_t handle) {                            \
+    if (kb_to_arr(handle) >= t_name##_data.capacity) return false;                \
     return t_name##_data.initialized[kb_to_arr(handle)];                          \
   }                                                                               \
   void kb_##t_name##_set_initialized(handle_t handle, bool value) {               \
+    KB_ASSERT(kb_to_arr(handle) < t_name##_data.capacity, "Invalid handle");      \
     t_name##_data.initialized[kb_to_arr(handle)] = value;                         \
   }
 
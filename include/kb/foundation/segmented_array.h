@@ -0,0 +1,146 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+#pragma once
+
+#include "core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Array made of fixed size power-of-two blocks. Growing allocates a new block
+// and never moves existing elements, so element addresses stay stable.
+typedef struct kb_segmented_array {
+  uint64_t  elem_size;
+  uint32_t  block_shift;
+  uint32_t  block_count;
+  uint32_t  block_cap;
+  uint64_t  pos;
+  void**    blocks;
+} kb_segmented_array;
+
+KB_API void     kb_segmented_array_create     (kb_segmented_array* array, uint64_t elem_size, uint64_t block_size);
+KB_API void     kb_segmented_array_destroy    (kb_segmented_array* array);
+KB_API void     kb_segmented_array_reset      (kb_segmented_array* array);
+
+KB_API uint64_t kb_segmented_array_count      (const kb_segmented_array* array);
+KB_API uint64_t kb_segmented_array_capacity   (const kb_segmented_array* array);
+KB_API uint64_t kb_segmented_array_block_size (const kb_segmented_array* array);
+KB_API void     kb_segmented_array_reserve    (kb_segmented_array* array, uint64_t size);
+KB_API void     kb_segmented_array_resize     (kb_segmented_array* array, uint64_t size);
+KB_API void*    kb_segmented_array_at         (const kb_segmented_array* array, uint64_t index);
+KB_API void*    kb_segmented_array_back       (kb_segmented_array* array);
+KB_API void*    kb_segmented_array_push_back  (kb_segmented_array* array, const void* data);
+KB_API void     kb_segmented_array_pop_back   (kb_segmented_array* array);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __cplusplus
+
+#include <new>
+
+namespace kb {
+  template <typename T, uint64_t BlockSize = 256>
+  class segmented_array: public kb_segmented_array {
+  public:
+    segmented_array() {
+      kb_segmented_array_create(this, sizeof(T), BlockSize);
+    }
+
+    ~segmented_array() {
+      clear();
+      kb_segmented_array_destroy(this);
+    }
+
+    segmented_array(const segmented_array& other): segmented_array() {
+      reserve(other.count());
+      for (uint64_t i = 0; i < other.count(); ++i) {
+        this->push_back(other[i]);
+      }
+    }
+
+    segmented_array& operator=(const segmented_array& other) {
+      if (this == &other) return *this;
+
+      clear();
+      reserve(other.count());
+      for (uint64_t i = 0; i < other.count(); ++i) {
+        this->push_back(other[i]);
+      }
+
+      return *this;
+    }
+
+    uint64_t capacity() const {
+      return kb_segmented_array_capacity(this);
+    }
+
+    uint64_t count() const {
+      return kb_segmented_array_count(this);
+    }
+
+    void reserve(uint64_t size) {
+      kb_segmented_array_reserve(this, size);
+    }
+
+    T& push_back(const T& value) {
+      kb_segmented_array_reserve(this, pos + 1);
+      T* elem = new (kb_segmented_array_at(this, pos)) T(value);
+      pos++;
+      return *elem;
+    }
+
+    void pop_back() {
+      back().~T();
+      kb_segmented_array_pop_back(this);
+    }
+
+    void clear() {
+      for (uint64_t i = 0; i < pos; ++i) {
+        (*this)[i].~T();
+      }
+      pos = 0;
+    }
+
+    T& operator[](uint64_t idx) {
+      return *(T*) kb_segmented_array_at(this, idx);
+    }
+
+    const T& operator[](uint64_t idx) const {
+      return *(const T*) kb_segmented_array_at(this, idx);
+    }
+
+    T& at(uint64_t idx) {
+      return (*this)[idx];
+    }
+
+    const T& at(uint64_t idx) const {
+      return (*this)[idx];
+    }
+
+    T& back() {
+      return *(T*) kb_segmented_array_back(this);
+    }
+
+    const T& back() const {
+      return *(const T*) kb_segmented_array_at(this, pos - 1);
+    }
+
+    template <typename F>
+    void for_each_block(F func) {
+      const uint64_t block_size = kb_segmented_array_block_size(this);
+      for (uint64_t first = 0; first < pos; first += block_size) {
+        const uint64_t n = pos - first < block_size ? pos - first : block_size;
+        func((T*) kb_segmented_array_at(this, first), n);
+      }
+    }
+  };
+};
+
+#endif
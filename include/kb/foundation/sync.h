@@ -0,0 +1,83 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+#pragma once
+
+#include "core.h"
+#include "atomic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Synchronization primitives built on a single atomic word and a futex. All of
+// them are plain structs meant to be embedded; zero-initialized is unlocked,
+// empty or unsignaled, and none of them need to be destroyed.
+
+typedef struct kb_spinlock {
+  kb_atomic_u32     state;
+} kb_spinlock;
+
+// Spins briefly, then sleeps on a futex. Unlock only enters the kernel when
+// someone is actually sleeping.
+typedef struct kb_lock {
+  kb_atomic_u32     state;
+} kb_lock;
+
+typedef struct kb_counting_semaphore {
+  kb_atomic_u32     count;
+  kb_atomic_u32     waiters;
+} kb_counting_semaphore;
+
+// Writer preferring, readers back off once a writer is waiting. Not
+// recursive, a thread holding a read lock must not take it again.
+typedef struct kb_rwlock {
+  kb_atomic_u32     state;
+  kb_atomic_u32     writers_waiting;
+} kb_rwlock;
+
+// Signaled once, wakes every current and future waiter
+typedef struct kb_event {
+  kb_atomic_u32     state;
+} kb_event;
+
+// kb_futex_wait sleeps only while *addr == expected and may return spuriously,
+// callers recheck their word in a loop. Outside Linux every address shares one
+// mutex and condition variable, so any wake is a broadcast to all sleepers in
+// the process. Correct, but wakes cost more the more threads are sleeping.
+KB_API void   kb_futex_wait                   (kb_atomic_u32* addr, uint32_t expected);
+KB_API void   kb_futex_wake                   (kb_atomic_u32* addr, uint32_t count);
+KB_API void   kb_futex_wake_all               (kb_atomic_u32* addr);
+
+KB_API void   kb_spinlock_init                (kb_spinlock* lock);
+KB_API void   kb_spinlock_lock                (kb_spinlock* lock);
+KB_API bool   kb_spinlock_try_lock            (kb_spinlock* lock);
+KB_API void   kb_spinlock_unlock              (kb_spinlock* lock);
+
+KB_API void   kb_lock_init                    (kb_lock* lock);
+KB_API void   kb_lock_lock                    (kb_lock* lock);
+KB_API bool   kb_lock_try_lock                (kb_lock* lock);
+KB_API void   kb_lock_unlock                  (kb_lock* lock);
+
+KB_API void   kb_counting_semaphore_init      (kb_counting_semaphore* sem, uint32_t count);
+KB_API void   kb_counting_semaphore_post      (kb_counting_semaphore* sem, uint32_t count);
+KB_API void   kb_counting_semaphore_wait      (kb_counting_semaphore* sem);
+KB_API bool   kb_counting_semaphore_try_wait  (kb_counting_semaphore* sem);
+
+KB_API void   kb_rwlock_init                  (kb_rwlock* lock);
+KB_API void   kb_rwlock_read_lock             (kb_rwlock* lock);
+KB_API void   kb_rwlock_read_unlock           (kb_rwlock* lock);
+KB_API void   kb_rwlock_write_lock            (kb_rwlock* lock);
+KB_API void   kb_rwlock_write_unlock          (kb_rwlock* lock);
+
+KB_API void   kb_event_init                   (kb_event* event);
+KB_API void   kb_event_signal                 (kb_event* event);
+KB_API void   kb_event_wait                   (kb_event* event);
+KB_API bool   kb_event_is_signaled            (kb_event* event);
+
+#ifdef __cplusplus
+}
+#endif
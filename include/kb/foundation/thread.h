@@ -6,10 +6,16 @@
 
 #pragma once
 
+#include "core.h"
+#include "atomic.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define KB_MAX_THREADS    64
+#define KB_MAX_TLS_SLOTS  32
+
 typedef struct kb_mutex       kb_mutex;
 typedef struct kb_semaphore   kb_semaphore;
 typedef struct kb_thread      kb_thread;
@@ -17,11 +23,72 @@ typedef struct kb_thread_pool kb_thread_pool;
 
 typedef void(*kb_job_func)(void*);
 
+// Lanes are served high to low. Background jobs never occupy every worker,
+// so frame critical work always has a thread to run on. The exception is a
+// pool with a single worker: it does run background jobs, otherwise they would
+// only make progress when someone waits on them. While one runs there, other
+// jobs only run on threads waiting for them.
+typedef enum kb_job_priority {
+  KB_JOB_PRIORITY_NORMAL  = 0,
+  KB_JOB_PRIORITY_HIGH    = 1,
+  KB_JOB_PRIORITY_LOW     = 2,
+  KB_JOB_PRIORITY_COUNT   = 3
+} kb_job_priority;
+
+// Completion counter for a group of jobs. Zero-initialized counters are ready
+// to use and can live on the stack or inside other structs. Only reuse a
+// counter once it has been waited on.
+typedef struct kb_job_counter {
+  kb_atomic_u32     value;          // Jobs not yet finished
+  kb_atomic_u32     busy;           // Jobs currently retiring from this counter
+  kb_atomic_ptr     continuations;  // Jobs submitted once value reaches zero
+} kb_job_counter;
+
+typedef struct kb_job_info {
+  kb_job_func       func;
+  void*             userdata;
+  kb_job_priority   priority;
+} kb_job_info;
+
 typedef void*(*kb_thread_func)(void*);
 
+typedef uint32_t kb_tls_slot;
+
+// Contention numbers for every lock created with the same name. Times are in
+// nanoseconds.
+typedef struct kb_lock_stats {
+  const char*       name;
+  uint64_t          acquisitions;
+  uint64_t          contended;
+  uint64_t          wait_total_ns;
+  uint64_t          wait_max_ns;
+  uint64_t          hold_total_ns;
+  uint64_t          hold_max_ns;
+} kb_lock_stats;
+
 KB_API kb_thread*       kb_thread_create                  (kb_thread_func func, void* userdata);
 KB_API void             kb_thread_join                    (kb_thread* thread);
 KB_API void             kb_thread_destroy                 (kb_thread* thread);
+KB_API bool             kb_thread_set_affinity            (kb_thread* thread, uint32_t cpu);
+
+// Every thread that touches the pools gets a small stable index below
+// KB_MAX_THREADS. Pool workers get theirs when the pool is created, other
+// threads on first use. kb_thread_count is the highest index handed out plus one, so it can
+// size arrays of per-thread data. Threads started with kb_thread_create give
+// their index back when func returns. Any other thread that used an index has
+// to call kb_thread_unregister before it exits, or the index is never reused.
+KB_API uint32_t         kb_thread_index                   (void);
+KB_API uint32_t         kb_thread_count                   (void);
+KB_API void             kb_thread_register                (void);
+KB_API void             kb_thread_unregister              (void);
+
+// Per-thread pointer slots, readable from other threads by index for
+// gathering per-thread results. Slots start out NULL on every thread.
+KB_API kb_tls_slot      kb_tls_alloc                      (void);
+KB_API void             kb_tls_free                       (kb_tls_slot slot);
+KB_API void             kb_tls_set                        (kb_tls_slot slot, void* value);
+KB_API void*            kb_tls_get                        (kb_tls_slot slot);
+KB_API void*            kb_tls_get_thread                 (kb_tls_slot slot, uint32_t thread_index);
 
 KB_API kb_thread_pool*  kb_threadpool_create              (int num_threads);
 KB_API void             kb_threadpool_destroy             (kb_thread_pool* pool);
@@ -29,10 +96,36 @@ KB_API void             kb_threadpool_wait                (kb_thread_pool* pool)
 KB_API void             kb_threadpool_pause               (kb_thread_pool* pool);
 KB_API void             kb_threadpool_resume              (kb_thread_pool* pool);
 KB_API int              kb_threadpool_active_threads      (kb_thread_pool* pool);
+KB_API int              kb_threadpool_thread_count        (kb_thread_pool* pool);
 KB_API int              kb_threadpool_queue_length        (kb_thread_pool* pool);
+KB_API bool             kb_threadpool_set_affinity        (kb_thread_pool* pool, uint32_t first_cpu);
 KB_API int              kb_threadpool_add_job             (kb_thread_pool* pool, void* param, kb_job_func job);
+KB_API int              kb_threadpool_add_counted_job     (kb_thread_pool* pool, void* param, kb_job_func job, kb_job_counter* counter);
+KB_API int              kb_threadpool_add_prioritized_job (kb_thread_pool* pool, void* param, kb_job_func job, kb_job_priority priority, kb_job_counter* counter);
+KB_API int              kb_threadpool_add_jobs            (kb_thread_pool* pool, const kb_job_info* jobs, uint32_t count);
+KB_API int              kb_threadpool_add_counted_jobs    (kb_thread_pool* pool, const kb_job_info* jobs, uint32_t count, kb_job_counter* counter);
+
+KB_API int              kb_threadpool_add_fiber_job       (kb_thread_pool* pool, void* param, kb_job_func job, kb_job_priority priority, kb_job_counter* counter);
+KB_API void             kb_threadpool_reserve_fibers      (kb_thread_pool* pool, uint32_t count);
+
+KB_API void             kb_job_counter_init               (kb_job_counter* counter);
+KB_API void             kb_job_counter_add                (kb_job_counter* counter, uint32_t count);
+KB_API void             kb_job_counter_signal             (kb_thread_pool* pool, kb_job_counter* counter);
+KB_API bool             kb_job_counter_done               (kb_job_counter* counter);
+KB_API int              kb_job_then                       (kb_thread_pool* pool, kb_job_counter* dependency, void* param, kb_job_func job, kb_job_counter* counter);
+KB_API void             kb_job_wait                       (kb_thread_pool* pool, kb_job_counter* counter);
+
+// Fiber jobs can suspend on a counter and resume on any worker. Don't keep
+// pointers to thread local data or the thread index across kb_fiber_wait.
+// Fibers are only implemented on Linux. Elsewhere fiber jobs run as plain
+// jobs, kb_fiber_is_current is always false and kb_fiber_wait is kb_job_wait:
+// the waiting job keeps its worker, which runs other jobs nested on its stack
+// until the counter is done.
+KB_API void             kb_fiber_wait                     (kb_thread_pool* pool, kb_job_counter* counter);
+KB_API bool             kb_fiber_is_current               (void);
 
 KB_API kb_semaphore*    kb_semaphore_create               (bool value);
+KB_API kb_semaphore*    kb_semaphore_create_named         (bool value, const char* name);
 KB_API void             kb_semaphore_destroy              (kb_semaphore* semaphore);
 KB_API void             kb_semaphore_reset                (kb_semaphore* semaphore, bool value);
 KB_API void             kb_semaphore_post                 (kb_semaphore* semaphore);
@@ -40,10 +133,17 @@ KB_API void             kb_semaphore_post_all             (kb_semaphore* semapho
 KB_API void             kb_semaphore_wait                 (kb_semaphore* semaphore);
 
 KB_API kb_mutex*        kb_mutex_create                   (void);
+KB_API kb_mutex*        kb_mutex_create_named             (const char* name);
 KB_API void             kb_mutex_destroy                  (kb_mutex* mutex);
 KB_API void             kb_mutex_lock                     (kb_mutex* mutex);
 KB_API void             kb_mutex_unlock                   (kb_mutex* mutex);
 
+// Only collects data when built with KB_CONFIG_LOCK_PROFILE, otherwise the
+// report is empty. Names must outlive the profile, string literals are best.
+KB_API uint32_t         kb_lock_profile_report            (kb_lock_stats* dst, uint32_t capacity);
+KB_API void             kb_lock_profile_reset             (void);
+KB_API void             kb_lock_profile_dump              (void);
+
 #ifdef __cplusplus
 }
 
@@ -7,15 +7,44 @@
 #pragma once
 
 #include "core.h"
+#include "sampler.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-KB_API int64_t  kb_time_get_raw(void);
-KB_API int64_t  kb_time_get_current(void);
-KB_API int64_t  kb_time_get_frequency(void);
-KB_API float    kb_time(void);
+// Monotonic clock in nanoseconds, kb_time_get_frequency is always 1e9
+KB_API int64_t  kb_time_get_raw             (void);
+KB_API int64_t  kb_time_get_current         (void);
+KB_API int64_t  kb_time_get_frequency       (void);
+KB_API float    kb_time                     (void);
+
+// Cheap timestamps for profiling. Reads the TSC when the CPU has an invariant
+// one, calibrated against the monotonic clock on first use, and falls back to
+// kb_time_get_raw otherwise. Only differences between readings are meaningful.
+KB_API bool     kb_time_fast_is_tsc         (void);
+KB_API uint64_t kb_time_get_fast            (void);
+KB_API int64_t  kb_time_get_fast_frequency  (void);
+KB_API int64_t  kb_time_fast_to_ns          (uint64_t ticks);
+
+// Paces a loop to a fixed interval. Sleeps on an absolute monotonic deadline
+// and spins through the last stretch, whose length adapts to how late the
+// scheduler wakes us. A frame that runs more than an interval late restarts
+// the schedule instead of bursting to catch up. Pacing error, wake time minus
+// deadline, goes to the sampler in microseconds.
+typedef struct kb_frame_limiter {
+  int64_t         interval;
+  int64_t         deadline;
+  int64_t         spin;
+  kb_sampler      error;
+} kb_frame_limiter;
+
+KB_API void     kb_frame_limiter_create     (kb_frame_limiter* limiter, double rate, uint32_t sample_count);
+KB_API void     kb_frame_limiter_destroy    (kb_frame_limiter* limiter);
+// A rate of zero or less disables waiting
+KB_API void     kb_frame_limiter_set_rate   (kb_frame_limiter* limiter, double rate);
+// Blocks until the next frame is due and returns its start time (kb_time_get_raw)
+KB_API int64_t  kb_frame_limiter_wait       (kb_frame_limiter* limiter);
 
 #ifdef __cplusplus
 }
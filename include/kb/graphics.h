@@ -410,10 +410,21 @@ typedef struct kb_pipeline_create_info {
   void*                     userdata;
 } kb_pipeline_create_info;
 
+// Zero fields fall back to the KB_CONFIG_MAX_* defaults
+typedef struct kb_graphics_capacity_info {
+  uint32_t                  buffers;
+  uint32_t                  textures;
+  uint32_t                  pipelines;
+  uint32_t                  draw_calls;
+  uint32_t                  transient_buffer_size;  // Bytes, buffers are 32 bit sized
+} kb_graphics_capacity_info;
+
 typedef struct kb_graphics_init_info {
   bool                      vsync;
+  bool                      render_thread;
   kb_int2                   resolution;
   kb_graphics_pipeline_info pipe;
+  kb_graphics_capacity_info capacity;
 } kb_graphics_init_info;
 
 typedef struct kb_primitive_info {
@@ -439,8 +450,11 @@ typedef struct kb_uniform_binding {
   kb_buffer_memory          memory;
 } kb_uniform_binding;
 
+// Pass is copied from the pipeline when the call is recorded, so submission
+// never has to look pipelines up
 typedef struct kb_render_call {
   kb_pipeline               pipeline;
+  uint32_t                  pass;
   uint32_t                  first_vertex;
   uint32_t                  first_index;
   uint32_t                  index_count;
@@ -455,6 +469,7 @@ typedef struct kb_render_call {
 
 typedef struct kb_compute_call {
   kb_pipeline               pipeline;
+  uint32_t                  pass;
   kb_int3                   groups;
   kb_int3                   group_size;
   kb_texture_binding        texture_bindings   [KB_CONFIG_MAX_UNIFORM_BINDINGS];
@@ -469,6 +484,14 @@ typedef struct kb_uniform_slot {
   kb_binding_type           type;
 } kb_uniform_slot;
 
+// Times are in seconds
+typedef struct kb_graphics_pass_stats {
+  uint32_t                       draw_calls;
+  uint32_t                       compute_calls;
+  float                          sort_time;
+  float                          submit_time;
+} kb_graphics_pass_stats;
+
 typedef struct kb_graphics_stats {
   float                          platform_frametime;
   float                          platform_frametime_avg;
@@ -495,6 +518,15 @@ typedef struct kb_graphics_stats {
   
   uint32_t                       transient_allocated;
   uint32_t                       transient_used;
+  uint32_t                       transient_high_water;  // Lifetime maximum of transient_used, only kb_graphics_init resets it
+
+  uint64_t                       upload_bytes;
+  uint32_t                       uniform_bindings;
+  uint32_t                       texture_bindings;
+
+  float                          run_encoders_time;
+  uint32_t                       pass_count;
+  kb_graphics_pass_stats         passes[KB_CONFIG_MAX_PASSES];
 } kb_graphics_stats;
 
 KB_RESOURCE_HASHED_FUNC_DECLS (buffer         , kb_buffer         , kb_buffer_create_info         )
@@ -509,7 +541,11 @@ KB_API void                 kb_graphics_init                          (const kb_
 KB_API void                 kb_graphics_deinit                        (void);
 KB_API void                 kb_graphics_frame                         (void);
 KB_API void                 kb_graphics_get_stats                     (kb_graphics_stats* dst);
+// One header line then one row per frame, oldest first, for at most the last
+// KB_CONFIG_STATS_SAMPLE_COUNT frames. Each pass adds four columns.
+KB_API void                 kb_graphics_write_stats_csv               (kb_stream* dst);
 KB_API void                 kb_graphics_run_encoders                  (void);
+KB_API void                 kb_graphics_flush                         (void);
 KB_API kb_int2              kb_graphics_get_extent                    (void);
 KB_API float                kb_graphics_get_aspect                    (void);
 KB_API uint32_t             kb_graphics_get_current_resource_slot     (void);
@@ -522,6 +558,30 @@ KB_API kb_format            kb_graphics_pipe_attachment_format        (uint32_t
 KB_API bool                 kb_graphics_pipe_attachment_surface_proxy (uint32_t attachment);
 KB_API kb_pass_info*        kb_graphics_get_pass_info                 (uint32_t pass);
 KB_API kb_uniform_slot      kb_uniform_get_slot                       (const kb_uniform_layout* layout, kb_hash hash, kb_binding_type type);
+// Encoders can be recorded from any thread. kb_encoder_begin and the transient
+// allocators are thread safe, and each encoder owns its draw and compute
+// storage, but a single encoder must only be used by one thread at a time.
+// All recording has to finish before kb_graphics_run_encoders and
+// kb_graphics_frame, which run on the thread that owns the graphics context.
+//
+// Pipelines can be created on the owning thread while other threads record,
+// a pipeline is visible to any encoder that binds it after kb_pipeline_create
+// returns and the handle has been handed over. Destroying a pipeline that an
+// encoder might still bind is not allowed until recording has finished.
+//
+// With kb_graphics_init_info.render_thread set, kb_graphics_frame hands the
+// recorded frame to a render thread that sorts, submits and presents it while
+// the next frame is recorded. kb_graphics_run_encoders is then a no-op, and
+// kb_graphics_flush waits until the render thread has caught up, which is
+// needed before touching resources it might still be submitting.
+//
+// In that mode the render thread makes the kb_platform_graphics_frame and
+// submit_*_pass calls, and resizes surface sized attachments with
+// kb_platform_graphics_texture_construct/destruct. Creating and destroying
+// resources still calls the platform construct/destruct functions on the
+// caller's thread, concurrently with those, so backends have to allow that
+// for handles the in-flight frame doesn't use. kb_graphics_get_extent reports
+// the extent of the last frame the render thread finished.
 KB_API kb_encoder           kb_encoder_begin                          (void);
 KB_API void                 kb_encoder_end                            (kb_encoder encoder);
 KB_API void                 kb_encoder_push                           (kb_encoder encoder);
@@ -24,9 +24,18 @@ typedef enum kb_log_level {
 
 KB_API void kb_log_line        (kb_log_level level, const char* msg);
 KB_API void kb_log_set_level   (kb_log_level level);
+KB_API bool kb_log_enabled     (kb_log_level level);
 KB_API void kb_log_set_color   (bool enabled);
 KB_API void kb_log_set_header  (bool enabled);
 
+// Async mode hands lines to a background thread through a fixed size ring,
+// so logging costs a copy instead of a write. When the ring is full lines
+// below KB_LOG_LEVEL_ERROR are dropped and counted, errors wait for room.
+// Fatal lines flush before returning.
+KB_API void     kb_log_set_async  (bool enabled);
+KB_API void     kb_log_flush      (void);
+KB_API uint64_t kb_log_dropped    (void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -36,43 +45,96 @@ KB_API void kb_log_set_header  (bool enabled);
 #include <fmt/format.h>
 #include <kb/foundation/crt.h>
 
+// Lines below this level are compiled out of the KB_LOG_* macros and the
+// kb::log_* helpers. Release builds keep info and up. Plain numbers matching
+// kb_log_level, the preprocessor can't see enum values.
+#ifndef KB_LOG_COMPILE_LEVEL
+# if KB_BUILD_MODE_DEBUG
+#   define KB_LOG_COMPILE_LEVEL 1 // KB_LOG_LEVEL_TRACE
+# else
+#   define KB_LOG_COMPILE_LEVEL 3 // KB_LOG_LEVEL_INFO
+# endif
+#endif
+
+#define KB_LOG_FORMAT_BUFFER_SIZE 1024
+
 namespace kb {
 
+  // Formats on the stack and only once the line is known to pass the filter
+  template <typename... T>
+  KB_API_INLINE auto log_line(kb_log_level level, const T&... args) -> void {
+    if (level < KB_LOG_COMPILE_LEVEL || !kb_log_enabled(level)) return;
+
+    char buffer[KB_LOG_FORMAT_BUFFER_SIZE];
+    auto result = fmt::format_to_n(buffer, sizeof(buffer) - 1, args...);
+    *result.out = '\0';
+
+    kb_log_line(level, buffer);
+  };
+
   template <typename... T>
   KB_API_INLINE auto log_trace(const T&... args) -> void {
-    kb_log_line(KB_LOG_LEVEL_TRACE, fmt::format(args...).c_str());
+    log_line(KB_LOG_LEVEL_TRACE, args...);
   };
 
   template <typename... T>
   KB_API_INLINE auto log_debug(const T&... args) -> void {
-    kb_log_line(KB_LOG_LEVEL_DEBUG, fmt::format(args...).c_str());
+    log_line(KB_LOG_LEVEL_DEBUG, args...);
   };
 
   template <typename... T>
   KB_API_INLINE auto log_info(const T&... args) -> void  {
-    kb_log_line(KB_LOG_LEVEL_INFO, fmt::format(args...).c_str());
+    log_line(KB_LOG_LEVEL_INFO, args...);
   };
 
   template <typename... T>
   KB_API_INLINE auto log_warn(const T&... args) -> void  {
-    kb_log_line(KB_LOG_LEVEL_WARN, fmt::format(args...).c_str());
+    log_line(KB_LOG_LEVEL_WARN, args...);
   };
 
   template <typename... T>
   KB_API_INLINE auto log_error(const T&... args) -> void {
-    kb_log_line(KB_LOG_LEVEL_ERROR, fmt::format(args...).c_str());
+    log_line(KB_LOG_LEVEL_ERROR, args...);
   };
 
   template <typename... T>
   KB_API_INLINE auto log_fatal(const T&... args) -> void {
-    kb_log_line(KB_LOG_LEVEL_FATAL, fmt::format(args...).c_str());
+    log_line(KB_LOG_LEVEL_FATAL, args...);
   };
 
+  // Truncates to fit and always terminates dst. Returns the length written.
   template <typename... T>
-  KB_API uint64_t strfmt(char* dst, int32_t size, const T&... args) {
-    kb_strncpy(dst, fmt::format(args...).c_str(), size);
-    return kb_strlen(dst);
+  KB_API_INLINE uint64_t strfmt(char* dst, int32_t size, const T&... args) {
+    if (size <= 0) return 0;
+
+    auto result = fmt::format_to_n(dst, (size_t) size - 1, args...);
+    *result.out = '\0';
+
+    return (uint64_t) (result.out - dst);
   }
 };
 
+// Unlike the functions above these also skip evaluating their arguments
+#if KB_LOG_COMPILE_LEVEL <= 1
+# define KB_LOG_TRACE(...) kb::log_trace(__VA_ARGS__)
+#else
+# define KB_LOG_TRACE(...) ((void) 0)
+#endif
+
+#if KB_LOG_COMPILE_LEVEL <= 2
+# define KB_LOG_DEBUG(...) kb::log_debug(__VA_ARGS__)
+#else
+# define KB_LOG_DEBUG(...) ((void) 0)
+#endif
+
+#if KB_LOG_COMPILE_LEVEL <= 3
+# define KB_LOG_INFO(...) kb::log_info(__VA_ARGS__)
+#else
+# define KB_LOG_INFO(...) ((void) 0)
+#endif
+
+#define KB_LOG_WARN(...)  kb::log_warn(__VA_ARGS__)
+#define KB_LOG_ERROR(...) kb::log_error(__VA_ARGS__)
+#define KB_LOG_FATAL(...) kb::log_fatal(__VA_ARGS__)
+
 #endif
@@ -0,0 +1,33 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+#pragma once
+
+#include <kb/foundation.h>
+#include <kb/graphics.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+KB_API uint32_t  kb_pixel_format_size         (kb_format format);
+KB_API bool      kb_pixel_convert             (void* dst, kb_format dst_format, const void* src, kb_format src_format, uint64_t count);
+
+KB_API void      kb_pixel_r8_to_rgba8         (uint8_t* dst, const uint8_t* src, uint64_t count);
+KB_API void      kb_pixel_r8_to_rgba8_alpha   (uint8_t* dst, const uint8_t* src, uint64_t count, uint32_t rgb);
+KB_API void      kb_pixel_rgba8_to_r8         (uint8_t* dst, const uint8_t* src, uint64_t count, uint32_t channel);
+KB_API void      kb_pixel_rgba8_to_rgba32f    (float* dst, const uint8_t* src, uint64_t count);
+KB_API void      kb_pixel_rgba32f_to_rgba8    (uint8_t* dst, const float* src, uint64_t count);
+KB_API void      kb_pixel_srgb_to_linear      (float* dst, const uint8_t* src, uint64_t count);
+KB_API void      kb_pixel_linear_to_srgb      (uint8_t* dst, const float* src, uint64_t count);
+KB_API void      kb_pixel_premultiply_rgba8   (uint8_t* dst, const uint8_t* src, uint64_t count);
+KB_API void      kb_pixel_swizzle_rgba8       (uint8_t* dst, const uint8_t* src, uint64_t count, const uint8_t swizzle[4]);
+KB_API void      kb_pixel_expand_rgba8        (uint8_t* dst, const uint8_t* src, uint64_t count, uint32_t src_channels);
+KB_API void      kb_pixel_reduce_rgba8        (uint8_t* dst, const uint8_t* src, uint64_t count, uint32_t dst_channels);
+
+#ifdef __cplusplus
+}
+#endif
@@ -11,7 +11,7 @@
 
 KB_RESOURCE_ALLOC_FUNC_DEF  (sound,       kb_sound, kb_sound_create_info, KB_CONFIG_MAX_SOUNDS);
 KB_RESOURCE_DATA_HASHED_DEF (sound,       kb_sound);
-KB_RESOURCE_STORAGE_DEF     (sound_info,  kb_sound, kb_sound_playback_info, KB_CONFIG_MAX_SOUNDS);
+KB_RESOURCE_STORAGE_DEF     (sound_info,  kb_sound, kb_sound_playback_info);
 
 bool has_pitch_range(kb_sound handle) {
   return sound_info_ref(handle)->pitch_range.x > 0 && sound_info_ref(handle)->pitch_range.x > 0;
@@ -30,7 +30,7 @@ KB_API void kb_audio_deinit() {
 }
 
 KB_API void kb_sound_construct(kb_sound handle, const kb_sound_create_info info) {
-  *sound_info_ref(handle) = info.playback;
+  *sound_info_ref_create(handle) = info.playback;
 
   kb_platform_audio_sound_construct(handle, info);
   kb_sound_set_initialized(handle, true);
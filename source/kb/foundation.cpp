@@ -12,8 +12,13 @@
 #include "foundation/freelist.cpp"
 #include "foundation/hash.cpp"
 #include "foundation/math.cpp"
+#include "foundation/metrics.cpp"
+#include "foundation/parallel.cpp"
+#include "foundation/profile.cpp"
 #include "foundation/rand.cpp"
 #include "foundation/sampler.cpp"
+#include "foundation/segmented_array.cpp"
+#include "foundation/sync.cpp"
 #include "foundation/table.cpp"
 #include "foundation/time.cpp"
 #include "foundation/thread.cpp"
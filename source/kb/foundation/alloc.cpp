@@ -5,6 +5,7 @@
 // ============================================================================
 
 #include <kb/foundation/alloc.h>
+#include <kb/foundation/atomic.h>
 #include <kb/foundation/crt.h>
 #include <kb/foundation/math.h>
 
@@ -21,6 +22,11 @@ struct kb_alloc_header {
 
 kb_alloc_stats default_stats = {};
 
+KB_INTERNAL kb_atomic_u32 alloc_frame_mode;
+KB_INTERNAL kb_atomic_u64 alloc_frame_current;
+KB_INTERNAL kb_atomic_u64 alloc_frame_last;
+KB_INTERNAL kb_atomic_u64 alloc_frame_total;
+
 void* real_from_aligned(void* aligned, uint64_t distance) {
   return ((uint8_t*)aligned) - distance;
 }
@@ -134,11 +140,26 @@ KB_INTERNAL void* default_alloc(kb_allocator* alloc, void* ptr, size_t size, siz
   return res;
 }
 
+KB_INTERNAL void alloc_frame_track(size_t size) {
+  uint32_t mode = kb_atomic_load_relaxed_u32(&alloc_frame_mode);
+  if (mode == KB_ALLOC_FRAME_OFF || size == 0) return;
+
+  kb_atomic_fetch_add_u64(&alloc_frame_current, 1);
+
+  // Asserts compile out in release, the trap has to work in any build
+  if (mode == KB_ALLOC_FRAME_TRAP) {
+    KB_ASSERT(false, "Heap allocation during a steady state frame");
+    abort();
+  }
+}
+
 KB_API void* kb_alloc(kb_allocator* alloc, size_t size, size_t align, const char* file, const char* line) {
+  alloc_frame_track(size);
   return (alloc ? alloc->realloc : default_alloc)(alloc, NULL, size, align);
 }
 
 KB_API void* kb_realloc(kb_allocator* alloc, void* ptr, size_t size, size_t align, const char* file, const char* line) {
+  alloc_frame_track(size);
   return (alloc ? alloc->realloc : default_alloc)(alloc, ptr, size, align);
 }
 
@@ -157,3 +178,26 @@ KB_API uint64_t kb_alloc_mem(kb_allocator* alloc) {
 KB_API uint64_t kb_alloc_high_water_mark(kb_allocator* alloc) {
   return (alloc ? alloc->stats : default_stats).high_water_mark;
 }
+
+KB_API void kb_alloc_set_frame_mode(kb_alloc_frame_mode mode) {
+  kb_atomic_store_u64(&alloc_frame_current, 0);
+  kb_atomic_store_u64(&alloc_frame_last,    0);
+  kb_atomic_store_u64(&alloc_frame_total,   0);
+  kb_atomic_store_u32(&alloc_frame_mode,    mode);
+}
+
+KB_API void kb_alloc_frame_mark() {
+  if (kb_atomic_load_relaxed_u32(&alloc_frame_mode) == KB_ALLOC_FRAME_OFF) return;
+
+  uint64_t count = kb_atomic_exchange_u64(&alloc_frame_current, 0);
+  kb_atomic_store_u64(&alloc_frame_last, count);
+  kb_atomic_fetch_add_u64(&alloc_frame_total, count);
+}
+
+KB_API uint64_t kb_alloc_frame_count() {
+  return kb_atomic_load_u64(&alloc_frame_last);
+}
+
+KB_API uint64_t kb_alloc_frame_total() {
+  return kb_atomic_load_u64(&alloc_frame_total);
+}
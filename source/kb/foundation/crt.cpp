@@ -12,6 +12,16 @@
 #include <stdarg.h>
 #include <ctype.h>
 
+#if KB_SIMD_SSE2
+  #include <emmintrin.h>
+#elif KB_SIMD_NEON
+  #include <arm_neon.h>
+#endif
+
+// Elements processed per stream before moving to the next one in kb_interleave and kb_deinterleave.
+// Keeps the interleaved side of the copy resident in L1 while every stream is written.
+#define KB_INTERLEAVE_CHUNK 256
+
 KB_API void kb_memset(void* dst, uint8_t ch, size_t count) {
   memset(dst, ch, count);
 }
@@ -25,6 +35,348 @@ KB_API void kb_memcpy_with_stride(void* dst, const void* src, size_t count, size
   kb_memcpy(data, src, count);
 }
 
+template <size_t N>
+KB_INTERNAL inline void copy_elem(uint8_t* dst, const uint8_t* src) {
+#if KB_SIMD_SSE2
+  if (N == 16) {
+    _mm_storeu_si128((__m128i*) dst, _mm_loadu_si128((const __m128i*) src));
+    return;
+  }
+#elif KB_SIMD_NEON
+  if (N == 16) {
+    vst1q_u8(dst, vld1q_u8(src));
+    return;
+  }
+#endif
+  // Constant size, compiles to plain register moves
+  memcpy(dst, src, N);
+}
+
+template <size_t N>
+KB_INTERNAL void copy_strided_fixed(uint8_t* dst, size_t dst_stride, const uint8_t* src, size_t src_stride, size_t count) {
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    copy_elem<N>(dst                 , src                 );
+    copy_elem<N>(dst + dst_stride    , src + src_stride    );
+    copy_elem<N>(dst + dst_stride * 2, src + src_stride * 2);
+    copy_elem<N>(dst + dst_stride * 3, src + src_stride * 3);
+    dst += dst_stride * 4;
+    src += src_stride * 4;
+  }
+
+  for (; i < count; ++i) {
+    copy_elem<N>(dst, src);
+    dst += dst_stride;
+    src += src_stride;
+  }
+}
+
+template <size_t N>
+KB_INTERNAL void copy_gather_fixed(uint8_t* dst, size_t dst_stride, const uint8_t* src, size_t src_stride, const uint32_t* indices, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    copy_elem<N>(dst, src + indices[i] * src_stride);
+    dst += dst_stride;
+  }
+}
+
+template <size_t N>
+KB_INTERNAL void copy_scatter_fixed(uint8_t* dst, size_t dst_stride, const uint8_t* src, size_t src_stride, const uint32_t* indices, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    copy_elem<N>(dst + indices[i] * dst_stride, src);
+    src += src_stride;
+  }
+}
+
+KB_API void kb_memcpy_strided(void* dst, size_t dst_stride, const void* src, size_t src_stride, size_t elem_size, size_t count) {
+  uint8_t*        d = (uint8_t*) dst;
+  const uint8_t*  s = (const uint8_t*) src;
+
+  if (dst_stride == elem_size && src_stride == elem_size) {
+    memcpy(d, s, elem_size * count);
+    return;
+  }
+
+  switch (elem_size) {
+    case 4  : copy_strided_fixed<4> (d, dst_stride, s, src_stride, count); break;
+    case 8  : copy_strided_fixed<8> (d, dst_stride, s, src_stride, count); break;
+    case 12 : copy_strided_fixed<12>(d, dst_stride, s, src_stride, count); break;
+    case 16 : copy_strided_fixed<16>(d, dst_stride, s, src_stride, count); break;
+    default : {
+      for (size_t i = 0; i < count; ++i) {
+        memcpy(d + i * dst_stride, s + i * src_stride, elem_size);
+      }
+    } break;
+  }
+}
+
+KB_API void kb_memcpy_gather(void* dst, size_t dst_stride, const void* src, size_t src_stride, const uint32_t* indices, size_t elem_size, size_t count) {
+  uint8_t*        d = (uint8_t*) dst;
+  const uint8_t*  s = (const uint8_t*) src;
+
+  switch (elem_size) {
+    case 4  : copy_gather_fixed<4> (d, dst_stride, s, src_stride, indices, count); break;
+    case 8  : copy_gather_fixed<8> (d, dst_stride, s, src_stride, indices, count); break;
+    case 12 : copy_gather_fixed<12>(d, dst_stride, s, src_stride, indices, count); break;
+    case 16 : copy_gather_fixed<16>(d, dst_stride, s, src_stride, indices, count); break;
+    default : {
+      for (size_t i = 0; i < count; ++i) {
+        memcpy(d + i * dst_stride, s + indices[i] * src_stride, elem_size);
+      }
+    } break;
+  }
+}
+
+KB_API void kb_memcpy_scatter(void* dst, size_t dst_stride, const void* src, size_t src_stride, const uint32_t* indices, size_t elem_size, size_t count) {
+  uint8_t*        d = (uint8_t*) dst;
+  const uint8_t*  s = (const uint8_t*) src;
+
+  switch (elem_size) {
+    case 4  : copy_scatter_fixed<4> (d, dst_stride, s, src_stride, indices, count); break;
+    case 8  : copy_scatter_fixed<8> (d, dst_stride, s, src_stride, indices, count); break;
+    case 12 : copy_scatter_fixed<12>(d, dst_stride, s, src_stride, indices, count); break;
+    case 16 : copy_scatter_fixed<16>(d, dst_stride, s, src_stride, indices, count); break;
+    default : {
+      for (size_t i = 0; i < count; ++i) {
+        memcpy(d + indices[i] * dst_stride, s + i * src_stride, elem_size);
+      }
+    } break;
+  }
+}
+
+// Streams of equal 4 or 8 byte elements packed back to back in the interleaved
+// side are a plain transpose, done in registers four or two elements at a time
+typedef enum packed_layout {
+  PACKED_NONE   = 0,
+  PACKED_4X2    = 1,
+  PACKED_4X4    = 2,
+  PACKED_8X2    = 3,
+} packed_layout;
+
+KB_INTERNAL packed_layout get_packed_layout(const size_t* sizes, uint32_t stream_count, size_t stride) {
+#if KB_SIMD_SSE2 || KB_SIMD_NEON
+  if (stream_count != 2 && stream_count != 4) return PACKED_NONE;
+
+  for (uint32_t stream = 1; stream < stream_count; ++stream) {
+    if (sizes[stream] != sizes[0]) return PACKED_NONE;
+  }
+
+  if (stride != sizes[0] * stream_count) return PACKED_NONE;
+
+  if (sizes[0] == 4) return stream_count == 2 ? PACKED_4X2 : PACKED_4X4;
+  if (sizes[0] == 8 && stream_count == 2) return PACKED_8X2;
+#endif
+
+  return PACKED_NONE;
+}
+
+// Returns how many elements were done, the rest go through the strided path
+KB_INTERNAL size_t interleave_packed(uint8_t* d, const uint8_t* const* s, packed_layout layout, size_t count) {
+  size_t i = 0;
+
+#if KB_SIMD_SSE2
+  switch (layout) {
+    case PACKED_4X2: {
+      for (; i + 4 <= count; i += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i*) (s[0] + i * 4));
+        __m128i b = _mm_loadu_si128((const __m128i*) (s[1] + i * 4));
+
+        _mm_storeu_si128((__m128i*) (d + i * 8     ), _mm_unpacklo_epi32(a, b));
+        _mm_storeu_si128((__m128i*) (d + i * 8 + 16), _mm_unpackhi_epi32(a, b));
+      }
+    } break;
+
+    case PACKED_4X4: {
+      for (; i + 4 <= count; i += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i*) (s[0] + i * 4));
+        __m128i b = _mm_loadu_si128((const __m128i*) (s[1] + i * 4));
+        __m128i c = _mm_loadu_si128((const __m128i*) (s[2] + i * 4));
+        __m128i e = _mm_loadu_si128((const __m128i*) (s[3] + i * 4));
+
+        __m128i ab_lo = _mm_unpacklo_epi32(a, b);
+        __m128i ab_hi = _mm_unpackhi_epi32(a, b);
+        __m128i ce_lo = _mm_unpacklo_epi32(c, e);
+        __m128i ce_hi = _mm_unpackhi_epi32(c, e);
+
+        _mm_storeu_si128((__m128i*) (d + i * 16     ), _mm_unpacklo_epi64(ab_lo, ce_lo));
+        _mm_storeu_si128((__m128i*) (d + i * 16 + 16), _mm_unpackhi_epi64(ab_lo, ce_lo));
+        _mm_storeu_si128((__m128i*) (d + i * 16 + 32), _mm_unpacklo_epi64(ab_hi, ce_hi));
+        _mm_storeu_si128((__m128i*) (d + i * 16 + 48), _mm_unpackhi_epi64(ab_hi, ce_hi));
+      }
+    } break;
+
+    case PACKED_8X2: {
+      for (; i + 2 <= count; i += 2) {
+        __m128i a = _mm_loadu_si128((const __m128i*) (s[0] + i * 8));
+        __m128i b = _mm_loadu_si128((const __m128i*) (s[1] + i * 8));
+
+        _mm_storeu_si128((__m128i*) (d + i * 16     ), _mm_unpacklo_epi64(a, b));
+        _mm_storeu_si128((__m128i*) (d + i * 16 + 16), _mm_unpackhi_epi64(a, b));
+      }
+    } break;
+
+    default: break;
+  }
+#elif KB_SIMD_NEON
+  switch (layout) {
+    case PACKED_4X2: {
+      for (; i + 4 <= count; i += 4) {
+        uint32x4x2_t v;
+        v.val[0] = vreinterpretq_u32_u8(vld1q_u8(s[0] + i * 4));
+        v.val[1] = vreinterpretq_u32_u8(vld1q_u8(s[1] + i * 4));
+        vst2q_u32((uint32_t*) (d + i * 8), v);
+      }
+    } break;
+
+    case PACKED_4X4: {
+      for (; i + 4 <= count; i += 4) {
+        uint32x4x4_t v;
+        v.val[0] = vreinterpretq_u32_u8(vld1q_u8(s[0] + i * 4));
+        v.val[1] = vreinterpretq_u32_u8(vld1q_u8(s[1] + i * 4));
+        v.val[2] = vreinterpretq_u32_u8(vld1q_u8(s[2] + i * 4));
+        v.val[3] = vreinterpretq_u32_u8(vld1q_u8(s[3] + i * 4));
+        vst4q_u32((uint32_t*) (d + i * 16), v);
+      }
+    } break;
+
+    case PACKED_8X2: {
+      for (; i + 2 <= count; i += 2) {
+        uint64x2_t a = vreinterpretq_u64_u8(vld1q_u8(s[0] + i * 8));
+        uint64x2_t b = vreinterpretq_u64_u8(vld1q_u8(s[1] + i * 8));
+
+        vst1q_u8(d + i * 16     , vreinterpretq_u8_u64(vcombine_u64(vget_low_u64(a),  vget_low_u64(b))));
+        vst1q_u8(d + i * 16 + 16, vreinterpretq_u8_u64(vcombine_u64(vget_high_u64(a), vget_high_u64(b))));
+      }
+    } break;
+
+    default: break;
+  }
+#endif
+
+  return i;
+}
+
+KB_INTERNAL size_t deinterleave_packed(uint8_t* const* d, const uint8_t* s, packed_layout layout, size_t count) {
+  size_t i = 0;
+
+#if KB_SIMD_SSE2
+  switch (layout) {
+    case PACKED_4X2: {
+      for (; i + 4 <= count; i += 4) {
+        __m128i x0 = _mm_loadu_si128((const __m128i*) (s + i * 8     ));
+        __m128i x1 = _mm_loadu_si128((const __m128i*) (s + i * 8 + 16));
+
+        // (a0 a2 b0 b2) and (a1 a3 b1 b3)
+        __m128i t0 = _mm_unpacklo_epi32(x0, x1);
+        __m128i t1 = _mm_unpackhi_epi32(x0, x1);
+
+        _mm_storeu_si128((__m128i*) (d[0] + i * 4), _mm_unpacklo_epi32(t0, t1));
+        _mm_storeu_si128((__m128i*) (d[1] + i * 4), _mm_unpackhi_epi32(t0, t1));
+      }
+    } break;
+
+    case PACKED_4X4: {
+      for (; i + 4 <= count; i += 4) {
+        __m128i x0 = _mm_loadu_si128((const __m128i*) (s + i * 16     ));
+        __m128i x1 = _mm_loadu_si128((const __m128i*) (s + i * 16 + 16));
+        __m128i x2 = _mm_loadu_si128((const __m128i*) (s + i * 16 + 32));
+        __m128i x3 = _mm_loadu_si128((const __m128i*) (s + i * 16 + 48));
+
+        __m128i lo01 = _mm_unpacklo_epi32(x0, x1);
+        __m128i hi01 = _mm_unpackhi_epi32(x0, x1);
+        __m128i lo23 = _mm_unpacklo_epi32(x2, x3);
+        __m128i hi23 = _mm_unpackhi_epi32(x2, x3);
+
+        _mm_storeu_si128((__m128i*) (d[0] + i * 4), _mm_unpacklo_epi64(lo01, lo23));
+        _mm_storeu_si128((__m128i*) (d[1] + i * 4), _mm_unpackhi_epi64(lo01, lo23));
+        _mm_storeu_si128((__m128i*) (d[2] + i * 4), _mm_unpacklo_epi64(hi01, hi23));
+        _mm_storeu_si128((__m128i*) (d[3] + i * 4), _mm_unpackhi_epi64(hi01, hi23));
+      }
+    } break;
+
+    case PACKED_8X2: {
+      for (; i + 2 <= count; i += 2) {
+        __m128i x0 = _mm_loadu_si128((const __m128i*) (s + i * 16     ));
+        __m128i x1 = _mm_loadu_si128((const __m128i*) (s + i * 16 + 16));
+
+        _mm_storeu_si128((__m128i*) (d[0] + i * 8), _mm_unpacklo_epi64(x0, x1));
+        _mm_storeu_si128((__m128i*) (d[1] + i * 8), _mm_unpackhi_epi64(x0, x1));
+      }
+    } break;
+
+    default: break;
+  }
+#elif KB_SIMD_NEON
+  switch (layout) {
+    case PACKED_4X2: {
+      for (; i + 4 <= count; i += 4) {
+        uint32x4x2_t v = vld2q_u32((const uint32_t*) (s + i * 8));
+        vst1q_u8(d[0] + i * 4, vreinterpretq_u8_u32(v.val[0]));
+        vst1q_u8(d[1] + i * 4, vreinterpretq_u8_u32(v.val[1]));
+      }
+    } break;
+
+    case PACKED_4X4: {
+      for (; i + 4 <= count; i += 4) {
+        uint32x4x4_t v = vld4q_u32((const uint32_t*) (s + i * 16));
+        vst1q_u8(d[0] + i * 4, vreinterpretq_u8_u32(v.val[0]));
+        vst1q_u8(d[1] + i * 4, vreinterpretq_u8_u32(v.val[1]));
+        vst1q_u8(d[2] + i * 4, vreinterpretq_u8_u32(v.val[2]));
+        vst1q_u8(d[3] + i * 4, vreinterpretq_u8_u32(v.val[3]));
+      }
+    } break;
+
+    case PACKED_8X2: {
+      for (; i + 2 <= count; i += 2) {
+        uint64x2_t x0 = vreinterpretq_u64_u8(vld1q_u8(s + i * 16     ));
+        uint64x2_t x1 = vreinterpretq_u64_u8(vld1q_u8(s + i * 16 + 16));
+
+        vst1q_u8(d[0] + i * 8, vreinterpretq_u8_u64(vcombine_u64(vget_low_u64(x0),  vget_low_u64(x1))));
+        vst1q_u8(d[1] + i * 8, vreinterpretq_u8_u64(vcombine_u64(vget_high_u64(x0), vget_high_u64(x1))));
+      }
+    } break;
+
+    default: break;
+  }
+#endif
+
+  return i;
+}
+
+KB_API void kb_interleave(void* dst, size_t dst_stride, const void* const* srcs, const size_t* sizes, uint32_t stream_count, size_t count) {
+  uint8_t* d = (uint8_t*) dst;
+
+  size_t done = interleave_packed(d, (const uint8_t* const*) srcs, get_packed_layout(sizes, stream_count, dst_stride), count);
+
+  for (size_t first = done; first < count; first += KB_INTERLEAVE_CHUNK) {
+    size_t n      = count - first < KB_INTERLEAVE_CHUNK ? count - first : KB_INTERLEAVE_CHUNK;
+    size_t offset = 0;
+
+    for (uint32_t stream = 0; stream < stream_count; ++stream) {
+      const uint8_t* s = (const uint8_t*) srcs[stream] + first * sizes[stream];
+      kb_memcpy_strided(d + first * dst_stride + offset, dst_stride, s, sizes[stream], sizes[stream], n);
+      offset += sizes[stream];
+    }
+  }
+}
+
+KB_API void kb_deinterleave(void* const* dsts, const size_t* sizes, const void* src, size_t src_stride, uint32_t stream_count, size_t count) {
+  const uint8_t* s = (const uint8_t*) src;
+
+  size_t done = deinterleave_packed((uint8_t* const*) dsts, s, get_packed_layout(sizes, stream_count, src_stride), count);
+
+  for (size_t first = done; first < count; first += KB_INTERLEAVE_CHUNK) {
+    size_t n      = count - first < KB_INTERLEAVE_CHUNK ? count - first : KB_INTERLEAVE_CHUNK;
+    size_t offset = 0;
+
+    for (uint32_t stream = 0; stream < stream_count; ++stream) {
+      uint8_t* d = (uint8_t*) dsts[stream] + first * sizes[stream];
+      kb_memcpy_strided(d, sizes[stream], s + first * src_stride + offset, src_stride, sizes[stream], n);
+      offset += sizes[stream];
+    }
+  }
+}
+
 KB_API int kb_strcmp(const char* a, const char* b) {
   return strcmp(a, b);
 }
@@ -0,0 +1,192 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+#include <kb/foundation/metrics.h>
+
+#include <kb/foundation/atomic.h>
+#include <kb/foundation/crt.h>
+#include <kb/foundation/sampler.h>
+#include <kb/foundation/sync.h>
+#include <kb/foundation/thread.h>
+
+#define KB_METRIC_TABLE_SIZE (KB_CONFIG_MAX_METRICS * 2)
+
+typedef struct metric_entry {
+  const char*         name;
+  kb_hash             hash;
+  kb_metric_type      type;
+  int64_t             last_total;
+  int64_t             frame;
+  kb_sampler          sampler;
+} metric_entry;
+
+// Everything is zero-initialized so metrics can be registered from static
+// constructors. Samplers are created on the first snapshot.
+KB_INTERNAL kb_lock         metric_lock;
+KB_INTERNAL metric_entry    metric_entries[KB_CONFIG_MAX_METRICS];
+KB_INTERNAL uint32_t        metric_table[KB_METRIC_TABLE_SIZE]; // Entry index + 1, zero is empty
+KB_INTERNAL kb_atomic_u32   metric_entry_count;
+
+// Counter shards, one row per thread index. A row is only ever written by the
+// thread owning that index so plain loads and stores are enough.
+KB_INTERNAL kb_atomic_u64   metric_shards[KB_MAX_THREADS][KB_CONFIG_MAX_METRICS];
+KB_INTERNAL kb_atomic_u64   metric_gauges[KB_CONFIG_MAX_METRICS];
+
+KB_INTERNAL uint32_t* metric_table_slot(kb_hash hash) {
+  uint32_t pos = hash & (KB_METRIC_TABLE_SIZE - 1);
+
+  while (metric_table[pos] != 0 && metric_entries[metric_table[pos] - 1].hash != hash) {
+    pos = (pos + 1) & (KB_METRIC_TABLE_SIZE - 1);
+  }
+
+  return &metric_table[pos];
+}
+
+KB_INTERNAL void metric_assert_valid(kb_metric metric) {
+  KB_ASSERT(metric < kb_atomic_load_acquire_u32(&metric_entry_count), "Invalid metric handle");
+}
+
+KB_API kb_metric kb_metric_register(const char* name, kb_metric_type type) {
+  KB_ASSERT_NOT_NULL(name);
+
+  kb_hash hash = kb_hash_string(name);
+
+  kb_lock_lock(&metric_lock);
+
+  uint32_t* slot = metric_table_slot(hash);
+  kb_metric metric;
+
+  if (*slot != 0) {
+    metric = *slot - 1;
+    KB_ASSERT(kb_strcmp(metric_entries[metric].name, name) == 0, "Metric name hash collision");
+    KB_ASSERT(metric_entries[metric].type == type, "Metric registered again with a different type");
+  } else {
+    metric = kb_atomic_load_relaxed_u32(&metric_entry_count);
+    KB_ASSERT(metric < KB_CONFIG_MAX_METRICS, "Too many metrics, raise KB_CONFIG_MAX_METRICS");
+
+    metric_entry& entry = metric_entries[metric];
+    entry.name  = name;
+    entry.hash  = hash;
+    entry.type  = type;
+    *slot       = metric + 1;
+
+    kb_atomic_store_release_u32(&metric_entry_count, metric + 1);
+  }
+
+  kb_lock_unlock(&metric_lock);
+
+  return metric;
+}
+
+KB_API kb_metric kb_metric_find(kb_hash hash) {
+  kb_lock_lock(&metric_lock);
+  uint32_t index = *metric_table_slot(hash);
+  kb_lock_unlock(&metric_lock);
+
+  return index != 0 ? index - 1 : KB_METRIC_INVALID;
+}
+
+KB_API void kb_metric_add(kb_metric metric, int64_t value) {
+  metric_assert_valid(metric);
+
+  if (metric_entries[metric].type == KB_METRIC_GAUGE) {
+    kb_atomic_fetch_add_u64(&metric_gauges[metric], (uint64_t) value);
+    return;
+  }
+
+  kb_atomic_u64* shard = &metric_shards[kb_thread_index()][metric];
+  kb_atomic_store_relaxed_u64(shard, kb_atomic_load_relaxed_u64(shard) + (uint64_t) value);
+}
+
+KB_API void kb_metric_set(kb_metric metric, int64_t value) {
+  metric_assert_valid(metric);
+  KB_ASSERT(metric_entries[metric].type == KB_METRIC_GAUGE, "Only gauges can be set");
+
+  kb_atomic_store_relaxed_u64(&metric_gauges[metric], (uint64_t) value);
+}
+
+KB_API int64_t kb_metric_value(kb_metric metric) {
+  metric_assert_valid(metric);
+
+  if (metric_entries[metric].type == KB_METRIC_GAUGE) {
+    return (int64_t) kb_atomic_load_relaxed_u64(&metric_gauges[metric]);
+  }
+
+  uint64_t total = 0;
+  uint32_t thread_count = kb_thread_count();
+
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    total += kb_atomic_load_relaxed_u64(&metric_shards[i][metric]);
+  }
+
+  return (int64_t) total;
+}
+
+KB_API void kb_metric_frame() {
+  kb_lock_lock(&metric_lock);
+
+  uint32_t count = kb_atomic_load_relaxed_u32(&metric_entry_count);
+
+  for (kb_metric metric = 0; metric < count; ++metric) {
+    metric_entry& entry = metric_entries[metric];
+
+    if (entry.sampler.values == NULL) {
+      kb_sampler_create(&entry.sampler, KB_CONFIG_STATS_SAMPLE_COUNT);
+    }
+
+    int64_t value = kb_metric_value(metric);
+
+    if (entry.type == KB_METRIC_COUNTER) {
+      entry.frame       = value - entry.last_total;
+      entry.last_total  = value;
+    } else {
+      entry.frame       = value;
+    }
+
+    kb_sampler_push(&entry.sampler, (float) entry.frame);
+  }
+
+  kb_lock_unlock(&metric_lock);
+}
+
+KB_API uint32_t kb_metric_count() {
+  return kb_atomic_load_acquire_u32(&metric_entry_count);
+}
+
+KB_API void kb_metric_get_info(kb_metric metric, kb_metric_info* dst) {
+  metric_assert_valid(metric);
+  KB_ASSERT_NOT_NULL(dst);
+
+  kb_lock_lock(&metric_lock);
+
+  const metric_entry& entry = metric_entries[metric];
+
+  dst->name   = entry.name;
+  dst->hash   = entry.hash;
+  dst->type   = entry.type;
+  dst->value  = kb_metric_value(metric);
+  dst->frame  = entry.frame;
+  dst->avg    = entry.sampler.avg;
+  dst->min    = entry.sampler.min;
+  dst->max    = entry.sampler.max;
+
+  kb_lock_unlock(&metric_lock);
+}
+
+KB_API void kb_metric_dump() {
+  uint32_t count = kb_metric_count();
+
+  kb_printf("%-32s %-8s %14s %12s %12s %12s %12s\n", "metric", "type", "value", "frame", "avg", "min", "max");
+
+  for (kb_metric metric = 0; metric < count; ++metric) {
+    kb_metric_info info;
+    kb_metric_get_info(metric, &info);
+
+    kb_printf("%-32s %-8s %14lld %12lld %12.2f %12.2f %12.2f\n", info.name,
+      info.type == KB_METRIC_COUNTER ? "counter" : "gauge",
+      (long long) info.value, (long long) info.frame, info.avg, info.min, info.max);
+  }
+}
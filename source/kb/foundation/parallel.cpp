@@ -0,0 +1,345 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+#include <kb/foundation/parallel.h>
+#include <kb/foundation/alloc.h>
+#include <kb/foundation/crt.h>
+
+#include <atomic>
+
+#define KB_PARALLEL_CHUNKS_PER_THREAD 4
+#define KB_PARALLEL_SORT_MIN_COUNT    4096
+
+typedef struct parallel_task {
+  kb_parallel_for_func  func;
+  void*                 userdata;
+  uint64_t              count;
+  uint64_t              grain;
+  uint64_t              chunk_count;
+  std::atomic<uint64_t> next_chunk;
+} parallel_task;
+
+// Reduce partials, prefix sums and sort buffers come from a per thread block
+// handed out stack-wise, so repeated calls don't touch the heap. A nested call
+// that doesn't fit gets its own heap block and the next outermost call grows
+// the thread's block to cover both.
+struct parallel_scratch {
+  uint8_t*  data      = NULL;
+  uint64_t  capacity  = 0;
+  uint64_t  used      = 0;
+  uint64_t  wanted    = 0;
+
+  ~parallel_scratch() {
+    KB_DEFAULT_FREE(data);
+  }
+};
+
+KB_INTERNAL thread_local parallel_scratch scratch;
+
+KB_INTERNAL uint64_t scratch_size(uint64_t size) {
+  return (size + 15) & ~(uint64_t) 15;
+}
+
+KB_INTERNAL void* scratch_push(uint64_t size) {
+  size = scratch_size(size);
+
+  if (scratch.used == 0) {
+    const uint64_t capacity = size > scratch.wanted ? size : scratch.wanted;
+
+    if (scratch.capacity < capacity) {
+      KB_DEFAULT_FREE(scratch.data);
+      scratch.data      = (uint8_t*) KB_DEFAULT_ALLOC_ALIGN(capacity, 16);
+      scratch.capacity  = capacity;
+    }
+  }
+
+  if (scratch.used + size > scratch.capacity) {
+    if (scratch.used + size > scratch.wanted) scratch.wanted = scratch.used + size;
+    return KB_DEFAULT_ALLOC_ALIGN(size, 16);
+  }
+
+  void* ptr = scratch.data + scratch.used;
+  scratch.used += size;
+
+  return ptr;
+}
+
+KB_INTERNAL void scratch_pop(void* ptr, uint64_t size) {
+  if ((uint8_t*) ptr < scratch.data || (uint8_t*) ptr >= scratch.data + scratch.capacity) {
+    KB_DEFAULT_FREE(ptr);
+    return;
+  }
+
+  scratch.used -= scratch_size(size);
+  KB_ASSERT(scratch.data + scratch.used == ptr, "Parallel scratch released out of order");
+}
+
+KB_INTERNAL uint64_t parallel_worker_count(kb_thread_pool* pool) {
+  return pool != NULL ? (uint64_t) kb_threadpool_thread_count(pool) : 0;
+}
+
+KB_INTERNAL uint64_t parallel_resolve_grain(kb_thread_pool* pool, uint64_t count, uint64_t grain) {
+  if (grain > 0) return grain;
+
+  const uint64_t chunks = (parallel_worker_count(pool) + 1) * KB_PARALLEL_CHUNKS_PER_THREAD;
+  grain = (count + chunks - 1) / chunks;
+
+  return grain > 0 ? grain : 1;
+}
+
+KB_INTERNAL void parallel_task_run(parallel_task* task) {
+  while (true) {
+    const uint64_t chunk = task->next_chunk.fetch_add(1, std::memory_order_relaxed);
+    if (chunk >= task->chunk_count) break;
+
+    const uint64_t begin  = chunk * task->grain;
+    const uint64_t end    = begin + task->grain < task->count ? begin + task->grain : task->count;
+
+    task->func(begin, end, task->userdata);
+  }
+}
+
+KB_INTERNAL void parallel_task_job(void* userdata) {
+  parallel_task_run((parallel_task*) userdata);
+}
+
+KB_API void kb_parallel_for(kb_thread_pool* pool, uint64_t count, uint64_t grain, kb_parallel_for_func func, void* userdata) {
+  KB_ASSERT_NOT_NULL(func);
+
+  if (count == 0) return;
+
+  grain = parallel_resolve_grain(pool, count, grain);
+
+  const uint64_t chunk_count  = (count + grain - 1) / grain;
+  const uint64_t workers      = parallel_worker_count(pool);
+
+  if (workers == 0 || chunk_count == 1) {
+    for (uint64_t begin = 0; begin < count; begin += grain) {
+      func(begin, begin + grain < count ? begin + grain : count, userdata);
+    }
+    return;
+  }
+
+  const uint64_t helpers = workers < chunk_count - 1 ? workers : chunk_count - 1;
+
+  // Task stays on the stack, the wait below covers helpers that are picked up
+  // late and runs other jobs meanwhile, so nested calls from jobs can't stall
+  parallel_task task;
+  task.func        = func;
+  task.userdata    = userdata;
+  task.count       = count;
+  task.grain       = grain;
+  task.chunk_count = chunk_count;
+  task.next_chunk.store(0, std::memory_order_relaxed);
+
+  kb_job_counter helpers_done {};
+
+  for (uint64_t i = 0; i < helpers; ++i) {
+    kb_threadpool_add_counted_job(pool, &task, parallel_task_job, &helpers_done);
+  }
+
+  parallel_task_run(&task);
+  kb_job_wait(pool, &helpers_done);
+}
+
+typedef struct parallel_reduce_ctx {
+  kb_parallel_reduce_func func;
+  void*                   userdata;
+  uint64_t                grain;
+  uint64_t                result_size;
+  uint8_t*                partials;
+} parallel_reduce_ctx;
+
+KB_INTERNAL void parallel_reduce_chunk(uint64_t begin, uint64_t end, void* userdata) {
+  parallel_reduce_ctx* ctx = (parallel_reduce_ctx*) userdata;
+
+  ctx->func(begin, end, ctx->partials + (begin / ctx->grain) * ctx->result_size, ctx->userdata);
+}
+
+KB_API void kb_parallel_reduce(kb_thread_pool* pool, uint64_t count, uint64_t grain, void* result, uint64_t result_size, kb_parallel_reduce_func func, kb_parallel_combine_func combine, void* userdata) {
+  KB_ASSERT_NOT_NULL(result);
+  KB_ASSERT_NOT_NULL(func);
+  KB_ASSERT_NOT_NULL(combine);
+
+  if (count == 0) return;
+
+  grain = parallel_resolve_grain(pool, count, grain);
+
+  const uint64_t chunk_count = (count + grain - 1) / grain;
+
+  // `result` holds the identity on entry, every partial starts from a copy of it
+  parallel_reduce_ctx ctx;
+  ctx.func        = func;
+  ctx.userdata    = userdata;
+  ctx.grain       = grain;
+  ctx.result_size = result_size;
+  ctx.partials    = (uint8_t*) scratch_push(result_size * chunk_count);
+
+  for (uint64_t i = 0; i < chunk_count; ++i) {
+    kb_memcpy(ctx.partials + i * result_size, result, result_size);
+  }
+
+  kb_parallel_for(pool, count, grain, parallel_reduce_chunk, &ctx);
+
+  for (uint64_t i = 0; i < chunk_count; ++i) {
+    combine(result, ctx.partials + i * result_size, userdata);
+  }
+
+  scratch_pop(ctx.partials, result_size * chunk_count);
+}
+
+template <typename T>
+KB_INTERNAL uint64_t parallel_prefix_sum(kb_thread_pool* pool, T* dst, const T* src, uint64_t count) {
+  if (count == 0) return 0;
+
+  const uint64_t grain        = parallel_resolve_grain(pool, count, 0);
+  const uint64_t chunk_count  = (count + grain - 1) / grain;
+
+  T* sums = (T*) scratch_push(sizeof(T) * chunk_count);
+
+  // Pass 1: per chunk totals
+  kb::parallel_for(pool, count, grain, [&](uint64_t begin, uint64_t end) {
+    T sum = 0;
+    for (uint64_t i = begin; i < end; ++i) sum += src[i];
+    sums[begin / grain] = sum;
+  });
+
+  uint64_t total = 0;
+  for (uint64_t i = 0; i < chunk_count; ++i) {
+    T sum = sums[i];
+    sums[i] = (T) total;
+    total += sum;
+  }
+
+  // Pass 2: exclusive scan of each chunk from its offset, src may alias dst
+  kb::parallel_for(pool, count, grain, [&](uint64_t begin, uint64_t end) {
+    T acc = sums[begin / grain];
+    for (uint64_t i = begin; i < end; ++i) {
+      T v = src[i];
+      dst[i] = acc;
+      acc += v;
+    }
+  });
+
+  scratch_pop(sums, sizeof(T) * chunk_count);
+
+  return total;
+}
+
+template <typename T>
+KB_INTERNAL void radix_sort(T* data, T* temp, uint64_t count) {
+  if (count < 2) return;
+
+  T* src = data;
+  T* dst = temp;
+
+  for (uint32_t shift = 0; shift < sizeof(T) * 8; shift += 8) {
+    uint64_t hist[256] = {};
+
+    for (uint64_t i = 0; i < count; ++i) {
+      hist[(src[i] >> shift) & 0xFF]++;
+    }
+
+    // Every key shares this digit, pass would be a plain copy
+    if (hist[(src[0] >> shift) & 0xFF] == count) continue;
+
+    uint64_t offset = 0;
+    for (uint32_t d = 0; d < 256; ++d) {
+      uint64_t c = hist[d];
+      hist[d] = offset;
+      offset += c;
+    }
+
+    for (uint64_t i = 0; i < count; ++i) {
+      dst[hist[(src[i] >> shift) & 0xFF]++] = src[i];
+    }
+
+    T* tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+  if (src != data) {
+    kb_memcpy(data, src, count * sizeof(T));
+  }
+}
+
+template <typename T>
+KB_INTERNAL void merge_runs(T* dst, const T* a, const T* a_end, const T* b, const T* b_end) {
+  while (a < a_end && b < b_end) {
+    *dst++ = *b < *a ? *b++ : *a++;
+  }
+
+  while (a < a_end) *dst++ = *a++;
+  while (b < b_end) *dst++ = *b++;
+}
+
+template <typename T>
+KB_INTERNAL void parallel_sort(kb_thread_pool* pool, T* data, uint64_t count) {
+  if (count < 2) return;
+
+  T* temp = (T*) scratch_push(sizeof(T) * count);
+
+  const uint64_t workers = parallel_worker_count(pool);
+
+  if (workers == 0 || count < KB_PARALLEL_SORT_MIN_COUNT) {
+    radix_sort(data, temp, count);
+    scratch_pop(temp, sizeof(T) * count);
+    return;
+  }
+
+  // One radix-sorted run per thread
+  const uint64_t runs     = workers + 1;
+  const uint64_t run_size = (count + runs - 1) / runs;
+
+  kb::parallel_for(pool, count, run_size, [&](uint64_t begin, uint64_t end) {
+    radix_sort(data + begin, temp + begin, end - begin);
+  });
+
+  // Pairwise merge rounds, ping-ponging between data and temp
+  T* src = data;
+  T* dst = temp;
+
+  for (uint64_t width = run_size; width < count; width *= 2) {
+    const uint64_t pair_count = (count + width * 2 - 1) / (width * 2);
+
+    kb::parallel_for(pool, pair_count, 1, [&](uint64_t begin, uint64_t end) {
+      for (uint64_t p = begin; p < end; ++p) {
+        const uint64_t lo   = p * width * 2;
+        const uint64_t mid  = lo + width < count ? lo + width : count;
+        const uint64_t hi   = mid + width < count ? mid + width : count;
+
+        merge_runs(dst + lo, src + lo, src + mid, src + mid, src + hi);
+      }
+    });
+
+    T* tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+  if (src != data) {
+    kb_memcpy(data, src, count * sizeof(T));
+  }
+
+  scratch_pop(temp, sizeof(T) * count);
+}
+
+KB_API uint64_t kb_parallel_prefix_sum_u32(kb_thread_pool* pool, uint32_t* dst, const uint32_t* src, uint64_t count) {
+  return parallel_prefix_sum(pool, dst, src, count);
+}
+
+KB_API uint64_t kb_parallel_prefix_sum_u64(kb_thread_pool* pool, uint64_t* dst, const uint64_t* src, uint64_t count) {
+  return parallel_prefix_sum(pool, dst, src, count);
+}
+
+KB_API void kb_parallel_sort_u32(kb_thread_pool* pool, uint32_t* data, uint64_t count) {
+  parallel_sort(pool, data, count);
+}
+
+KB_API void kb_parallel_sort_u64(kb_thread_pool* pool, uint64_t* data, uint64_t count) {
+  parallel_sort(pool, data, count);
+}
@@ -0,0 +1,441 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+#include <kb/foundation/profile.h>
+
+#include <kb/foundation/alloc.h>
+#include <kb/foundation/atomic.h>
+#include <kb/foundation/crt.h>
+#include <kb/foundation/sync.h>
+#include <kb/foundation/time.h>
+
+#define KB_PROFILE_CHUNK_EVENTS     4096
+#define KB_PROFILE_MAX_CHUNKS       256
+#define KB_PROFILE_THREAD_NAME_SIZE 32
+#define KB_PROFILE_CAPTURING        1u
+#define KB_PROFILE_MAGIC            KB_FOURCC('K', 'B', 'P', 'F')
+#define KB_PROFILE_VERSION          1
+
+typedef enum profile_event_type {
+  PROFILE_EVENT_BEGIN   = 0,
+  PROFILE_EVENT_END     = 1,
+  PROFILE_EVENT_FRAME   = 2,
+  PROFILE_EVENT_COUNTER = 3,
+} profile_event_type;
+
+typedef struct profile_event {
+  uint64_t              time;   // kb_time_get_fast ticks
+  const char*           name;
+  double                value;
+  uint32_t              type;
+} profile_event;
+
+typedef struct profile_chunk {
+  profile_chunk*        next;
+  profile_event         events[KB_PROFILE_CHUNK_EVENTS];
+} profile_chunk;
+
+// Written only by its owner. Readers see events up to count, published with
+// a release store, and chunks are never freed so a thread can exit mid frame.
+// Once the owner has exited the record stays in the list until the next
+// kb_profile_start, which moves it to the free list for a new thread to take.
+typedef struct profile_thread {
+  profile_thread*       next;
+  uint32_t              id;
+  char                  name[KB_PROFILE_THREAD_NAME_SIZE];
+  kb_atomic_u32         epoch;
+  kb_atomic_u32         count;
+  profile_chunk*        first;
+  profile_chunk*        current;
+  bool                  exited;   // Guarded by profile_threads_lock
+} profile_thread;
+
+// Low bit is the capture flag, the rest counts captures
+KB_INTERNAL kb_atomic_u32             profile_state;
+KB_INTERNAL kb_atomic_u64             profile_start_time;
+KB_INTERNAL kb_lock                   profile_threads_lock;
+KB_INTERNAL profile_thread*           profile_threads;
+KB_INTERNAL profile_thread*           profile_free_threads;
+KB_INTERNAL uint32_t                  profile_thread_count;
+KB_INTERNAL thread_local profile_thread* profile_current_thread = NULL;
+
+// Flags the record when its thread exits. Kept apart from the plain pointer
+// above so recording doesn't pay for the destructor guard.
+struct profile_thread_owner {
+  profile_thread* thread = NULL;
+
+  ~profile_thread_owner() {
+    if (thread == NULL) return;
+
+    kb_lock_lock(&profile_threads_lock);
+    thread->exited = true;
+    kb_lock_unlock(&profile_threads_lock);
+  }
+};
+
+KB_INTERNAL thread_local profile_thread_owner profile_owner;
+
+KB_INTERNAL profile_thread* profile_thread_get() {
+  if (profile_current_thread != NULL) return profile_current_thread;
+
+  kb_lock_lock(&profile_threads_lock);
+
+  profile_thread* thread = profile_free_threads;
+
+  if (thread != NULL) {
+    profile_free_threads = thread->next;
+  } else {
+    thread = KB_DEFAULT_ALLOC_TYPE(profile_thread, 1);
+    *thread = {};
+    thread->id          = profile_thread_count++;
+    thread->first       = KB_DEFAULT_ALLOC_TYPE(profile_chunk, 1);
+    thread->first->next = NULL;
+  }
+
+  // Epoch 0 never matches a capture, the first event rewinds the buffer
+  kb_atomic_store_relaxed_u32(&thread->epoch, 0);
+  kb_atomic_store_relaxed_u32(&thread->count, 0);
+  thread->current = thread->first;
+  thread->exited  = false;
+  thread->next    = profile_threads;
+  kb_snprintf(thread->name, KB_PROFILE_THREAD_NAME_SIZE, "thread %u", thread->id);
+  profile_threads = thread;
+
+  kb_lock_unlock(&profile_threads_lock);
+
+  profile_current_thread  = thread;
+  profile_owner.thread    = thread;
+  return thread;
+}
+
+KB_INTERNAL void profile_record(uint32_t type, const char* name, double value) {
+  const uint32_t state = kb_atomic_load_relaxed_u32(&profile_state);
+  if (!(state & KB_PROFILE_CAPTURING)) return;
+
+  profile_thread* thread = profile_thread_get();
+  uint32_t count = kb_atomic_load_relaxed_u32(&thread->count);
+
+  // First event of a new capture rewinds the buffer
+  if (kb_atomic_load_relaxed_u32(&thread->epoch) != state) {
+    kb_atomic_store_relaxed_u32(&thread->count, 0);
+    kb_atomic_store_release_u32(&thread->epoch, state);
+    thread->current = thread->first;
+    count = 0;
+  }
+
+  const uint32_t slot = count % KB_PROFILE_CHUNK_EVENTS;
+
+  if (slot == 0 && count > 0) {
+    if (count >= KB_PROFILE_CHUNK_EVENTS * KB_PROFILE_MAX_CHUNKS) return;
+
+    if (thread->current->next == NULL) {
+      profile_chunk* chunk = KB_DEFAULT_ALLOC_TYPE(profile_chunk, 1);
+      chunk->next = NULL;
+      thread->current->next = chunk;
+    }
+
+    thread->current = thread->current->next;
+  }
+
+  profile_event& event = thread->current->events[slot];
+  event.time  = kb_time_get_fast();
+  event.name  = name;
+  event.value = value;
+  event.type  = type;
+
+  kb_atomic_store_release_u32(&thread->count, count + 1);
+}
+
+KB_API void kb_profile_start() {
+  // Records of exited threads only held events of the capture being dropped
+  kb_lock_lock(&profile_threads_lock);
+
+  profile_thread** link = &profile_threads;
+  while (profile_thread* thread = *link) {
+    if (!thread->exited) {
+      link = &thread->next;
+      continue;
+    }
+
+    *link                 = thread->next;
+    thread->next          = profile_free_threads;
+    profile_free_threads  = thread;
+  }
+
+  kb_lock_unlock(&profile_threads_lock);
+
+  kb_atomic_store_u64(&profile_start_time, kb_time_get_fast());
+
+  // Bumping the capture count makes every thread rewind on its next event
+  uint32_t state = kb_atomic_load_u32(&profile_state);
+  kb_atomic_store_u32(&profile_state, (state | KB_PROFILE_CAPTURING) + 2);
+}
+
+KB_API void kb_profile_stop() {
+  kb_atomic_fetch_and_u32(&profile_state, ~KB_PROFILE_CAPTURING);
+}
+
+KB_API bool kb_profile_is_capturing() {
+  return kb_atomic_load_relaxed_u32(&profile_state) & KB_PROFILE_CAPTURING;
+}
+
+KB_API void kb_profile_begin(const char* name) {
+  profile_record(PROFILE_EVENT_BEGIN, name, 0.0);
+}
+
+KB_API void kb_profile_end() {
+  profile_record(PROFILE_EVENT_END, NULL, 0.0);
+}
+
+KB_API void kb_profile_frame_mark() {
+  profile_record(PROFILE_EVENT_FRAME, "frame", 0.0);
+}
+
+KB_API void kb_profile_counter(const char* name, double value) {
+  profile_record(PROFILE_EVENT_COUNTER, name, value);
+}
+
+KB_API void kb_profile_set_thread_name(const char* name) {
+  KB_ASSERT_NOT_NULL(name);
+
+  profile_thread* thread = profile_thread_get();
+
+  // Exports copy names under the same lock
+  kb_lock_lock(&profile_threads_lock);
+  kb_strncpy(thread->name, name, KB_PROFILE_THREAD_NAME_SIZE - 1);
+  thread->name[KB_PROFILE_THREAD_NAME_SIZE - 1] = '\0';
+  kb_lock_unlock(&profile_threads_lock);
+}
+
+//#####################################################################################################################
+// Export
+//#####################################################################################################################
+
+typedef void (*profile_event_visitor)(const profile_thread* thread, const profile_event& event, void* userdata);
+
+// Threads and event counts of the current capture at one point in time, so
+// every export pass sees the same events
+typedef struct profile_snapshot {
+  const profile_thread**  threads;
+  uint32_t*               counts;
+  char                    (*names)[KB_PROFILE_THREAD_NAME_SIZE];
+  uint32_t                thread_count;
+} profile_snapshot;
+
+KB_INTERNAL profile_snapshot profile_snapshot_take() {
+  const uint32_t state = kb_atomic_load_u32(&profile_state) | KB_PROFILE_CAPTURING;
+
+  kb_lock_lock(&profile_threads_lock);
+
+  profile_snapshot snapshot = {};
+  snapshot.threads  = KB_DEFAULT_ALLOC_TYPE(const profile_thread*, profile_thread_count + 1);
+  snapshot.counts   = KB_DEFAULT_ALLOC_TYPE(uint32_t, profile_thread_count + 1);
+  snapshot.names    = (char (*)[KB_PROFILE_THREAD_NAME_SIZE]) KB_DEFAULT_ALLOC(KB_PROFILE_THREAD_NAME_SIZE * (profile_thread_count + 1));
+
+  for (const profile_thread* thread = profile_threads; thread != NULL; thread = thread->next) {
+    const bool current = kb_atomic_load_acquire_u32(&thread->epoch) == state;
+
+    snapshot.threads[snapshot.thread_count] = thread;
+    snapshot.counts[snapshot.thread_count]  = current ? kb_atomic_load_acquire_u32(&thread->count) : 0;
+    kb_memcpy(snapshot.names[snapshot.thread_count], thread->name, KB_PROFILE_THREAD_NAME_SIZE);
+    snapshot.thread_count++;
+  }
+
+  kb_lock_unlock(&profile_threads_lock);
+
+  return snapshot;
+}
+
+KB_INTERNAL void profile_snapshot_release(profile_snapshot* snapshot) {
+  KB_DEFAULT_FREE(snapshot->threads);
+  KB_DEFAULT_FREE(snapshot->counts);
+  KB_DEFAULT_FREE(snapshot->names);
+}
+
+// Events thread by thread in recording order
+KB_INTERNAL void profile_visit(const profile_snapshot* snapshot, profile_event_visitor visitor, void* userdata) {
+  for (uint32_t thread_i = 0; thread_i < snapshot->thread_count; ++thread_i) {
+    const profile_thread* thread = snapshot->threads[thread_i];
+    const profile_chunk*  chunk  = thread->first;
+
+    for (uint32_t i = 0; i < snapshot->counts[thread_i]; ++i) {
+      if (i > 0 && i % KB_PROFILE_CHUNK_EVENTS == 0) chunk = chunk->next;
+      visitor(thread, chunk->events[i % KB_PROFILE_CHUNK_EVENTS], userdata);
+    }
+  }
+}
+
+KB_INTERNAL int64_t profile_event_ns(const profile_event& event) {
+  const uint64_t start = kb_atomic_load_relaxed_u64(&profile_start_time);
+  return event.time > start ? kb_time_fast_to_ns(event.time - start) : 0;
+}
+
+KB_INTERNAL void profile_write_str(kb_stream* dst, const char* str) {
+  kb_stream_write(dst, str, kb_strlen(str), 1);
+}
+
+// Names come from code, escaping quotes and backslashes is enough
+KB_INTERNAL void profile_write_json_str(kb_stream* dst, const char* str) {
+  char buffer[256];
+  uint32_t pos = 0;
+
+  buffer[pos++] = '"';
+  for (const char* c = str; *c && pos < sizeof(buffer) - 3; ++c) {
+    if (*c == '"' || *c == '\\') buffer[pos++] = '\\';
+    buffer[pos++] = (unsigned char) *c < 0x20 ? ' ' : *c;
+  }
+  buffer[pos++] = '"';
+
+  kb_stream_write(dst, buffer, pos, 1);
+}
+
+typedef struct profile_json_ctx {
+  kb_stream*            dst;
+  bool                  first;
+} profile_json_ctx;
+
+KB_INTERNAL void profile_write_json_event(const profile_thread* thread, const profile_event& event, void* userdata) {
+  profile_json_ctx* ctx = (profile_json_ctx*) userdata;
+  char buffer[128];
+
+  profile_write_str(ctx->dst, ctx->first ? "\n" : ",\n");
+  ctx->first = false;
+
+  const int64_t ns = profile_event_ns(event);
+
+  switch (event.type) {
+    case PROFILE_EVENT_BEGIN: {
+      profile_write_str(ctx->dst, "{\"name\":");
+      profile_write_json_str(ctx->dst, event.name);
+      kb_snprintf(buffer, sizeof(buffer), ",\"ph\":\"B\",\"ts\":%lld.%03lld,\"pid\":0,\"tid\":%u}", (long long) (ns / 1000), (long long) (ns % 1000), thread->id);
+    } break;
+
+    case PROFILE_EVENT_END: {
+      kb_snprintf(buffer, sizeof(buffer), "{\"ph\":\"E\",\"ts\":%lld.%03lld,\"pid\":0,\"tid\":%u}", (long long) (ns / 1000), (long long) (ns % 1000), thread->id);
+    } break;
+
+    case PROFILE_EVENT_FRAME: {
+      profile_write_str(ctx->dst, "{\"name\":\"frame\"");
+      kb_snprintf(buffer, sizeof(buffer), ",\"ph\":\"i\",\"s\":\"g\",\"ts\":%lld.%03lld,\"pid\":0,\"tid\":%u}", (long long) (ns / 1000), (long long) (ns % 1000), thread->id);
+    } break;
+
+    case PROFILE_EVENT_COUNTER: {
+      profile_write_str(ctx->dst, "{\"name\":");
+      profile_write_json_str(ctx->dst, event.name);
+      kb_snprintf(buffer, sizeof(buffer), ",\"ph\":\"C\",\"ts\":%lld.%03lld,\"pid\":0,\"tid\":%u,\"args\":{\"value\":%g}}", (long long) (ns / 1000), (long long) (ns % 1000), thread->id, event.value);
+    } break;
+  }
+
+  profile_write_str(ctx->dst, buffer);
+}
+
+KB_API bool kb_profile_write_json(kb_stream* dst) {
+  if (dst == NULL) return false;
+
+  profile_json_ctx ctx = { dst, true };
+  char buffer[128];
+
+  profile_snapshot snapshot = profile_snapshot_take();
+
+  profile_write_str(dst, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+  // Thread names as metadata events
+  for (uint32_t i = 0; i < snapshot.thread_count; ++i) {
+    profile_write_str(dst, ctx.first ? "\n" : ",\n");
+    ctx.first = false;
+
+    kb_snprintf(buffer, sizeof(buffer), "{\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":", snapshot.threads[i]->id);
+    profile_write_str(dst, buffer);
+    profile_write_json_str(dst, snapshot.names[i]);
+    profile_write_str(dst, "}}");
+  }
+
+  profile_visit(&snapshot, profile_write_json_event, &ctx);
+  profile_snapshot_release(&snapshot);
+
+  profile_write_str(dst, "\n]}\n");
+  return true;
+}
+
+// Binary layout, little endian:
+//   u32 magic 'KBPF', u32 version, u32 name count, u32 thread count
+//   names:   u32 length, bytes
+//   threads: u32 id, char name[32]
+//   events until the end: u64 ns, u32 thread id, u32 type, u32 name index, f64 value
+// Name index UINT32_MAX means no name.
+
+typedef struct profile_binary_ctx {
+  kb_stream*            dst;
+  const char**          names;
+  uint32_t              name_count;
+  uint32_t              name_capacity;
+} profile_binary_ctx;
+
+KB_INTERNAL uint32_t profile_name_index(profile_binary_ctx* ctx, const char* name) {
+  if (name == NULL) return UINT32_MAX;
+
+  for (uint32_t i = 0; i < ctx->name_count; ++i) {
+    if (ctx->names[i] == name) return i;
+  }
+
+  if (ctx->name_count == ctx->name_capacity) {
+    uint32_t capacity = ctx->name_capacity > 0 ? ctx->name_capacity * 2 : 64;
+    ctx->names = (const char**) KB_DEFAULT_REALLOC(ctx->names, capacity * sizeof(const char*));
+    ctx->name_capacity = capacity;
+  }
+
+  ctx->names[ctx->name_count] = name;
+  return ctx->name_count++;
+}
+
+KB_INTERNAL void profile_collect_name(const profile_thread* thread, const profile_event& event, void* userdata) {
+  profile_name_index((profile_binary_ctx*) userdata, event.name);
+}
+
+KB_INTERNAL void profile_write_binary_event(const profile_thread* thread, const profile_event& event, void* userdata) {
+  profile_binary_ctx* ctx = (profile_binary_ctx*) userdata;
+
+  uint64_t  ns    = (uint64_t) profile_event_ns(event);
+  uint32_t  name  = profile_name_index(ctx, event.name);
+
+  kb_write(ctx->dst, ns);
+  kb_write(ctx->dst, thread->id);
+  kb_write(ctx->dst, event.type);
+  kb_write(ctx->dst, name);
+  kb_write(ctx->dst, event.value);
+}
+
+KB_API bool kb_profile_write_binary(kb_stream* dst) {
+  if (dst == NULL) return false;
+
+  profile_binary_ctx ctx = { dst, NULL, 0, 0 };
+  profile_snapshot snapshot = profile_snapshot_take();
+
+  // Name table goes first so readers can resolve events as they stream in
+  profile_visit(&snapshot, profile_collect_name, &ctx);
+
+  kb_write(dst, (uint32_t) KB_PROFILE_MAGIC);
+  kb_write(dst, (uint32_t) KB_PROFILE_VERSION);
+  kb_write(dst, ctx.name_count);
+  kb_write(dst, snapshot.thread_count);
+
+  for (uint32_t i = 0; i < ctx.name_count; ++i) {
+    uint32_t length = (uint32_t) kb_strlen(ctx.names[i]);
+    kb_write(dst, length);
+    kb_stream_write(dst, ctx.names[i], length, 1);
+  }
+
+  for (uint32_t i = 0; i < snapshot.thread_count; ++i) {
+    kb_write(dst, snapshot.threads[i]->id);
+    kb_stream_write(dst, snapshot.names[i], KB_PROFILE_THREAD_NAME_SIZE, 1);
+  }
+
+  profile_visit(&snapshot, profile_write_binary_event, &ctx);
+  profile_snapshot_release(&snapshot);
+
+  KB_DEFAULT_FREE(ctx.names);
+  return true;
+}
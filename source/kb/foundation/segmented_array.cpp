@@ -0,0 +1,142 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+#include <kb/foundation/segmented_array.h>
+#include <kb/foundation/alloc.h>
+#include <kb/foundation/crt.h>
+
+#define KB_SEGMENTED_ARRAY_MIN_BLOCK_TABLE 8
+
+KB_INTERNAL uint64_t segmented_block_size(const kb_segmented_array* array) {
+  return 1ull << array->block_shift;
+}
+
+KB_INTERNAL void segmented_grow_block_table(kb_segmented_array* array, uint32_t needed) {
+  if (array->block_cap >= needed) return;
+
+  uint32_t new_cap = array->block_cap > 0 ? array->block_cap : KB_SEGMENTED_ARRAY_MIN_BLOCK_TABLE;
+  while (new_cap < needed) new_cap *= 2;
+
+  // Only the pointer table moves, blocks themselves stay in place
+  array->blocks = KB_DEFAULT_REALLOC_TYPE(void*, array->blocks, new_cap);
+  KB_ASSERT(array->blocks, "Failed to reallocate block table");
+
+  array->block_cap = new_cap;
+}
+
+KB_API void kb_segmented_array_create(kb_segmented_array* array, uint64_t elem_size, uint64_t block_size) {
+  KB_ASSERT_NOT_NULL(array);
+  KB_ASSERT(elem_size > 0, "Element size must be non-zero");
+
+  uint32_t shift = 0;
+  while ((1ull << shift) < block_size) shift++;
+
+  array->elem_size    = elem_size;
+  array->block_shift  = shift;
+  array->block_count  = 0;
+  array->block_cap    = 0;
+  array->pos          = 0;
+  array->blocks       = NULL;
+}
+
+KB_API void kb_segmented_array_destroy(kb_segmented_array* array) {
+  KB_ASSERT_NOT_NULL(array);
+
+  for (uint32_t i = 0; i < array->block_count; ++i) {
+    KB_DEFAULT_FREE(array->blocks[i]);
+  }
+
+  if (array->blocks) {
+    KB_DEFAULT_FREE(array->blocks);
+  }
+
+  kb_memset(array, '\0', sizeof(kb_segmented_array));
+}
+
+KB_API void kb_segmented_array_reset(kb_segmented_array* array) {
+  KB_ASSERT_NOT_NULL(array);
+
+  array->pos = 0;
+}
+
+KB_API uint64_t kb_segmented_array_count(const kb_segmented_array* array) {
+  KB_ASSERT_NOT_NULL(array);
+
+  return array->pos;
+}
+
+KB_API uint64_t kb_segmented_array_capacity(const kb_segmented_array* array) {
+  KB_ASSERT_NOT_NULL(array);
+
+  return (uint64_t) array->block_count << array->block_shift;
+}
+
+KB_API uint64_t kb_segmented_array_block_size(const kb_segmented_array* array) {
+  KB_ASSERT_NOT_NULL(array);
+
+  return segmented_block_size(array);
+}
+
+KB_API void kb_segmented_array_reserve(kb_segmented_array* array, uint64_t size) {
+  KB_ASSERT_NOT_NULL(array);
+
+  if (kb_segmented_array_capacity(array) >= size) return;
+
+  const uint64_t block_size   = segmented_block_size(array);
+  const uint32_t needed       = (uint32_t) ((size + block_size - 1) >> array->block_shift);
+
+  segmented_grow_block_table(array, needed);
+
+  for (uint32_t i = array->block_count; i < needed; ++i) {
+    array->blocks[i] = KB_DEFAULT_ALLOC(array->elem_size * block_size);
+    KB_ASSERT(array->blocks[i], "Failed to allocate array block");
+  }
+
+  array->block_count = needed;
+}
+
+KB_API void kb_segmented_array_resize(kb_segmented_array* array, uint64_t size) {
+  kb_segmented_array_reserve(array, size);
+  array->pos = size;
+}
+
+KB_API void* kb_segmented_array_at(const kb_segmented_array* array, uint64_t index) {
+  KB_ASSERT_NOT_NULL(array);
+
+  if (index >= kb_segmented_array_capacity(array)) return nullptr;
+
+  const uint64_t block  = index >> array->block_shift;
+  const uint64_t offset = index & (segmented_block_size(array) - 1);
+
+  return &((uint8_t*) array->blocks[block])[array->elem_size * offset];
+}
+
+KB_API void* kb_segmented_array_back(kb_segmented_array* array) {
+  KB_ASSERT_NOT_NULL(array);
+
+  return kb_segmented_array_at(array, array->pos > 0 ? array->pos - 1 : 0);
+}
+
+KB_API void* kb_segmented_array_push_back(kb_segmented_array* array, const void* data) {
+  KB_ASSERT_NOT_NULL(array);
+
+  kb_segmented_array_reserve(array, array->pos + 1);
+
+  void* dst = kb_segmented_array_at(array, array->pos);
+  if (data) {
+    kb_memcpy(dst, data, array->elem_size);
+  }
+  array->pos++;
+
+  return dst;
+}
+
+KB_API void kb_segmented_array_pop_back(kb_segmented_array* array) {
+  KB_ASSERT_NOT_NULL(array);
+  KB_ASSERT(array->pos > 0, "Can't pop from empty array");
+
+  array->pos--;
+}
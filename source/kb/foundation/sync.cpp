@@ -0,0 +1,331 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+#include <kb/foundation/sync.h>
+
+#include <sched.h>
+#include <limits.h>
+
+#if KB_PLATFORM_LINUX
+  #include <linux/futex.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+#else
+  #include <pthread.h>
+#endif
+
+#define KB_SYNC_SPIN_COUNT        128
+
+#define KB_LOCK_UNLOCKED          0
+#define KB_LOCK_LOCKED            1
+#define KB_LOCK_CONTENDED         2
+
+#define KB_RWLOCK_READER_MASK     0x3FFFFFFFu
+#define KB_RWLOCK_WRITER          0x40000000u
+#define KB_RWLOCK_WAITERS         0x80000000u
+
+#define KB_EVENT_SIGNALED         1u
+#define KB_EVENT_WAITERS          2u
+
+//#####################################################################################################################
+// Futex
+//#####################################################################################################################
+
+#if KB_PLATFORM_LINUX
+
+KB_API void kb_futex_wait(kb_atomic_u32* addr, uint32_t expected) {
+  syscall(SYS_futex, &addr->value, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+KB_API void kb_futex_wake(kb_atomic_u32* addr, uint32_t count) {
+  syscall(SYS_futex, &addr->value, FUTEX_WAKE_PRIVATE, count > INT_MAX ? INT_MAX : (int) count, NULL, NULL, 0);
+}
+
+#else
+
+// Shared fallback, every wake is a broadcast and waiters recheck their word
+KB_INTERNAL pthread_mutex_t futex_fallback_mutex  = PTHREAD_MUTEX_INITIALIZER;
+KB_INTERNAL pthread_cond_t  futex_fallback_cond   = PTHREAD_COND_INITIALIZER;
+
+KB_API void kb_futex_wait(kb_atomic_u32* addr, uint32_t expected) {
+  pthread_mutex_lock(&futex_fallback_mutex);
+  if (kb_atomic_load_u32(addr) == expected) {
+    pthread_cond_wait(&futex_fallback_cond, &futex_fallback_mutex);
+  }
+  pthread_mutex_unlock(&futex_fallback_mutex);
+}
+
+KB_API void kb_futex_wake(kb_atomic_u32* addr, uint32_t count) {
+  pthread_mutex_lock(&futex_fallback_mutex);
+  pthread_cond_broadcast(&futex_fallback_cond);
+  pthread_mutex_unlock(&futex_fallback_mutex);
+}
+
+#endif
+
+KB_API void kb_futex_wake_all(kb_atomic_u32* addr) {
+  kb_futex_wake(addr, UINT32_MAX);
+}
+
+//#####################################################################################################################
+// Spinlock
+//#####################################################################################################################
+
+KB_API void kb_spinlock_init(kb_spinlock* lock) {
+  KB_ASSERT_NOT_NULL(lock);
+
+  kb_atomic_store_u32(&lock->state, 0);
+}
+
+KB_API bool kb_spinlock_try_lock(kb_spinlock* lock) {
+  return kb_atomic_load_relaxed_u32(&lock->state) == 0 && kb_atomic_exchange_u32(&lock->state, 1) == 0;
+}
+
+KB_API void kb_spinlock_lock(kb_spinlock* lock) {
+  KB_ASSERT_NOT_NULL(lock);
+
+  uint32_t spin = 0;
+
+  while (!kb_spinlock_try_lock(lock)) {
+    // Holder may be descheduled, stop burning its time slice
+    if (++spin < KB_SYNC_SPIN_COUNT) kb_cpu_relax();
+    else sched_yield();
+  }
+}
+
+KB_API void kb_spinlock_unlock(kb_spinlock* lock) {
+  KB_ASSERT_NOT_NULL(lock);
+
+  kb_atomic_store_release_u32(&lock->state, 0);
+}
+
+//#####################################################################################################################
+// Lock
+//#####################################################################################################################
+
+KB_API void kb_lock_init(kb_lock* lock) {
+  KB_ASSERT_NOT_NULL(lock);
+
+  kb_atomic_store_u32(&lock->state, KB_LOCK_UNLOCKED);
+}
+
+KB_API bool kb_lock_try_lock(kb_lock* lock) {
+  uint32_t expected = KB_LOCK_UNLOCKED;
+  return kb_atomic_cas_u32(&lock->state, &expected, KB_LOCK_LOCKED);
+}
+
+KB_API void kb_lock_lock(kb_lock* lock) {
+  KB_ASSERT_NOT_NULL(lock);
+
+  if (kb_lock_try_lock(lock)) return;
+
+  for (uint32_t spin = 0; spin < KB_SYNC_SPIN_COUNT; ++spin) {
+    kb_cpu_relax();
+    if (kb_atomic_load_relaxed_u32(&lock->state) == KB_LOCK_UNLOCKED && kb_lock_try_lock(lock)) return;
+  }
+
+  // Mark contended so the holder knows to wake someone on unlock
+  while (kb_atomic_exchange_u32(&lock->state, KB_LOCK_CONTENDED) != KB_LOCK_UNLOCKED) {
+    kb_futex_wait(&lock->state, KB_LOCK_CONTENDED);
+  }
+}
+
+KB_API void kb_lock_unlock(kb_lock* lock) {
+  KB_ASSERT_NOT_NULL(lock);
+
+  if (kb_atomic_exchange_u32(&lock->state, KB_LOCK_UNLOCKED) == KB_LOCK_CONTENDED) {
+    kb_futex_wake(&lock->state, 1);
+  }
+}
+
+//#####################################################################################################################
+// Counting semaphore
+//#####################################################################################################################
+
+KB_API void kb_counting_semaphore_init(kb_counting_semaphore* sem, uint32_t count) {
+  KB_ASSERT_NOT_NULL(sem);
+
+  kb_atomic_store_u32(&sem->count, count);
+  kb_atomic_store_u32(&sem->waiters, 0);
+}
+
+KB_API bool kb_counting_semaphore_try_wait(kb_counting_semaphore* sem) {
+  uint32_t count = kb_atomic_load_u32(&sem->count);
+
+  while (count > 0) {
+    if (kb_atomic_cas_u32(&sem->count, &count, count - 1)) return true;
+  }
+
+  return false;
+}
+
+KB_API void kb_counting_semaphore_wait(kb_counting_semaphore* sem) {
+  KB_ASSERT_NOT_NULL(sem);
+
+  for (uint32_t spin = 0; spin < KB_SYNC_SPIN_COUNT; ++spin) {
+    if (kb_counting_semaphore_try_wait(sem)) return;
+    kb_cpu_relax();
+  }
+
+  // Registering before the final check pairs with post reading waiters
+  // after raising the count
+  kb_atomic_fetch_add_u32(&sem->waiters, 1);
+
+  while (!kb_counting_semaphore_try_wait(sem)) {
+    kb_futex_wait(&sem->count, 0);
+  }
+
+  kb_atomic_fetch_sub_u32(&sem->waiters, 1);
+}
+
+KB_API void kb_counting_semaphore_post(kb_counting_semaphore* sem, uint32_t count) {
+  KB_ASSERT_NOT_NULL(sem);
+
+  if (count == 0) return;
+
+  kb_atomic_fetch_add_u32(&sem->count, count);
+
+  if (kb_atomic_load_u32(&sem->waiters) > 0) {
+    kb_futex_wake(&sem->count, count);
+  }
+}
+
+//#####################################################################################################################
+// Reader-writer lock
+//#####################################################################################################################
+
+// Sets the waiters bit and sleeps until the state changes. Returns false if
+// the state moved before we got to sleep.
+KB_INTERNAL bool rwlock_sleep(kb_rwlock* lock, uint32_t state) {
+  if (!(state & KB_RWLOCK_WAITERS)) {
+    if (!kb_atomic_cas_u32(&lock->state, &state, state | KB_RWLOCK_WAITERS)) return false;
+    state |= KB_RWLOCK_WAITERS;
+  }
+
+  kb_futex_wait(&lock->state, state);
+  return true;
+}
+
+KB_INTERNAL void rwlock_wake(kb_rwlock* lock) {
+  // Sleepers set the bit again if they have to go back to sleep
+  kb_atomic_fetch_and_u32(&lock->state, ~KB_RWLOCK_WAITERS);
+  kb_futex_wake_all(&lock->state);
+}
+
+KB_API void kb_rwlock_init(kb_rwlock* lock) {
+  KB_ASSERT_NOT_NULL(lock);
+
+  kb_atomic_store_u32(&lock->state, 0);
+  kb_atomic_store_u32(&lock->writers_waiting, 0);
+}
+
+KB_API void kb_rwlock_read_lock(kb_rwlock* lock) {
+  KB_ASSERT_NOT_NULL(lock);
+
+  uint32_t spin = 0;
+
+  while (true) {
+    uint32_t state = kb_atomic_load_u32(&lock->state);
+
+    if (!(state & KB_RWLOCK_WRITER) && kb_atomic_load_u32(&lock->writers_waiting) == 0) {
+      KB_ASSERT((state & KB_RWLOCK_READER_MASK) != KB_RWLOCK_READER_MASK, "Too many readers");
+      if (kb_atomic_cas_u32(&lock->state, &state, state + 1)) return;
+      continue;
+    }
+
+    if (spin++ < KB_SYNC_SPIN_COUNT) {
+      kb_cpu_relax();
+      continue;
+    }
+
+    rwlock_sleep(lock, state);
+  }
+}
+
+KB_API void kb_rwlock_read_unlock(kb_rwlock* lock) {
+  KB_ASSERT_NOT_NULL(lock);
+
+  const uint32_t state = kb_atomic_fetch_sub_u32(&lock->state, 1) - 1;
+
+  if ((state & KB_RWLOCK_READER_MASK) == 0 && (state & KB_RWLOCK_WAITERS)) {
+    rwlock_wake(lock);
+  }
+}
+
+KB_API void kb_rwlock_write_lock(kb_rwlock* lock) {
+  KB_ASSERT_NOT_NULL(lock);
+
+  kb_atomic_fetch_add_u32(&lock->writers_waiting, 1);
+
+  uint32_t spin = 0;
+
+  while (true) {
+    uint32_t state = kb_atomic_load_u32(&lock->state);
+
+    if ((state & ~KB_RWLOCK_WAITERS) == 0) {
+      if (kb_atomic_cas_u32(&lock->state, &state, state | KB_RWLOCK_WRITER)) break;
+      continue;
+    }
+
+    if (spin++ < KB_SYNC_SPIN_COUNT) {
+      kb_cpu_relax();
+      continue;
+    }
+
+    rwlock_sleep(lock, state);
+  }
+
+  kb_atomic_fetch_sub_u32(&lock->writers_waiting, 1);
+}
+
+KB_API void kb_rwlock_write_unlock(kb_rwlock* lock) {
+  KB_ASSERT_NOT_NULL(lock);
+
+  const uint32_t state = kb_atomic_fetch_and_u32(&lock->state, ~KB_RWLOCK_WRITER);
+
+  if (state & KB_RWLOCK_WAITERS) {
+    rwlock_wake(lock);
+  }
+}
+
+//#####################################################################################################################
+// Event
+//#####################################################################################################################
+
+KB_API void kb_event_init(kb_event* event) {
+  KB_ASSERT_NOT_NULL(event);
+
+  kb_atomic_store_u32(&event->state, 0);
+}
+
+KB_API void kb_event_signal(kb_event* event) {
+  KB_ASSERT_NOT_NULL(event);
+
+  if (kb_atomic_exchange_u32(&event->state, KB_EVENT_SIGNALED) & KB_EVENT_WAITERS) {
+    kb_futex_wake_all(&event->state);
+  }
+}
+
+KB_API bool kb_event_is_signaled(kb_event* event) {
+  KB_ASSERT_NOT_NULL(event);
+
+  return (kb_atomic_load_acquire_u32(&event->state) & KB_EVENT_SIGNALED) != 0;
+}
+
+KB_API void kb_event_wait(kb_event* event) {
+  KB_ASSERT_NOT_NULL(event);
+
+  uint32_t state = kb_atomic_load_u32(&event->state);
+
+  while (!(state & KB_EVENT_SIGNALED)) {
+    if (!(state & KB_EVENT_WAITERS) && !kb_atomic_cas_u32(&event->state, &state, state | KB_EVENT_WAITERS)) {
+      continue;
+    }
+
+    kb_futex_wait(&event->state, state | KB_EVENT_WAITERS);
+    state = kb_atomic_load_u32(&event->state);
+  }
+}
@@ -8,15 +8,52 @@
 
 #include <kb/foundation/alloc.h>
 #include <kb/foundation/crt.h>
+#include <kb/foundation/metrics.h>
+#include <kb/foundation/profile.h>
+#include <kb/foundation/sync.h>
+#include <kb/foundation/time.h>
+
+#include <atomic>
+#include <new>
 
 #include <pthread.h>
-#include <signal.h>
+#include <sched.h>
 #include <unistd.h>
 
-const static double KILL_TIMEOUT = 1.0;
+#if KB_PLATFORM_LINUX
+  #include <ucontext.h>
+  #define KB_FIBERS_SUPPORTED 1
+#else
+  #define KB_FIBERS_SUPPORTED 0
+#endif
+
+#define KB_JOB_DEQUE_SIZE     4096
+#define KB_JOB_SPIN_COUNT     64
+#define KB_CACHE_LINE_SIZE    64
+#define KB_JOB_BLOCK_SIZE     256
+#define KB_JOB_CACHE_SIZE     256
+#define KB_FIBER_STACK_SIZE   (64 * 1024)
+
+#define KB_LOCK_PROFILE_MAX_NAMES 128
+
+// Shared by every lock created with the same name, so entries outlive the
+// locks and are updated with atomics. Times are in kb_time_get_fast ticks.
+typedef struct kb_lock_profile {
+  const char*       name;
+  kb_atomic_u64     acquisitions;
+  kb_atomic_u64     contended;
+  kb_atomic_u64     wait_total;
+  kb_atomic_u64     wait_max;
+  kb_atomic_u64     hold_total;
+  kb_atomic_u64     hold_max;
+} kb_lock_profile;
 
 typedef struct kb_mutex {
-  pthread_mutex_t id;
+  pthread_mutex_t   id;
+#if KB_CONFIG_LOCK_PROFILE
+  kb_lock_profile*  profile;
+  uint64_t          locked_at;
+#endif
 } kb_mutex;
 
 typedef struct kb_semaphore {
@@ -25,61 +62,941 @@ typedef struct kb_semaphore {
   bool              value;
 } kb_semaphore;
 
+typedef struct kb_fiber kb_fiber;
+
 typedef struct kb_job {
-  kb_job*           prev;
+  kb_job*           next;
   kb_job_func       func;
   void*             userdata;
+  kb_job_counter*   counter;
+  kb_thread_pool*   pool;
+  kb_fiber*         fiber;      // Set once a fiber job has started
+  kb_job_priority   priority;
+  bool              on_fiber;
 } kb_job;
 
-typedef struct kb_thread {
-  pthread_t         impl;
-  void*             userdata;
-} kb_thread;
+#if KB_FIBERS_SUPPORTED
+
+typedef struct kb_fiber {
+  kb_fiber*         next;       // Free list
+  kb_fiber*         all_next;   // Every fiber owned by the pool
+  ucontext_t        context;
+  ucontext_t*       caller;     // Worker context that resumed this fiber last
+  kb_job*           job;
+  kb_job_counter*   wait_counter;
+  void*             stack;
+  bool              finished;
+} kb_fiber;
+
+#endif
+
+// Job descriptors are carved from blocks owned by the pool and recycled,
+// blocks are only released with the pool
+typedef struct kb_job_block {
+  kb_job_block*     next;
+  kb_job            jobs[KB_JOB_BLOCK_SIZE];
+} kb_job_block;
+
+typedef struct kb_job_cache {
+  kb_job*           free;
+  uint32_t          count;
+} kb_job_cache;
+
+typedef struct kb_thread {
+  pthread_t         impl;
+  kb_thread_func    func;
+  void*             userdata;
+} kb_thread;
+
+// Chase-Lev work-stealing deque. Owner pushes and pops at the bottom, any
+// other thread steals from the top.
+typedef struct kb_job_deque {
+  std::atomic<int64_t>  top;
+  char                  pad0[KB_CACHE_LINE_SIZE - sizeof(std::atomic<int64_t>)];
+  std::atomic<int64_t>  bottom;
+  char                  pad1[KB_CACHE_LINE_SIZE - sizeof(std::atomic<int64_t>)];
+  std::atomic<kb_job*>  buffer[KB_JOB_DEQUE_SIZE];
+} kb_job_deque;
+
+typedef struct kb_pool_worker {
+  kb_job_deque      deques[KB_JOB_PRIORITY_COUNT];
+  kb_job_cache      cache;
+  kb_thread_pool*   pool;
+  kb_thread*        thread;
+  uint32_t          index;
+  uint32_t          thread_index;
+  uint32_t          rng;
+} kb_pool_worker;
+
+// Jobs submitted from threads outside the pool
+typedef struct kb_job_inject_queue {
+  kb_mutex*             mutex;
+  kb_job*               front;
+  kb_job*               rear;
+  std::atomic<uint32_t> count;
+} kb_job_inject_queue;
+
+typedef struct kb_thread_pool {
+  kb_pool_worker*       workers;
+  int                   num_threads;
+  kb_job_inject_queue   inject[KB_JOB_PRIORITY_COUNT];
+  kb_mutex*             job_mutex;
+  kb_job*               job_free;
+  kb_job_block*         job_blocks;
+  std::atomic<uint32_t> pending;      // Queued, not yet taken
+  std::atomic<uint32_t> lane_pending[KB_JOB_PRIORITY_COUNT];
+  std::atomic<uint32_t> outstanding;  // Queued or running
+  std::atomic<uint32_t> background;   // Workers running low priority jobs
+  uint32_t              background_limit;
+  std::atomic<uint32_t> wake_epoch;
+  std::atomic<uint32_t> sleepers;
+  std::atomic<bool>     paused;
+  std::atomic<bool>     alive;
+  kb_lock               fiber_lock;
+  kb_fiber*             fiber_free;
+  kb_fiber*             fiber_all;
+  uint32_t              fiber_count;
+} kb_thread_pool;
+
+// Lanes in the order they are served
+KB_INTERNAL const kb_job_priority lane_order[KB_JOB_PRIORITY_COUNT] = {
+  KB_JOB_PRIORITY_HIGH, KB_JOB_PRIORITY_NORMAL, KB_JOB_PRIORITY_LOW
+};
+
+// Marks a counter whose continuations have already been submitted
+#define KB_JOB_CONTINUATIONS_CLOSED ((kb_job*) 1)
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(kb_atomic_u32), "Pool counters are shared with the futex API");
+
+KB_INTERNAL thread_local kb_pool_worker* current_worker    = NULL;
+KB_INTERNAL thread_local uint32_t        current_job_depth = 0;
+KB_INTERNAL thread_local kb_job_priority current_job_priority = KB_JOB_PRIORITY_NORMAL;
+KB_INTERNAL thread_local kb_fiber*       current_fiber     = NULL;
+KB_INTERNAL thread_local uint32_t        current_thread_index = UINT32_MAX;
+
+static_assert(KB_MAX_THREADS <= 64, "Thread indices are tracked in a 64 bit mask");
+
+KB_INTERNAL std::atomic<uint64_t>  thread_index_mask  { 0 };
+KB_INTERNAL std::atomic<uint32_t>  thread_index_count { 0 };
+KB_INTERNAL std::atomic<uint32_t>  tls_slot_mask      { 0 };
+KB_INTERNAL void*                  tls_values[KB_MAX_THREADS][KB_MAX_TLS_SLOTS];
+
+//#####################################################################################################################
+// Futex
+//#####################################################################################################################
+
+KB_INTERNAL void futex_wait(std::atomic<uint32_t>* addr, uint32_t expected) {
+  kb_futex_wait((kb_atomic_u32*) addr, expected);
+}
+
+KB_INTERNAL void futex_wake(std::atomic<uint32_t>* addr, int count) {
+  kb_futex_wake((kb_atomic_u32*) addr, (uint32_t) count);
+}
+
+//#####################################################################################################################
+// Job deque
+//#####################################################################################################################
+
+KB_INTERNAL void deque_init(kb_job_deque* deque) {
+  deque->top.store(0, std::memory_order_relaxed);
+  deque->bottom.store(0, std::memory_order_relaxed);
+}
+
+KB_INTERNAL bool deque_push(kb_job_deque* deque, kb_job* job) {
+  const int64_t b = deque->bottom.load(std::memory_order_relaxed);
+  const int64_t t = deque->top.load(std::memory_order_acquire);
+
+  if (b - t >= KB_JOB_DEQUE_SIZE) return false;
+
+  deque->buffer[b & (KB_JOB_DEQUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+  deque->bottom.store(b + 1, std::memory_order_release);
+
+  return true;
+}
+
+KB_INTERNAL kb_job* deque_pop(kb_job_deque* deque) {
+  const int64_t b = deque->bottom.load(std::memory_order_relaxed) - 1;
+  deque->bottom.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t t = deque->top.load(std::memory_order_relaxed);
+
+  if (t > b) {
+    deque->bottom.store(b + 1, std::memory_order_relaxed);
+    return NULL;
+  }
+
+  kb_job* job = deque->buffer[b & (KB_JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+
+  if (t == b) {
+    // Last job, race against thieves
+    if (!deque->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      job = NULL;
+    }
+    deque->bottom.store(b + 1, std::memory_order_relaxed);
+  }
+
+  return job;
+}
+
+KB_INTERNAL kb_job* deque_steal(kb_job_deque* deque) {
+  int64_t t = deque->top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  const int64_t b = deque->bottom.load(std::memory_order_acquire);
+
+  if (t >= b) return NULL;
+
+  kb_job* job = deque->buffer[t & (KB_JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+
+  if (!deque->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+    return NULL;
+  }
+
+  return job;
+}
+
+//#####################################################################################################################
+// Scheduler
+//#####################################################################################################################
+
+KB_INTERNAL void inject_push_chain(kb_job_inject_queue* queue, kb_job* first, kb_job* last, uint32_t count) {
+  last->next = NULL;
+
+  kb_mutex_lock(queue->mutex);
+
+  if (queue->rear) {
+    queue->rear->next = first;
+  } else {
+    queue->front = first;
+  }
+  queue->rear = last;
+  queue->count.fetch_add(count, std::memory_order_release);
+
+  kb_mutex_unlock(queue->mutex);
+}
+
+KB_INTERNAL void inject_push(kb_job_inject_queue* queue, kb_job* job) {
+  inject_push_chain(queue, job, job, 1);
+}
+
+KB_INTERNAL kb_job* inject_pop(kb_job_inject_queue* queue) {
+  if (queue->count.load(std::memory_order_acquire) == 0) return NULL;
+
+  kb_mutex_lock(queue->mutex);
+
+  kb_job* job = queue->front;
+  if (job) {
+    queue->front = job->next;
+    if (queue->front == NULL) queue->rear = NULL;
+    queue->count.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  kb_mutex_unlock(queue->mutex);
+
+  return job;
+}
+
+KB_INTERNAL uint32_t worker_rand(kb_pool_worker* worker) {
+  uint32_t x = worker->rng;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  worker->rng = x;
+  return x;
+}
+
+KB_INTERNAL void pool_wake(kb_thread_pool* pool, int count) {
+  if (pool->sleepers.load(std::memory_order_seq_cst) == 0) return;
+
+  pool->wake_epoch.fetch_add(1, std::memory_order_seq_cst);
+  futex_wake(&pool->wake_epoch, count);
+}
+
+KB_INTERNAL kb_pool_worker* pool_self(kb_thread_pool* pool) {
+  return current_worker && current_worker->pool == pool ? current_worker : NULL;
+}
+
+// Queues a job that already counts as outstanding, like a resumed fiber
+KB_INTERNAL void pool_enqueue(kb_thread_pool* pool, kb_job* job) {
+  const kb_job_priority lane = job->priority;
+
+  pool->lane_pending[lane].fetch_add(1, std::memory_order_relaxed);
+  pool->pending.fetch_add(1, std::memory_order_seq_cst);
+
+  kb_pool_worker* worker = pool_self(pool);
+
+  // Workers push to their own deque, everyone else goes through the inject queue
+  if (!worker || !deque_push(&worker->deques[lane], job)) {
+    inject_push(&pool->inject[lane], job);
+  }
+
+  pool_wake(pool, 1);
+}
+
+KB_INTERNAL void pool_submit(kb_thread_pool* pool, kb_job* job) {
+  pool->outstanding.fetch_add(1, std::memory_order_relaxed);
+  pool_enqueue(pool, job);
+}
+
+// Continuations are either new jobs or suspended fibers
+KB_INTERNAL void pool_schedule(kb_thread_pool* pool, kb_job* job) {
+  if (job->fiber) {
+    pool_enqueue(pool, job);
+  } else {
+    pool_submit(pool, job);
+  }
+}
+
+// Submits a chain of jobs linked through next with one inject lock and one
+// wake that rouses at most as many workers as there are jobs
+// Chain may mix priorities
+KB_INTERNAL void pool_submit_chain(kb_thread_pool* pool, kb_job* first, uint32_t count) {
+  uint32_t lane_count[KB_JOB_PRIORITY_COUNT] = {};
+
+  for (kb_job* job = first; job; job = job->next) {
+    lane_count[job->priority]++;
+  }
+
+  pool->outstanding.fetch_add(count, std::memory_order_relaxed);
+
+  for (uint32_t lane = 0; lane < KB_JOB_PRIORITY_COUNT; ++lane) {
+    if (lane_count[lane]) pool->lane_pending[lane].fetch_add(lane_count[lane], std::memory_order_relaxed);
+  }
+
+  pool->pending.fetch_add(count, std::memory_order_seq_cst);
+
+  kb_pool_worker* worker = pool_self(pool);
+
+  // Leftovers are split per lane and pushed to the inject queues in one go each
+  kb_job* front [KB_JOB_PRIORITY_COUNT] = {};
+  kb_job* rear  [KB_JOB_PRIORITY_COUNT] = {};
+
+  while (first) {
+    // A pushed job may be stolen and recycled right away
+    kb_job*               next = first->next;
+    const kb_job_priority lane = first->priority;
+
+    if (!worker || !deque_push(&worker->deques[lane], first)) {
+      first->next = NULL;
+      if (rear[lane]) rear[lane]->next = first;
+      else front[lane] = first;
+      rear[lane] = first;
+    } else {
+      lane_count[lane]--;
+    }
+
+    first = next;
+  }
+
+  for (uint32_t lane = 0; lane < KB_JOB_PRIORITY_COUNT; ++lane) {
+    if (front[lane]) inject_push_chain(&pool->inject[lane], front[lane], rear[lane], lane_count[lane]);
+  }
+
+  pool_wake(pool, count < (uint32_t) pool->num_threads ? (int) count : pool->num_threads);
+}
+
+KB_INTERNAL kb_job* pool_find_lane_job(kb_thread_pool* pool, kb_pool_worker* self, kb_job_priority lane) {
+  if (pool->lane_pending[lane].load(std::memory_order_relaxed) == 0) return NULL;
+
+  kb_job* job = NULL;
+
+  if (self) {
+    job = deque_pop(&self->deques[lane]);
+    if (job) return job;
+  }
+
+  job = inject_pop(&pool->inject[lane]);
+  if (job) return job;
+
+  const uint32_t count = (uint32_t) pool->num_threads;
+  const uint32_t start = self ? worker_rand(self) : 0;
+
+  for (uint32_t i = 0; i < count; ++i) {
+    kb_pool_worker* victim = &pool->workers[(start + i) % count];
+    if (victim == self) continue;
+
+    job = deque_steal(&victim->deques[lane]);
+    if (job) return job;
+  }
+
+  return NULL;
+}
+
+KB_INTERNAL kb_job* pool_find_job(kb_thread_pool* pool, kb_pool_worker* self, bool background) {
+  if (pool->pending.load(std::memory_order_relaxed) == 0) return NULL;
+
+  for (uint32_t i = 0; i < KB_JOB_PRIORITY_COUNT; ++i) {
+    if (lane_order[i] == KB_JOB_PRIORITY_LOW && !background) break;
+
+    kb_job* job = pool_find_lane_job(pool, self, lane_order[i]);
+    if (job) return job;
+  }
+
+  return NULL;
+}
+
+KB_INTERNAL bool pool_has_work(kb_thread_pool* pool, bool background) {
+  if (pool->pending.load(std::memory_order_seq_cst) == 0) return false;
+  if (background) return true;
+
+  return pool->lane_pending[KB_JOB_PRIORITY_HIGH].load(std::memory_order_seq_cst) != 0
+      || pool->lane_pending[KB_JOB_PRIORITY_NORMAL].load(std::memory_order_seq_cst) != 0;
+}
+
+// Waiters leave background jobs to the workers unless there are none, or the
+// waiter is itself a background job waiting on its children
+KB_INTERNAL bool waiter_takes_background(kb_thread_pool* pool) {
+  return pool->num_threads == 0 || (current_job_depth > 0 && current_job_priority == KB_JOB_PRIORITY_LOW);
+}
+
+KB_INTERNAL bool worker_takes_background(kb_thread_pool* pool) {
+  return pool->background.load(std::memory_order_seq_cst) < pool->background_limit;
+}
+
+KB_INTERNAL kb_job* worker_find_job(kb_thread_pool* pool, kb_pool_worker* self, bool* background) {
+  *background = false;
+
+  kb_job* job = pool_find_job(pool, self, false);
+  if (job) return job;
+
+  if (pool->lane_pending[KB_JOB_PRIORITY_LOW].load(std::memory_order_relaxed) == 0) return NULL;
+
+  // Reserve a background slot before taking the job
+  if (pool->background.fetch_add(1, std::memory_order_seq_cst) >= pool->background_limit) {
+    pool->background.fetch_sub(1, std::memory_order_seq_cst);
+    return NULL;
+  }
+
+  job = pool_find_lane_job(pool, self, KB_JOB_PRIORITY_LOW);
+
+  if (job) {
+    *background = true;
+  } else {
+    pool->background.fetch_sub(1, std::memory_order_seq_cst);
+  }
+
+  return job;
+}
+
+KB_INTERNAL void pool_wake_all(kb_thread_pool* pool) {
+  if (pool->sleepers.load(std::memory_order_seq_cst) == 0) return;
+
+  pool->wake_epoch.fetch_add(1, std::memory_order_seq_cst);
+  futex_wake(&pool->wake_epoch, INT32_MAX);
+}
+
+//#####################################################################################################################
+// Job descriptors
+//#####################################################################################################################
+
+// Expects job_mutex to be held
+KB_INTERNAL bool job_grow_locked(kb_thread_pool* pool) {
+  kb_job_block* block = (kb_job_block*) KB_DEFAULT_ALLOC(sizeof(kb_job_block));
+  if (block == NULL) return false;
+
+  block->next       = pool->job_blocks;
+  pool->job_blocks  = block;
+
+  for (uint32_t i = 0; i < KB_JOB_BLOCK_SIZE; ++i) {
+    block->jobs[i].next = i + 1 < KB_JOB_BLOCK_SIZE ? &block->jobs[i + 1] : pool->job_free;
+  }
+
+  pool->job_free = &block->jobs[0];
+  return true;
+}
+
+// Expects job_mutex to be held
+KB_INTERNAL kb_job* job_take_locked(kb_thread_pool* pool) {
+  if (pool->job_free == NULL && !job_grow_locked(pool)) return NULL;
+
+  kb_job* job     = pool->job_free;
+  pool->job_free  = job->next;
+
+  return job;
+}
+
+KB_INTERNAL kb_job* job_alloc(kb_thread_pool* pool) {
+  kb_pool_worker* self = pool_self(pool);
+
+  if (self == NULL) {
+    kb_mutex_lock(pool->job_mutex);
+    kb_job* job = job_take_locked(pool);
+    kb_mutex_unlock(pool->job_mutex);
+
+    return job;
+  }
+
+  kb_job_cache* cache = &self->cache;
+
+  // Refill half the worker cache at once
+  if (cache->free == NULL) {
+    kb_mutex_lock(pool->job_mutex);
+
+    for (uint32_t i = 0; i < KB_JOB_CACHE_SIZE / 2; ++i) {
+      kb_job* job = job_take_locked(pool);
+      if (job == NULL) break;
+
+      job->next   = cache->free;
+      cache->free = job;
+      cache->count++;
+    }
+
+    kb_mutex_unlock(pool->job_mutex);
+
+    if (cache->free == NULL) return NULL;
+  }
+
+  kb_job* job = cache->free;
+  cache->free = job->next;
+  cache->count--;
+
+  return job;
+}
+
+KB_INTERNAL void job_release(kb_thread_pool* pool, kb_job* job) {
+  kb_pool_worker* self = pool_self(pool);
+
+  if (self == NULL) {
+    kb_mutex_lock(pool->job_mutex);
+    job->next       = pool->job_free;
+    pool->job_free  = job;
+    kb_mutex_unlock(pool->job_mutex);
+
+    return;
+  }
+
+  kb_job_cache* cache = &self->cache;
+
+  job->next   = cache->free;
+  cache->free = job;
+  cache->count++;
+
+  // Workers mostly free jobs someone else allocated, hand the surplus back
+  if (cache->count > KB_JOB_CACHE_SIZE) {
+    kb_mutex_lock(pool->job_mutex);
+
+    while (cache->count > KB_JOB_CACHE_SIZE / 2) {
+      kb_job* surplus = cache->free;
+      cache->free     = surplus->next;
+      cache->count--;
+
+      surplus->next   = pool->job_free;
+      pool->job_free  = surplus;
+    }
+
+    kb_mutex_unlock(pool->job_mutex);
+  }
+}
+
+KB_INTERNAL void job_init(kb_job* job, kb_thread_pool* pool, void* userdata, kb_job_func func, kb_job_priority priority, kb_job_counter* counter) {
+  KB_ASSERT(priority < KB_JOB_PRIORITY_COUNT, "Invalid job priority");
+
+  job->next     = NULL;
+  job->func     = func;
+  job->userdata = userdata;
+  job->counter  = counter;
+  job->pool     = pool;
+  job->fiber    = NULL;
+  job->priority = priority;
+  job->on_fiber = false;
+}
+
+//#####################################################################################################################
+// Job counters
+//#####################################################################################################################
+
+KB_INTERNAL void counter_acquire(kb_job_counter* counter, uint32_t count) {
+  if (kb_atomic_fetch_add_u32(&counter->value, count) == 0) {
+    // First job of a new round reopens the continuation list
+    kb_atomic_store_relaxed_ptr(&counter->continuations, NULL);
+  }
+}
+
+KB_INTERNAL bool counter_done(kb_job_counter* counter) {
+  // Busy is raised before value drops, so a zero value with no busy retirers
+  // means nobody touches the counter anymore
+  return kb_atomic_load_u32(&counter->value) == 0
+      && kb_atomic_load_u32(&counter->busy) == 0;
+}
+
+KB_INTERNAL void counter_release(kb_thread_pool* pool, kb_job_counter* counter) {
+  kb_atomic_fetch_add_u32(&counter->busy, 1);
+
+  bool finished = false;
+
+  if (kb_atomic_fetch_sub_u32(&counter->value, 1) == 1) {
+    kb_job* job = (kb_job*) kb_atomic_exchange_ptr(&counter->continuations, KB_JOB_CONTINUATIONS_CLOSED);
+
+    while (job) {
+      kb_job* next = job->next;
+      pool_schedule(job->pool, job);
+      job = next;
+    }
+
+    finished = true;
+  }
+
+  // Counter may be released by a waiter after this
+  kb_atomic_fetch_sub_u32(&counter->busy, 1);
+
+  // Waiters park with the workers
+  if (finished) pool_wake_all(pool);
+}
+
+// Returns false if the counter is done or finishing, the job has to be
+// scheduled by the caller then
+KB_INTERNAL bool counter_push_continuation(kb_job_counter* counter, kb_job* job) {
+  if (kb_atomic_load_u32(&counter->value) == 0) return false;
+
+  void* head = kb_atomic_load_ptr(&counter->continuations);
+
+  while (head != KB_JOB_CONTINUATIONS_CLOSED) {
+    job->next = (kb_job*) head;
+    if (kb_atomic_cas_ptr(&counter->continuations, &head, job)) return true;
+  }
+
+  job->next = NULL;
+  return false;
+}
+
+//#####################################################################################################################
+// Fibers
+//#####################################################################################################################
+
+#if KB_FIBERS_SUPPORTED
+
+KB_INTERNAL kb_fiber* fiber_create(kb_thread_pool* pool) {
+  kb_fiber* fiber = (kb_fiber*) KB_DEFAULT_ALLOC(sizeof(kb_fiber));
+  kb_memset(fiber, 0, sizeof(kb_fiber));
+
+  fiber->stack = KB_DEFAULT_ALLOC(KB_FIBER_STACK_SIZE);
+
+  // Caller holds fiber_lock
+  fiber->all_next = pool->fiber_all;
+  pool->fiber_all = fiber;
+  pool->fiber_count++;
+
+  return fiber;
+}
+
+KB_INTERNAL kb_fiber* fiber_acquire(kb_thread_pool* pool) {
+  kb_lock_lock(&pool->fiber_lock);
+
+  kb_fiber* fiber = pool->fiber_free;
+
+  if (fiber) {
+    pool->fiber_free = fiber->next;
+  } else {
+    fiber = fiber_create(pool);
+  }
+
+  kb_lock_unlock(&pool->fiber_lock);
+
+  return fiber;
+}
+
+KB_INTERNAL void fiber_release(kb_thread_pool* pool, kb_fiber* fiber) {
+  kb_lock_lock(&pool->fiber_lock);
+
+  fiber->next       = pool->fiber_free;
+  pool->fiber_free  = fiber;
+
+  kb_lock_unlock(&pool->fiber_lock);
+}
+
+KB_INTERNAL void fiber_entry() {
+  // Read before the job can migrate the fiber to another thread
+  kb_fiber* fiber = current_fiber;
+  kb_job*   job   = fiber->job;
+
+  job->func(job->userdata);
+
+  fiber->finished = true;
+  setcontext(fiber->caller);
+}
+
+// Sets up a fiber for the job's first run. Kept out of fiber_run so no local
+// there is assigned across getcontext.
+KB_INTERNAL kb_fiber* fiber_prepare(kb_thread_pool* pool, kb_job* job) {
+  kb_fiber* fiber = fiber_acquire(pool);
+
+  fiber->job          = job;
+  fiber->finished     = false;
+  fiber->wait_counter = NULL;
+
+  getcontext(&fiber->context);
+  fiber->context.uc_stack.ss_sp   = fiber->stack;
+  fiber->context.uc_stack.ss_size = KB_FIBER_STACK_SIZE;
+  fiber->context.uc_link          = NULL;
+  makecontext(&fiber->context, fiber_entry, 0);
+
+  job->fiber = fiber;
+
+  return fiber;
+}
+
+// Runs or resumes a fiber job until it finishes or suspends. Returns true
+// when the job finished.
+KB_INTERNAL bool fiber_run(kb_thread_pool* pool, kb_job* job) {
+  kb_fiber* const fiber = job->fiber != NULL ? job->fiber : fiber_prepare(pool, job);
+
+  ucontext_t caller;
+
+  kb_fiber* outer_fiber = current_fiber;
+
+  fiber->caller = &caller;
+  current_fiber = fiber;
+  swapcontext(&caller, &fiber->context);
+  current_fiber = outer_fiber;
+
+  if (fiber->finished) {
+    job->fiber = NULL;
+    fiber_release(pool, fiber);
+    return true;
+  }
+
+  // Fiber is off its stack now, safe to let another worker resume it
+  kb_job_counter* counter = fiber->wait_counter;
+  fiber->wait_counter = NULL;
+
+  if (!counter_push_continuation(counter, job)) {
+    pool_enqueue(pool, job);
+  }
+
+  return false;
+}
+
+#endif
+
+KB_INTERNAL kb::counter pool_jobs_run("threadpool.jobs_run");
+
+KB_INTERNAL void pool_run_job(kb_thread_pool* pool, kb_job* job) {
+  pool->lane_pending[job->priority].fetch_sub(1, std::memory_order_relaxed);
+  pool->pending.fetch_sub(1, std::memory_order_relaxed);
+
+  const kb_job_priority outer_priority = current_job_priority;
+
+  current_job_priority = job->priority;
+  current_job_depth++;
+
+  bool finished;
+
+  {
+    KB_PROFILE_SCOPE("kb_job");
+
+#if KB_FIBERS_SUPPORTED
+    finished = job->on_fiber ? fiber_run(pool, job) : (job->func(job->userdata), true);
+#else
+    finished = (job->func(job->userdata), true);
+#endif
+  }
+
+  current_job_depth--;
+  current_job_priority = outer_priority;
+
+  // Suspended fibers stay outstanding, the job now belongs to whoever resumes it
+  if (!finished) return;
+
+  pool_jobs_run.add();
+
+  // Continuations are submitted before this job stops counting as outstanding
+  if (job->counter) {
+    counter_release(pool, job->counter);
+  }
+
+  job_release(pool, job);
+
+  if (pool->outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    futex_wake(&pool->outstanding, INT32_MAX);
+  }
+}
+
+KB_INTERNAL void* pool_worker_main(void* userdata) {
+  kb_pool_worker* self = (kb_pool_worker*) userdata;
+  kb_thread_pool* pool = self->pool;
+
+  current_worker        = self;
+  current_thread_index  = self->thread_index;
+
+#if KB_CONFIG_PROFILE
+  char name[32];
+  kb_snprintf(name, sizeof(name), "kb worker %u", self->thread_index);
+  KB_PROFILE_THREAD_NAME(name);
+#endif
+
+  while (pool->alive.load(std::memory_order_acquire)) {
+    kb_job* job         = NULL;
+    bool    background  = false;
+
+    // Spin briefly, then yield so oversubscribed cores still make progress
+    for (uint32_t spin = 0; spin < KB_JOB_SPIN_COUNT && !job; ++spin) {
+      if (pool->paused.load(std::memory_order_relaxed)) break;
+
+      job = worker_find_job(pool, self, &background);
+      if (!job) {
+        if (spin < KB_JOB_SPIN_COUNT / 2) kb_cpu_relax();
+        else sched_yield();
+      }
+    }
+
+    if (job) {
+      pool_run_job(pool, job);
+      if (background) pool->background.fetch_sub(1, std::memory_order_seq_cst);
+      continue;
+    }
+
+    // Park. Registering as a sleeper before the final check pairs with
+    // pool_wake reading sleepers after bumping pending.
+    const uint32_t epoch = pool->wake_epoch.load(std::memory_order_seq_cst);
+    pool->sleepers.fetch_add(1, std::memory_order_seq_cst);
+
+    const bool idle = pool->paused.load(std::memory_order_seq_cst) || !pool_has_work(pool, worker_takes_background(pool));
+
+    if (idle && pool->alive.load(std::memory_order_seq_cst)) {
+      futex_wait(&pool->wake_epoch, epoch);
+    }
+
+    pool->sleepers.fetch_sub(1, std::memory_order_seq_cst);
+  }
+
+  current_thread_index  = UINT32_MAX;
+  current_worker        = NULL;
+
+  return NULL;
+}
+
+// Hands back the thread index func picked up on first use, so short lived
+// threads don't run the pool of indices dry
+KB_INTERNAL void* thread_main(void* param) {
+  kb_thread* thread = (kb_thread*) param;
+
+  void* result = thread->func(thread->userdata);
+  kb_thread_unregister();
+
+  return result;
+}
+
+KB_API kb_thread* kb_thread_create(kb_thread_func func, void* userdata) {
+  kb_thread* thread;
+  thread = (kb_thread*) KB_DEFAULT_ALLOC(sizeof(kb_thread));
+
+  thread->func      = func;
+  thread->userdata  = userdata;
+  pthread_create(&thread->impl, NULL, thread_main, thread);
+  
+  return thread;
+}
+
+KB_API void kb_thread_join(kb_thread* thread) {
+  pthread_join(thread->impl, NULL);
+}
+
+KB_API void kb_thread_destroy(kb_thread* thread) {
+  KB_DEFAULT_FREE(thread);
+}
+
+KB_API bool kb_thread_set_affinity(kb_thread* thread, uint32_t cpu) {
+  KB_ASSERT_NOT_NULL(thread);
+
+#if KB_PLATFORM_LINUX
+  const long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cpu_count <= 0) return false;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu % (uint32_t) cpu_count, &set);
+
+  return pthread_setaffinity_np(thread->impl, sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+KB_INTERNAL uint32_t thread_index_acquire() {
+  uint64_t mask = thread_index_mask.load(std::memory_order_relaxed);
+  uint32_t index;
+
+  do {
+    KB_ASSERT(~mask != 0, "Out of thread indices, raise KB_MAX_THREADS");
+    index = (uint32_t) __builtin_ctzll(~mask);
+  } while (!thread_index_mask.compare_exchange_weak(mask, mask | (1ull << index), std::memory_order_acq_rel));
+
+  uint32_t count = thread_index_count.load(std::memory_order_relaxed);
+  while (count < index + 1 && !thread_index_count.compare_exchange_weak(count, index + 1, std::memory_order_acq_rel)) {}
+
+  return index;
+}
+
+KB_INTERNAL void thread_index_release(uint32_t index) {
+  // Next thread to get this index starts with empty slots
+  kb_memset(tls_values[index], 0, sizeof(tls_values[index]));
+
+  thread_index_mask.fetch_and(~(1ull << index), std::memory_order_acq_rel);
+}
+
+KB_API void kb_thread_register(void) {
+  if (current_thread_index != UINT32_MAX) return;
+
+  current_thread_index = thread_index_acquire();
+}
+
+KB_API void kb_thread_unregister(void) {
+  if (current_thread_index == UINT32_MAX) return;
+
+  thread_index_release(current_thread_index);
+  current_thread_index = UINT32_MAX;
+}
+
+KB_API uint32_t kb_thread_index(void) {
+  if (current_thread_index == UINT32_MAX) {
+    kb_thread_register();
+  }
+
+  return current_thread_index;
+}
+
+KB_API uint32_t kb_thread_count(void) {
+  return thread_index_count.load(std::memory_order_acquire);
+}
+
+KB_API kb_tls_slot kb_tls_alloc(void) {
+  uint32_t mask = tls_slot_mask.load(std::memory_order_relaxed);
+  uint32_t slot;
 
-typedef struct kb_job_queue {
-  kb_mutex*         mutex;
-  kb_job*           front;
-  kb_job*           rear;
-  kb_semaphore*     has_jobs;
-  int               len;
-} kb_job_queue;
+  do {
+    KB_ASSERT(~mask != 0, "Out of TLS slots, raise KB_MAX_TLS_SLOTS");
+    slot = (uint32_t) __builtin_ctz(~mask);
+  } while (!tls_slot_mask.compare_exchange_weak(mask, mask | (1u << slot), std::memory_order_acq_rel));
 
-typedef struct kb_thread_pool {
-  kb_thread**       threads;
-  volatile int      num_threads_alive;
-  volatile int      num_threads_working;
-  kb_mutex*         thread_count_mutex;
-  pthread_cond_t    threads_all_idle;
-  kb_job_queue      jobqueue;
-  bool              value;
-  volatile bool     pool_alive;
-} kb_thread_pool;
+  for (uint32_t i = 0; i < KB_MAX_THREADS; ++i) {
+    tls_values[i][slot] = NULL;
+  }
 
-void*     threadpool_do         (void* data);
-void      thread_sig_handler    (int, siginfo_t*, void*);
+  return slot;
+}
 
-int       jobqueue_init         (kb_job_queue* queue);
-void      jobqueue_clear        (kb_job_queue* queue);
-void      jobqueue_push         (kb_job_queue* queue, kb_job* job);
-kb_job*   jobqueue_pull         (kb_job_queue* queue);
-void      jobqueue_destroy      (kb_job_queue* queue);
+KB_API void kb_tls_free(kb_tls_slot slot) {
+  KB_ASSERT(slot < KB_MAX_TLS_SLOTS, "Invalid TLS slot");
 
-KB_API kb_thread* kb_thread_create(kb_thread_func func, void* userdata) {
-  kb_thread* thread;
-  thread = (kb_thread*) KB_DEFAULT_ALLOC(sizeof(kb_thread));
+  tls_slot_mask.fetch_and(~(1u << slot), std::memory_order_acq_rel);
+}
 
-  thread->userdata = userdata;
-  pthread_create(&thread->impl, NULL, func, thread->userdata);
-  
-  return thread;
+KB_API void kb_tls_set(kb_tls_slot slot, void* value) {
+  KB_ASSERT(slot < KB_MAX_TLS_SLOTS, "Invalid TLS slot");
+
+  tls_values[kb_thread_index()][slot] = value;
 }
 
-KB_API void kb_thread_join(kb_thread* thread) {
-  pthread_join(thread->impl, NULL);
+KB_API void* kb_tls_get(kb_tls_slot slot) {
+  KB_ASSERT(slot < KB_MAX_TLS_SLOTS, "Invalid TLS slot");
+
+  return tls_values[kb_thread_index()][slot];
 }
 
-KB_API void kb_thread_destroy(kb_thread* thread) {
-  KB_DEFAULT_FREE(thread);
+KB_API void* kb_tls_get_thread(kb_tls_slot slot, uint32_t thread_index) {
+  KB_ASSERT(slot < KB_MAX_TLS_SLOTS, "Invalid TLS slot");
+  KB_ASSERT(thread_index < KB_MAX_THREADS, "Invalid thread index");
+
+  return tls_values[thread_index][slot];
 }
 
 kb_thread_pool* kb_threadpool_create(int num_threads) {
@@ -87,191 +1004,569 @@ kb_thread_pool* kb_threadpool_create(int num_threads) {
     num_threads = 0;
   }
   
-  kb_thread_pool* pool;
-  pool = (kb_thread_pool*) KB_DEFAULT_ALLOC(sizeof(kb_thread_pool));
+  kb_thread_pool* pool = new (KB_DEFAULT_ALLOC(sizeof(kb_thread_pool))) kb_thread_pool;
   
-  if (pool == NULL) {
-    return pool;
+  pool->num_threads       = num_threads;
+  pool->job_mutex         = kb_mutex_create_named("threadpool.jobs");
+  pool->job_free          = NULL;
+  pool->job_blocks        = NULL;
+  // A single worker has to take background jobs too, see kb_job_priority
+  pool->background_limit  = num_threads > 1 ? num_threads - 1 : 1;
+  pool->pending.store(0);
+  pool->outstanding.store(0);
+  pool->background.store(0);
+  pool->wake_epoch.store(0);
+  pool->sleepers.store(0);
+  pool->paused.store(false);
+  pool->alive.store(true);
+  pool->fiber_free        = NULL;
+  pool->fiber_all         = NULL;
+  pool->fiber_count       = 0;
+  kb_lock_init(&pool->fiber_lock);
+
+  for (uint32_t lane = 0; lane < KB_JOB_PRIORITY_COUNT; ++lane) {
+    pool->inject[lane].mutex  = kb_mutex_create_named("threadpool.inject");
+    pool->inject[lane].front  = NULL;
+    pool->inject[lane].rear   = NULL;
+    pool->inject[lane].count.store(0);
+    pool->lane_pending[lane].store(0);
   }
-  
-  pool->num_threads_alive    = 0;
-  pool->num_threads_working  = 0;
-  pool->pool_alive           = 1;
 
-  if (jobqueue_init(&pool->jobqueue) == -1){
-    KB_DEFAULT_FREE(pool);
-    return pool;
+  pool->workers = (kb_pool_worker*) KB_DEFAULT_ALLOC(sizeof(kb_pool_worker) * (num_threads > 0 ? num_threads : 1));
+
+  for (int n = 0; n < num_threads; n++) {
+    kb_pool_worker* worker = new (&pool->workers[n]) kb_pool_worker;
+    for (uint32_t lane = 0; lane < KB_JOB_PRIORITY_COUNT; ++lane) {
+      deque_init(&worker->deques[lane]);
+    }
+    worker->cache.free    = NULL;
+    worker->cache.count   = 0;
+    worker->pool          = pool;
+    worker->index         = n;
+    worker->thread_index  = thread_index_acquire();
+    worker->rng           = 0x9E3779B9u * (n + 1);
+  }
+
+  // Worker caches can each strand a block worth of descriptors, reserve those
+  // plus one block in flight so steady state submission stays off the heap
+  for (int n = 0; n <= num_threads; n++) {
+    job_grow_locked(pool);
   }
-  
-  pool->thread_count_mutex = kb_mutex_create();
-  
-  pthread_cond_init(&pool->threads_all_idle, NULL);
 
-  pool->threads     = KB_DEFAULT_ALLOC_TYPE(kb_thread*, num_threads);
-  
   for (int n = 0; n < num_threads; n++) {
-    pool->threads[n] = kb_thread_create(threadpool_do, pool);
+    pool->workers[n].thread = kb_thread_create(pool_worker_main, &pool->workers[n]);
   }
-  
-  // Wait for threads to signal
-  while (pool->num_threads_alive != num_threads) { }
 
   return pool;
 }
- 
+
+// Helps with queued jobs while waiting. Waits on every job in the pool, so it
+// can't be called from inside a job.
 void kb_threadpool_wait(kb_thread_pool* pool) {
-  kb_mutex_lock(pool->thread_count_mutex);
+  KB_ASSERT(current_job_depth == 0, "kb_threadpool_wait called from inside a job");
 
-  while (pool->jobqueue.len || pool->num_threads_working) {
-    pthread_cond_wait(&pool->threads_all_idle, &pool->thread_count_mutex->id);
-  }
+  kb_pool_worker* self = pool_self(pool);
 
-  kb_mutex_unlock(pool->thread_count_mutex);
+  while (true) {
+    const uint32_t outstanding = pool->outstanding.load(std::memory_order_acquire);
+    if (outstanding == 0) break;
+
+    kb_job* job = pool_find_job(pool, self, true);
+    if (job) {
+      pool_run_job(pool, job);
+      continue;
+    }
+
+    futex_wait(&pool->outstanding, outstanding);
+  }
 }
 
+// Workers finish the jobs they are running and stop taking new ones. Threads
+// waiting on the pool still run the jobs they wait for.
 void kb_threadpool_pause(kb_thread_pool* pool) {
-  KB_NOT_IMPLEMENTED("kb_threadpool_pause");
+  KB_ASSERT_NOT_NULL(pool);
+
+  pool->paused.store(true, std::memory_order_seq_cst);
 }
 
 void kb_threadpool_resume(kb_thread_pool* pool) {
-  KB_NOT_IMPLEMENTED("kb_threadpool_resume");
+  KB_ASSERT_NOT_NULL(pool);
+
+  pool->paused.store(false, std::memory_order_seq_cst);
+
+  pool->wake_epoch.fetch_add(1, std::memory_order_seq_cst);
+  futex_wake(&pool->wake_epoch, INT32_MAX);
+}
+
+// Worker n is pinned to cpu first_cpu + n, wrapping around the online cpus
+bool kb_threadpool_set_affinity(kb_thread_pool* pool, uint32_t first_cpu) {
+  KB_ASSERT_NOT_NULL(pool);
+
+  bool pinned = true;
+
+  for (int n = 0; n < pool->num_threads; n++) {
+    pinned &= kb_thread_set_affinity(pool->workers[n].thread, first_cpu + n);
+  }
+
+  return pinned;
 }
 
 int kb_threadpool_queue_length(kb_thread_pool* pool) {
-  kb_mutex_lock(pool->jobqueue.mutex);
-  int len = pool->jobqueue.len;
-  kb_mutex_unlock(pool->jobqueue.mutex);
+  return (int) pool->pending.load(std::memory_order_relaxed);
+}
+
+KB_INTERNAL kb_job* job_create(kb_thread_pool* pool, void* userdata, kb_job_func func, kb_job_priority priority, kb_job_counter* counter) {
+  kb_job* job = job_alloc(pool);
+
+  if (job == NULL){
+    return NULL;
+  }
 
-  return len;
+  job_init(job, pool, userdata, func, priority, counter);
+
+  return job;
 }
 
 int kb_threadpool_add_job(kb_thread_pool* pool, void* userdata, kb_job_func func) {
-  kb_job* job;
+  return kb_threadpool_add_counted_job(pool, userdata, func, NULL);
+}
+
+int kb_threadpool_add_counted_job(kb_thread_pool* pool, void* userdata, kb_job_func func, kb_job_counter* counter) {
+  return kb_threadpool_add_prioritized_job(pool, userdata, func, KB_JOB_PRIORITY_NORMAL, counter);
+}
+
+int kb_threadpool_add_prioritized_job(kb_thread_pool* pool, void* userdata, kb_job_func func, kb_job_priority priority, kb_job_counter* counter) {
+  KB_ASSERT_NOT_NULL(pool);
+  KB_ASSERT_NOT_NULL(func);
 
-  job = (kb_job*) KB_DEFAULT_ALLOC(sizeof(kb_job));
+  kb_job* job = job_create(pool, userdata, func, priority, counter);
 
   if (job == NULL){
     return -1;
   }
 
-  job->func=func;
-  job->userdata = userdata;
+  if (counter) counter_acquire(counter, 1);
+
+  pool_submit(pool, job);
+  return 0;
+}
 
-  jobqueue_push(&pool->jobqueue, job);
+int kb_threadpool_add_jobs(kb_thread_pool* pool, const kb_job_info* jobs, uint32_t count) {
+  return kb_threadpool_add_counted_jobs(pool, jobs, count, NULL);
+}
+
+int kb_threadpool_add_counted_jobs(kb_thread_pool* pool, const kb_job_info* jobs, uint32_t count, kb_job_counter* counter) {
+  KB_ASSERT_NOT_NULL(pool);
+
+  if (count == 0) return 0;
+
+  KB_ASSERT_NOT_NULL(jobs);
+
+  kb_job* first = NULL;
+  kb_job* last  = NULL;
+
+  kb_pool_worker* self = pool_self(pool);
+
+  // Outside the pool the whole batch is taken under one lock
+  if (self == NULL) kb_mutex_lock(pool->job_mutex);
+
+  for (uint32_t i = 0; i < count; ++i) {
+    KB_ASSERT_NOT_NULL(jobs[i].func);
+
+    kb_job* job = self ? job_alloc(pool) : job_take_locked(pool);
+
+    if (job == NULL) {
+      if (self == NULL) kb_mutex_unlock(pool->job_mutex);
+
+      while (first) {
+        kb_job* next = first->next;
+        job_release(pool, first);
+        first = next;
+      }
+
+      return -1;
+    }
+
+    job_init(job, pool, jobs[i].userdata, jobs[i].func, jobs[i].priority, counter);
+
+    if (last) {
+      last->next = job;
+    } else {
+      first = job;
+    }
+    last = job;
+  }
+
+  if (self == NULL) kb_mutex_unlock(pool->job_mutex);
+
+  if (counter) counter_acquire(counter, count);
+
+  pool_submit_chain(pool, first, count);
+
+  return 0;
+}
+
+void kb_job_counter_init(kb_job_counter* counter) {
+  KB_ASSERT_NOT_NULL(counter);
+
+  kb_atomic_store_u32(&counter->value, 0);
+  kb_atomic_store_u32(&counter->busy, 0);
+  kb_atomic_store_ptr(&counter->continuations, NULL);
+}
+
+bool kb_job_counter_done(kb_job_counter* counter) {
+  KB_ASSERT_NOT_NULL(counter);
+
+  return counter_done(counter);
+}
+
+int kb_job_then(kb_thread_pool* pool, kb_job_counter* dependency, void* userdata, kb_job_func func, kb_job_counter* counter) {
+  KB_ASSERT_NOT_NULL(pool);
+  KB_ASSERT_NOT_NULL(dependency);
+  KB_ASSERT_NOT_NULL(func);
+
+  kb_job* job = job_create(pool, userdata, func, KB_JOB_PRIORITY_NORMAL, counter);
+
+  if (job == NULL){
+    return -1;
+  }
+
+  // Continuation counts towards its own counter from the moment it's registered
+  if (counter) counter_acquire(counter, 1);
+
+  // Dependency already finished
+  if (!counter_push_continuation(dependency, job)) {
+    pool_submit(pool, job);
+  }
+
+  return 0;
+}
+
+int kb_threadpool_add_fiber_job(kb_thread_pool* pool, void* userdata, kb_job_func func, kb_job_priority priority, kb_job_counter* counter) {
+  KB_ASSERT_NOT_NULL(pool);
+  KB_ASSERT_NOT_NULL(func);
+
+  kb_job* job = job_create(pool, userdata, func, priority, counter);
+
+  if (job == NULL){
+    return -1;
+  }
+
+  job->on_fiber = KB_FIBERS_SUPPORTED;
+
+  if (counter) counter_acquire(counter, 1);
+
+  pool_submit(pool, job);
   return 0;
 }
 
+// Pre-creates fibers so the first fiber jobs don't allocate stacks
+void kb_threadpool_reserve_fibers(kb_thread_pool* pool, uint32_t count) {
+  KB_ASSERT_NOT_NULL(pool);
+
+#if KB_FIBERS_SUPPORTED
+  kb_lock_lock(&pool->fiber_lock);
+
+  while (pool->fiber_count < count) {
+    kb_fiber* fiber   = fiber_create(pool);
+    fiber->next       = pool->fiber_free;
+    pool->fiber_free  = fiber;
+  }
+
+  kb_lock_unlock(&pool->fiber_lock);
+#endif
+}
+
+// Suspends the current fiber job until the counter is done, the worker moves
+// on to other jobs meanwhile. Outside a fiber this is kb_job_wait.
+void kb_fiber_wait(kb_thread_pool* pool, kb_job_counter* counter) {
+  KB_ASSERT_NOT_NULL(pool);
+  KB_ASSERT_NOT_NULL(counter);
+
+#if KB_FIBERS_SUPPORTED
+  kb_fiber* fiber = current_fiber;
+
+  if (fiber && fiber->job->pool == pool) {
+    // A finishing counter is briefly done but busy, retry until it's released
+    while (!counter_done(counter)) {
+      fiber->wait_counter = counter;
+      swapcontext(&fiber->context, fiber->caller);
+    }
+    return;
+  }
+#endif
+
+  kb_job_wait(pool, counter);
+}
+
+bool kb_fiber_is_current(void) {
+#if KB_FIBERS_SUPPORTED
+  return current_fiber != NULL;
+#else
+  return false;
+#endif
+}
+
+void kb_job_counter_add(kb_job_counter* counter, uint32_t count) {
+  KB_ASSERT_NOT_NULL(counter);
+
+  if (count > 0) counter_acquire(counter, count);
+}
+
+void kb_job_counter_signal(kb_thread_pool* pool, kb_job_counter* counter) {
+  KB_ASSERT_NOT_NULL(pool);
+  KB_ASSERT_NOT_NULL(counter);
+  KB_ASSERT(kb_atomic_load_u32(&counter->value) > 0, "Counter signaled more times than it was added to");
+
+  counter_release(pool, counter);
+}
+
+// Runs other jobs while the counter is pending, parks with the workers when
+// there is nothing to run. Safe to call from inside a job.
+void kb_job_wait(kb_thread_pool* pool, kb_job_counter* counter) {
+  KB_ASSERT_NOT_NULL(pool);
+  KB_ASSERT_NOT_NULL(counter);
+
+  kb_pool_worker* self = pool_self(pool);
+
+  const bool background = waiter_takes_background(pool);
+
+  while (!counter_done(counter)) {
+    kb_job* job = pool_find_job(pool, self, background);
+    if (job) {
+      pool_run_job(pool, job);
+      continue;
+    }
+
+    // Jobs are queued but were taken by someone else between checks
+    if (pool_has_work(pool, background)) {
+      sched_yield();
+      continue;
+    }
+
+    const uint32_t epoch = pool->wake_epoch.load(std::memory_order_seq_cst);
+    pool->sleepers.fetch_add(1, std::memory_order_seq_cst);
+
+    if (!pool_has_work(pool, background) && !counter_done(counter)) {
+      futex_wait(&pool->wake_epoch, epoch);
+    }
+
+    pool->sleepers.fetch_sub(1, std::memory_order_seq_cst);
+  }
+}
+
 void kb_threadpool_destroy(kb_thread_pool* pool) {
   if (pool == NULL) return;
 
-  volatile int thread_count = pool->num_threads_alive;
-
-  pool->pool_alive = 0;
+  pool->alive.store(false, std::memory_order_seq_cst);
+  pool->wake_epoch.fetch_add(1, std::memory_order_seq_cst);
+  futex_wake(&pool->wake_epoch, INT32_MAX);
 
-  time_t start, end;
-  double tpassed = 0.0;
-  time (&start);
+  for (int n = 0; n < pool->num_threads; n++) {
+    kb_thread_join(pool->workers[n].thread);
+    kb_thread_destroy(pool->workers[n].thread);
+    thread_index_release(pool->workers[n].thread_index);
+  }
 
-  while (tpassed < KILL_TIMEOUT && pool->num_threads_alive) {
-    kb_semaphore_post_all(pool->jobqueue.has_jobs);
-    time (&end);
-    tpassed = difftime(end,start);
+  for (int n = 0; n < pool->num_threads; n++) {
+    pool->workers[n].~kb_pool_worker();
   }
 
-  while (pool->num_threads_alive) {
-    kb_semaphore_post_all(pool->jobqueue.has_jobs);
-    sleep(1);
+  // Jobs that never ran are dropped along with their blocks
+  while (kb_job_block* block = pool->job_blocks) {
+    pool->job_blocks = block->next;
+    KB_DEFAULT_FREE(block);
   }
 
-  jobqueue_destroy(&pool->jobqueue);
+#if KB_FIBERS_SUPPORTED
+  // Fibers still suspended at this point are dropped
+  while (kb_fiber* fiber = pool->fiber_all) {
+    pool->fiber_all = fiber->all_next;
+    KB_DEFAULT_FREE(fiber->stack);
+    KB_DEFAULT_FREE(fiber);
+  }
+#endif
 
-  for (int n = 0; n < thread_count; n++) {
-    kb_thread_destroy(pool->threads[n]);
-    // thread_destroy(&pool->threads[n]);
+  for (uint32_t lane = 0; lane < KB_JOB_PRIORITY_COUNT; ++lane) {
+    kb_mutex_destroy(pool->inject[lane].mutex);
   }
+  kb_mutex_destroy(pool->job_mutex);
 
-  KB_DEFAULT_FREE(pool->threads);
+  KB_DEFAULT_FREE(pool->workers);
+
+  pool->~kb_thread_pool();
   KB_DEFAULT_FREE(pool);
 }
 
 int kb_threadpool_active_threads(kb_thread_pool* pool) {
-  return pool->num_threads_working;
+  const uint32_t outstanding  = pool->outstanding.load(std::memory_order_relaxed);
+  const uint32_t pending      = pool->pending.load(std::memory_order_relaxed);
+
+  return outstanding > pending ? (int) (outstanding - pending) : 0;
 }
 
-void* threadpool_do(void* userdata) {
-  kb_thread_pool* impl = (kb_thread_pool*) userdata;
-    
-  struct sigaction act;
-  sigemptyset(&act.sa_mask);
-  act.sa_flags = SA_SIGINFO;
-  act.sa_sigaction = thread_sig_handler;
+int kb_threadpool_thread_count(kb_thread_pool* pool) {
+  return pool->num_threads;
+}
 
-  kb_mutex_lock(impl->thread_count_mutex);
-  impl->num_threads_alive++;
-  kb_mutex_unlock(impl->thread_count_mutex);
-  
-  while (impl->pool_alive) {
-    kb_semaphore_wait(impl->jobqueue.has_jobs);
-    
-    if (impl->pool_alive) {
-      
-      kb_mutex_lock(impl->thread_count_mutex);
-
-      impl->num_threads_working++;
-      kb_mutex_unlock(impl->thread_count_mutex);
-
-      // Take a job
-      kb_job* job = jobqueue_pull(&impl->jobqueue);			
-
-      if (job) {
-        kb_job_func function_buffer = job->func;
-        void* param_buffer = job->userdata;
-        
-        function_buffer(param_buffer);
-
-        KB_DEFAULT_FREE(job);
-      }
-      
-      // Thread idle
-      kb_mutex_lock(impl->thread_count_mutex);
+//#####################################################################################################################
+// Lock profile
+//#####################################################################################################################
 
-      impl->num_threads_working--;
-      if (!impl->num_threads_working) {
-        pthread_cond_signal(&impl->threads_all_idle);
-      }
-      kb_mutex_unlock(impl->thread_count_mutex);
+#if KB_CONFIG_LOCK_PROFILE
+
+KB_INTERNAL pthread_mutex_t lock_profile_mutex = PTHREAD_MUTEX_INITIALIZER;
+KB_INTERNAL kb_lock_profile lock_profiles[KB_LOCK_PROFILE_MAX_NAMES];
+KB_INTERNAL kb_atomic_u32   lock_profile_count;
+
+KB_INTERNAL kb_lock_profile* lock_profile_get(const char* name) {
+  pthread_mutex_lock(&lock_profile_mutex);
 
+  uint32_t count = kb_atomic_load_u32(&lock_profile_count);
+  kb_lock_profile* profile = NULL;
+
+  for (uint32_t i = 0; i < count; ++i) {
+    if (kb_strcmp(lock_profiles[i].name, name) == 0) {
+      profile = &lock_profiles[i];
+      break;
     }
   }
-  
-  // Thread dead
-  kb_mutex_lock(impl->thread_count_mutex);
-  impl->num_threads_alive--;
-  kb_mutex_unlock(impl->thread_count_mutex);
-  
-  return NULL;
+
+  if (profile == NULL) {
+    KB_ASSERT(count < KB_LOCK_PROFILE_MAX_NAMES, "Too many lock names (KB_LOCK_PROFILE_MAX_NAMES)");
+
+    profile = &lock_profiles[count];
+    *profile = {};
+    profile->name = name;
+
+    // Publish only after the entry is filled in, reports read without the mutex
+    kb_atomic_store_u32(&lock_profile_count, count + 1);
+  }
+
+  pthread_mutex_unlock(&lock_profile_mutex);
+
+  return profile;
+}
+
+KB_INTERNAL void lock_profile_max(kb_atomic_u64* max, uint64_t value) {
+  uint64_t current = kb_atomic_load_relaxed_u64(max);
+  while (value > current && !kb_atomic_cas_u64(max, &current, value)) {}
 }
 
-void thread_sig_handler(int sig, siginfo_t* info, void* uctx) {
+KB_INTERNAL void lock_profile_acquired(kb_mutex* mutex, bool contended, uint64_t wait) {
+  kb_lock_profile* profile = mutex->profile;
 
+  kb_atomic_fetch_add_u64(&profile->acquisitions, 1);
+
+  if (contended) {
+    kb_atomic_fetch_add_u64(&profile->contended, 1);
+    kb_atomic_fetch_add_u64(&profile->wait_total, wait);
+    lock_profile_max(&profile->wait_max, wait);
+  }
+
+  mutex->locked_at = kb_time_get_fast();
 }
 
-void kb_semaphore_reset(kb_semaphore* sem, bool value) {
-  sem->mutex = kb_mutex_create();
+KB_INTERNAL void lock_profile_released(kb_mutex* mutex) {
+  kb_lock_profile* profile = mutex->profile;
+
+  uint64_t hold = kb_time_get_fast() - mutex->locked_at;
+
+  kb_atomic_fetch_add_u64(&profile->hold_total, hold);
+  lock_profile_max(&profile->hold_max, hold);
+}
+
+KB_INTERNAL uint64_t lock_profile_ns(const kb_atomic_u64* ticks) {
+  return (uint64_t) kb_time_fast_to_ns(kb_atomic_load_relaxed_u64(ticks));
+}
+
+KB_API uint32_t kb_lock_profile_report(kb_lock_stats* dst, uint32_t capacity) {
+  uint32_t count = kb_atomic_load_u32(&lock_profile_count);
+  if (dst == NULL) return count;
+
+  if (count > capacity) count = capacity;
+
+  for (uint32_t i = 0; i < count; ++i) {
+    const kb_lock_profile& profile = lock_profiles[i];
+
+    dst[i].name           = profile.name;
+    dst[i].acquisitions   = kb_atomic_load_relaxed_u64(&profile.acquisitions);
+    dst[i].contended      = kb_atomic_load_relaxed_u64(&profile.contended);
+    dst[i].wait_total_ns  = lock_profile_ns(&profile.wait_total);
+    dst[i].wait_max_ns    = lock_profile_ns(&profile.wait_max);
+    dst[i].hold_total_ns  = lock_profile_ns(&profile.hold_total);
+    dst[i].hold_max_ns    = lock_profile_ns(&profile.hold_max);
+  }
+
+  return count;
+}
+
+KB_API void kb_lock_profile_reset() {
+  uint32_t count = kb_atomic_load_u32(&lock_profile_count);
+
+  for (uint32_t i = 0; i < count; ++i) {
+    kb_lock_profile& profile = lock_profiles[i];
+
+    kb_atomic_store_u64(&profile.acquisitions,  0);
+    kb_atomic_store_u64(&profile.contended,     0);
+    kb_atomic_store_u64(&profile.wait_total,    0);
+    kb_atomic_store_u64(&profile.wait_max,      0);
+    kb_atomic_store_u64(&profile.hold_total,    0);
+    kb_atomic_store_u64(&profile.hold_max,      0);
+  }
+}
+
+KB_API void kb_lock_profile_dump() {
+  kb_lock_stats stats[KB_LOCK_PROFILE_MAX_NAMES];
+  uint32_t count = kb_lock_profile_report(stats, KB_LOCK_PROFILE_MAX_NAMES);
+
+  kb_printf("%-24s %12s %12s %14s %14s %14s %14s\n", "lock", "acquired", "contended", "wait ns", "wait max ns", "hold ns", "hold max ns");
+
+  for (uint32_t i = 0; i < count; ++i) {
+    kb_printf("%-24s %12llu %12llu %14llu %14llu %14llu %14llu\n", stats[i].name,
+      (unsigned long long) stats[i].acquisitions,   (unsigned long long) stats[i].contended,
+      (unsigned long long) stats[i].wait_total_ns,  (unsigned long long) stats[i].wait_max_ns,
+      (unsigned long long) stats[i].hold_total_ns,  (unsigned long long) stats[i].hold_max_ns);
+  }
+}
+
+#else
+
+KB_API uint32_t kb_lock_profile_report(kb_lock_stats* dst, uint32_t capacity) {
+  return 0;
+}
+
+KB_API void kb_lock_profile_reset() {}
+KB_API void kb_lock_profile_dump() {}
+
+#endif
+
+KB_INTERNAL void semaphore_init(kb_semaphore* sem, bool value, const char* name) {
+  sem->mutex = kb_mutex_create_named(name);
   pthread_cond_init(&(sem->cond), NULL);
   sem->value = value;
 }
 
-kb_semaphore* kb_semaphore_create(bool value) {
+void kb_semaphore_reset(kb_semaphore* sem, bool value) {
+  semaphore_init(sem, value, "semaphore");
+}
+
+kb_semaphore* kb_semaphore_create_named(bool value, const char* name) {
   kb_semaphore* semaphore;
   semaphore = (kb_semaphore*) KB_DEFAULT_ALLOC(sizeof(kb_semaphore));
   
-  kb_semaphore_reset(semaphore, value);
+  semaphore_init(semaphore, value, name);
 
   return semaphore;
 }
 
+kb_semaphore* kb_semaphore_create(bool value) {
+  return kb_semaphore_create_named(value, "semaphore");
+}
+
 void kb_semaphore_destroy(kb_semaphore* semaphore) {
+  pthread_cond_destroy(&semaphore->cond);
+  kb_mutex_destroy(semaphore->mutex);
   KB_DEFAULT_FREE(semaphore);
 }
 
@@ -294,6 +1589,10 @@ void kb_semaphore_wait(kb_semaphore* sem) {
 
   while (sem->value != 1) {
     pthread_cond_wait(&sem->cond, &sem->mutex->id);
+#if KB_CONFIG_LOCK_PROFILE
+    // Time spent asleep isn't held time
+    sem->mutex->locked_at = kb_time_get_fast();
+#endif
   }
 
   sem->value = 0;
@@ -301,94 +1600,46 @@ void kb_semaphore_wait(kb_semaphore* sem) {
 
 }
 
-int jobqueue_init(kb_job_queue* queue) {
-  queue->len = 0;
-  queue->front = NULL;
-  queue->rear  = NULL;
-
-  queue->mutex = kb_mutex_create();
-  queue->has_jobs = kb_semaphore_create(0);
-  
-  if (queue->has_jobs == NULL){
-    return -1;
-  }
-  
-  return 0;
-}
-
-void jobqueue_clear(kb_job_queue* queue) {
-  while(queue->len){
-    KB_DEFAULT_FREE(jobqueue_pull(queue));
-  }
-
-  queue->front = NULL;
-  queue->rear  = NULL;
-  kb_semaphore_reset(queue->has_jobs, false);
-  queue->len = 0;
-}
-
-void jobqueue_push(kb_job_queue* queue, kb_job* job) {
-  kb_mutex_lock(queue->mutex);
-
-  job->prev = NULL;
-  
-  if (queue->len == 0) {
-    queue->front = job;
-    queue->rear  = job;
-  } else {
-    queue->rear->prev = job;
-    queue->rear = job;
-  }
-
-  queue->len++;
-
-  kb_semaphore_post(queue->has_jobs);
-  kb_mutex_unlock(queue->mutex);
-}
-
-kb_job* jobqueue_pull(kb_job_queue* queue) {
-  kb_mutex_lock(queue->mutex);
-
-  kb_job* job = queue->front;
-
-  if (queue->len == 1) {
-    queue->front = NULL;
-    queue->rear  = NULL;
-    queue->len = 0;
-  } else if (queue->len > 0)  {
-    queue->front = job->prev;
-    queue->len--;
-    kb_semaphore_post(queue->has_jobs);
-  }
-
-  kb_mutex_unlock(queue->mutex);
-
-  return job;
-}
-
-void jobqueue_destroy(kb_job_queue* queue) {
-  jobqueue_clear(queue);
-
-  kb_semaphore_destroy(queue->has_jobs);
-}
-
-kb_mutex* kb_mutex_create() {
+kb_mutex* kb_mutex_create_named(const char* name) {
   kb_mutex* mutex;
   mutex = (kb_mutex*) KB_DEFAULT_ALLOC(sizeof(kb_mutex));
   
   pthread_mutex_init(&(mutex->id), NULL);
 
+#if KB_CONFIG_LOCK_PROFILE
+  mutex->profile    = lock_profile_get(name != NULL ? name : "unnamed");
+  mutex->locked_at  = 0;
+#endif
+
   return mutex;
 }
 
+kb_mutex* kb_mutex_create() {
+  return kb_mutex_create_named("unnamed");
+}
+
 void kb_mutex_destroy(kb_mutex* mutex) {
   KB_DEFAULT_FREE(mutex);
 }
 
 void kb_mutex_lock(kb_mutex* mutex) {
+#if KB_CONFIG_LOCK_PROFILE
+  if (pthread_mutex_trylock(&mutex->id) == 0) {
+    lock_profile_acquired(mutex, false, 0);
+    return;
+  }
+
+  uint64_t wait_start = kb_time_get_fast();
+  pthread_mutex_lock(&mutex->id);
+  lock_profile_acquired(mutex, true, kb_time_get_fast() - wait_start);
+#else
   pthread_mutex_lock(&mutex->id);
+#endif
 }
 
 void kb_mutex_unlock(kb_mutex* mutex) {
+#if KB_CONFIG_LOCK_PROFILE
+  lock_profile_released(mutex);
+#endif
   pthread_mutex_unlock(&mutex->id);
 }
@@ -6,19 +6,36 @@
 
 #include <kb/foundation/time.h>
 
-#include <sys/time.h>
+#include <kb/foundation/atomic.h>
 
-#define TIME_FREQ 1000000LL
+#include <errno.h>
+#include <time.h>
 
-const int64_t kb_time_ref = kb_time_get_raw();
+#if KB_CPU_X86
+  #include <cpuid.h>
+  #include <x86intrin.h>
+#endif
+
+#define TIME_FREQ               1000000000LL
+#define TIME_CALIBRATION_NS     10000000LL
+#define LIMITER_MIN_SPIN_NS     50000LL
+#define LIMITER_MAX_SPIN_NS     2000000LL
+
+typedef struct fast_timer_info {
+  bool    tsc;
+  double  ns_per_tick;
+  int64_t frequency;
+} fast_timer_info;
 
 int64_t kb_time_get_raw() {
-  struct timeval now;
-  gettimeofday(&now, 0);
-  return now.tv_sec * TIME_FREQ + now.tv_usec;
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t) now.tv_sec * TIME_FREQ + now.tv_nsec;
 }
 
-int64_t kb_current_time() {
+const int64_t kb_time_ref = kb_time_get_raw();
+
+int64_t kb_time_get_current() {
   return kb_time_get_raw() - kb_time_ref;
 }
 
@@ -27,5 +44,160 @@ int64_t kb_time_get_frequency() {
 }
 
 float kb_time() {
-  return double(kb_current_time()) / double(kb_time_get_frequency());
+  return double(kb_time_get_current()) / double(kb_time_get_frequency());
+}
+
+KB_INTERNAL bool has_invariant_tsc() {
+#if KB_CPU_X86
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007) return false;
+  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) return false;
+  return (edx & (1u << 8)) != 0;
+#else
+  return false;
+#endif
+}
+
+// Measures the TSC rate against the monotonic clock once, on first use
+KB_INTERNAL fast_timer_info calibrate_fast_timer() {
+  fast_timer_info info = { false, 1.0, TIME_FREQ };
+
+#if KB_CPU_X86
+  if (!has_invariant_tsc()) return info;
+
+  int64_t   clock_start = kb_time_get_raw();
+  uint64_t  tsc_start   = __rdtsc();
+  int64_t   clock_end;
+
+  do {
+    clock_end = kb_time_get_raw();
+  } while (clock_end - clock_start < TIME_CALIBRATION_NS);
+
+  uint64_t tsc_end = __rdtsc();
+
+  double ticks_per_ns = double(tsc_end - tsc_start) / double(clock_end - clock_start);
+  if (ticks_per_ns <= 0.0) return info;
+
+  info.tsc          = true;
+  info.ns_per_tick  = 1.0 / ticks_per_ns;
+  info.frequency    = (int64_t) (ticks_per_ns * double(TIME_FREQ));
+#endif
+
+  return info;
+}
+
+KB_INTERNAL const fast_timer_info& fast_timer() {
+  static const fast_timer_info info = calibrate_fast_timer();
+  return info;
+}
+
+bool kb_time_fast_is_tsc() {
+  return fast_timer().tsc;
+}
+
+uint64_t kb_time_get_fast() {
+#if KB_CPU_X86
+  if (fast_timer().tsc) return __rdtsc();
+#endif
+
+  return (uint64_t) kb_time_get_raw();
+}
+
+int64_t kb_time_get_fast_frequency() {
+  return fast_timer().frequency;
+}
+
+int64_t kb_time_fast_to_ns(uint64_t ticks) {
+  return (int64_t) (double(ticks) * fast_timer().ns_per_tick);
+}
+
+// Deadlines are kb_time_get_raw values
+KB_INTERNAL void sleep_until(int64_t deadline) {
+#if KB_PLATFORM_LINUX
+  struct timespec ts;
+  ts.tv_sec   = deadline / TIME_FREQ;
+  ts.tv_nsec  = deadline % TIME_FREQ;
+
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+#else
+  // No absolute sleep on macOS, a relative one recomputed after interrupts
+  // overshoots by the same scheduler latency the spin already covers
+  while (true) {
+    int64_t remaining = deadline - kb_time_get_raw();
+    if (remaining <= 0) break;
+
+    struct timespec ts;
+    ts.tv_sec   = remaining / TIME_FREQ;
+    ts.tv_nsec  = remaining % TIME_FREQ;
+
+    if (nanosleep(&ts, NULL) == 0) break;
+    if (errno != EINTR) break;
+  }
+#endif
+}
+
+void kb_frame_limiter_create(kb_frame_limiter* limiter, double rate, uint32_t sample_count) {
+  KB_ASSERT_NOT_NULL(limiter);
+
+  limiter->deadline = 0;
+  limiter->spin     = LIMITER_MIN_SPIN_NS * 4;
+
+  kb_sampler_create(&limiter->error, sample_count);
+  kb_frame_limiter_set_rate(limiter, rate);
+}
+
+void kb_frame_limiter_destroy(kb_frame_limiter* limiter) {
+  KB_ASSERT_NOT_NULL(limiter);
+
+  kb_sampler_destroy(&limiter->error);
+}
+
+void kb_frame_limiter_set_rate(kb_frame_limiter* limiter, double rate) {
+  KB_ASSERT_NOT_NULL(limiter);
+
+  limiter->interval = rate > 0.0 ? (int64_t) (double(TIME_FREQ) / rate) : 0;
+  limiter->deadline = 0;
+}
+
+int64_t kb_frame_limiter_wait(kb_frame_limiter* limiter) {
+  KB_ASSERT_NOT_NULL(limiter);
+
+  int64_t now = kb_time_get_raw();
+
+  // First frame, or limiting is off
+  if (limiter->interval == 0 || limiter->deadline == 0) {
+    limiter->deadline = now + limiter->interval;
+    return now;
+  }
+
+  int64_t deadline = limiter->deadline;
+
+  if (now < deadline - limiter->spin) {
+    int64_t wake_target = deadline - limiter->spin;
+    sleep_until(wake_target);
+    now = kb_time_get_raw();
+
+    // Track the worst recent wake up latency, decaying slowly so one bad
+    // wake doesn't leave us spinning for long
+    int64_t late = now - wake_target;
+    int64_t spin = late * 5 / 4 > limiter->spin ? late * 5 / 4 : limiter->spin - (limiter->spin - late) / 16;
+
+    if (spin < LIMITER_MIN_SPIN_NS) spin = LIMITER_MIN_SPIN_NS;
+    if (spin > LIMITER_MAX_SPIN_NS) spin = LIMITER_MAX_SPIN_NS;
+    limiter->spin = spin;
+  }
+
+  while (now < deadline) {
+    kb_cpu_relax();
+    now = kb_time_get_raw();
+  }
+
+  kb_sampler_push(&limiter->error, (float) (now - deadline) * 1e-3f);
+
+  limiter->deadline = deadline + limiter->interval;
+  if (limiter->deadline < now) {
+    limiter->deadline = now + limiter->interval;
+  }
+
+  return now;
 }
@@ -11,9 +11,17 @@
 
 typedef struct pipeline_info {
   kb_uniform_layout         uniform_layout;
-  uint32_t                  pass;
 } pipeline_info;
 
+// Pass of every pipeline by handle, read by encoders on any thread. A table is
+// never resized in place, growing publishes a copy and keeps the old one alive
+// until kb_graphics_deinit since recording threads might still be reading it.
+typedef struct pipeline_pass_table {
+  uint32_t                    capacity;
+  uint32_t*                   passes;
+  struct pipeline_pass_table* retired;
+} pipeline_pass_table;
+
 typedef struct kb_pipe_attachment {
   kb_attachment_flags       flags;
   kb_format                 format;
@@ -31,6 +39,7 @@ typedef struct graphics_pipe_info {
 
 typedef struct kb_encoder_frame {
   kb_pipeline               pipeline;
+  uint32_t                  pass;
   kb_vertex_buffer_binding  vertex_buffer_bindings[KB_CONFIG_MAX_VERTEX_BUFFERS_BINDINGS];
   kb_index_buffer_binding   index_buffer;
   kb_texture_binding        vertex_texture_bindings   [KB_CONFIG_MAX_UNIFORM_BINDINGS];
@@ -41,23 +50,27 @@ typedef struct kb_encoder_frame {
   kb_uniform_binding        compute_uniform_bindings  [KB_CONFIG_MAX_UNIFORM_BINDINGS];
 } kb_encoder_frame;
 
+// Everything an encoder records goes into its own state, so encoders can be
+// filled from different threads without touching each other.
 typedef struct kb_encoder_state {
   uint32_t                  stack_pos;
   uint32_t                  draw_call_count;
   uint32_t                  compute_call_count;
+  uint32_t                  uniform_binding_count;
+  uint32_t                  texture_binding_count;
   kb_encoder_frame          stack[KB_CONFIG_GIZMO_STACK_SIZE];
   kb_render_call*           draw_calls;
   kb_compute_call*          compute_calls;
 } kb_encoder_state;
 
 typedef struct kb_encoder_pool {
-  uint16_t                  count;
+  kb_atomic_u32             count;
   kb_encoder_state          states[KB_CONFIG_MAX_ENCODERS];
 } kb_encoder_pool;
 
 typedef struct kb_transient_buffer {
   kb_buffer                 buffer;
-  uint64_t                  position;
+  kb_atomic_u64             position;
 } kb_transient_buffer;
 
 kb_encoder_pool*    encoder_pools;
@@ -77,6 +90,9 @@ kb_transient_buffer transient_buffers[KB_CONFIG_MAX_FRAMES_IN_FLIGHT];
 uint32_t draw_call_count;
 uint32_t compute_call_count;
 
+uint32_t max_draw_calls         = KB_CONFIG_MAX_DRAW_CALLS;
+uint32_t transient_buffer_size  = KB_CONFIG_TRANSIENT_BUFFER_SIZE;
+
 // Stats
 int64_t frame_timestamp = 0.0f;
 
@@ -85,6 +101,57 @@ kb::sampler platform_frametime_sampler(KB_CONFIG_STATS_SAMPLE_COUNT);
 
 kb_graphics_stats stats_cache;
 
+// Rolling history for kb_graphics_write_stats_csv
+kb_graphics_stats stats_history[KB_CONFIG_STATS_SAMPLE_COUNT];
+uint32_t          stats_history_count;
+uint32_t          stats_history_pos;
+
+kb_atomic_u64     upload_bytes;
+
+kb_atomic_ptr     pipeline_passes;
+
+// Render thread
+kb_thread*            render_thread;
+kb_counting_semaphore render_ready;
+kb_counting_semaphore render_idle;
+kb_atomic_u32         render_quit;
+uint32_t              render_slot;
+kb_graphics_stats     render_stats;
+kb_int2               render_extent;
+double                render_platform_frametime;
+
+KB_INTERNAL thread_local bool render_thread_active = false;
+
+// Only called from kb_pipeline_construct, which isn't thread safe anyway
+KB_INTERNAL pipeline_pass_table* grow_pipeline_passes(uint32_t capacity) {
+  pipeline_pass_table* current = (pipeline_pass_table*) kb_atomic_load_ptr(&pipeline_passes);
+  if (current != NULL && current->capacity >= capacity) return current;
+
+  pipeline_pass_table* table = KB_DEFAULT_ALLOC_TYPE(pipeline_pass_table, 1);
+  table->capacity = capacity;
+  table->passes   = KB_DEFAULT_ALLOC_TYPE(uint32_t, capacity);
+  table->retired  = current;
+
+  kb_memset(table->passes, 0, sizeof(uint32_t) * capacity);
+  if (current != NULL) {
+    kb_memcpy(table->passes, current->passes, sizeof(uint32_t) * current->capacity);
+  }
+
+  kb_atomic_store_release_ptr(&pipeline_passes, table);
+  return table;
+}
+
+KB_INTERNAL void free_pipeline_passes() {
+  pipeline_pass_table* table = (pipeline_pass_table*) kb_atomic_exchange_ptr(&pipeline_passes, NULL);
+
+  while (table != NULL) {
+    pipeline_pass_table* retired = table->retired;
+    KB_DEFAULT_FREE(table->passes);
+    KB_DEFAULT_FREE(table);
+    table = retired;
+  }
+}
+
 kb_encoder_pool& current_encoder_pool() {
   return encoder_pools[kb_graphics_get_current_resource_slot()];
 }
@@ -109,7 +176,7 @@ KB_RESOURCE_DATA_HASHED_DEF (buffer,        kb_buffer);
 KB_RESOURCE_DATA_HASHED_DEF (texture,       kb_texture);
 KB_RESOURCE_DATA_HASHED_DEF (pipeline,      kb_pipeline);
 
-KB_RESOURCE_STORAGE_DEF     (pipeline_info, kb_pipeline,      pipeline_info,      KB_CONFIG_MAX_PROGRAMS);
+KB_RESOURCE_STORAGE_DEF     (pipeline_info, kb_pipeline,      pipeline_info);
 
 #define COMPARE_VALUE(_a, _b) if (_a < _b) return -1; if (_b < _a) return 1;
 
@@ -117,15 +184,18 @@ void reset_encoder_state(kb_encoder_state& state) {
   state.stack_pos = 0;
   state.draw_call_count = 0;
   state.compute_call_count = 0;
+  state.uniform_binding_count = 0;
+  state.texture_binding_count = 0;
 }
 
 void construct_encoder_pools() {
   encoder_pools = KB_DEFAULT_ALLOC_TYPE(kb_encoder_pool, KB_CONFIG_MAX_FRAMES_IN_FLIGHT);
+  kb_memset(encoder_pools, 0, sizeof(kb_encoder_pool) * KB_CONFIG_MAX_FRAMES_IN_FLIGHT);
 
   for (int pool_i = 0; pool_i < KB_CONFIG_MAX_FRAMES_IN_FLIGHT; ++pool_i) {
     for (int state_i = 0; state_i < KB_CONFIG_MAX_ENCODERS; ++state_i) {
-      encoder_pools[pool_i].states[state_i].draw_calls = KB_DEFAULT_ALLOC_TYPE(kb_render_call, KB_CONFIG_MAX_DRAW_CALLS);
-      encoder_pools[pool_i].states[state_i].compute_calls = KB_DEFAULT_ALLOC_TYPE(kb_compute_call, KB_CONFIG_MAX_DRAW_CALLS);
+      encoder_pools[pool_i].states[state_i].draw_calls = KB_DEFAULT_ALLOC_TYPE(kb_render_call, max_draw_calls);
+      encoder_pools[pool_i].states[state_i].compute_calls = KB_DEFAULT_ALLOC_TYPE(kb_compute_call, max_draw_calls);
     }
   }
 }
@@ -176,10 +246,13 @@ KB_INTERNAL kb_transient_buffer& get_current_transient_buffer() {
 
 KB_INTERNAL void acquire_frame_resources() {
   resource_slot = (resource_slot + 1) % KB_CONFIG_MAX_FRAMES_IN_FLIGHT;
-  get_current_transient_buffer().position = 0;
+  kb_atomic_store_u64(&get_current_transient_buffer().position, 0);
 }
 
 KB_API uint32_t kb_graphics_get_current_resource_slot() {
+  // Platform code running on the render thread sees the frame being submitted
+  if (render_thread_active) return render_slot;
+
   return resource_slot;
 }
 
@@ -189,8 +262,15 @@ KB_API kb_buffer_memory kb_graphics_transient_alloc(uint64_t size, kb_buffer_usa
   // TODO: Calculate align from usage
   uint64_t align = 256;
 
-  size_t pos = kb_align_up(buffer.position, align);
-  buffer.position = pos + size;
+  // Encoders recording on other threads allocate from the same buffer
+  uint64_t current = kb_atomic_load_relaxed_u64(&buffer.position);
+  uint64_t pos;
+
+  do {
+    pos = kb_align_up(current, align);
+  } while (!kb_atomic_cas_u64(&buffer.position, &current, pos + size));
+
+  KB_ASSERT(pos + size <= transient_buffer_size, "Transient buffer overflow (kb_graphics_capacity_info.transient_buffer_size)");
   
   return { 
     .buffer=buffer.buffer,
@@ -201,6 +281,8 @@ KB_API kb_buffer_memory kb_graphics_transient_alloc(uint64_t size, kb_buffer_usa
 KB_API void kb_graphics_memory_write(const void* src, uint64_t size, kb_buffer_memory memory) {
   if (size == 0) return;
 
+  kb_atomic_fetch_add_u64(&upload_bytes, size);
+
   if (src != NULL) {
     void* dst = kb_platform_graphics_buffer_mapped(memory);
     kb_memcpy(dst, src, size);
@@ -222,17 +304,270 @@ kb_int2 calculate_attachment_size(kb_int2 extent, kb_float2 size, kb_attachment_
   return (kb_int2) { (int) size.x, (int) size.y };
 }
 
+KB_INTERNAL float elapsed_seconds(uint64_t start) {
+  return (float) ((double) kb_time_fast_to_ns(kb_time_get_fast() - start) * 1e-9);
+}
+
+// Encoders taken past the limit still bump the count
+KB_INTERNAL uint32_t encoder_pool_count(kb_encoder_pool& pool) {
+  uint32_t count = kb_atomic_load_u32(&pool.count);
+  return count < KB_CONFIG_MAX_ENCODERS ? count : KB_CONFIG_MAX_ENCODERS;
+}
+
+KB_INTERNAL void run_encoder_pool(kb_encoder_pool& pool, kb_graphics_stats& stats) {
+  KB_PROFILE_SCOPE("kb_graphics_run_encoders");
+
+  uint64_t run_start = kb_time_get_fast();
+
+  stats.draw_calls_used = 0;
+  stats.compute_calls_used = 0;
+  stats.pass_count = graphics_pipe->pass_count;
+
+  uint32_t encoder_count = encoder_pool_count(pool);
+
+  // Fill caches
+  for (uint32_t encoder_i = 0; encoder_i < encoder_count; ++encoder_i) {
+    kb_encoder_state& state = pool.states[encoder_i];
+
+    for (uint32_t call_i = 0; call_i < state.draw_call_count; ++call_i) {
+      kb_render_call& call = state.draw_calls[call_i];
+      KB_ASSERT_VALID(call.pipeline);
+      
+      draw_call_cache[call.pass][draw_call_cache_pos[call.pass]++] = call;
+    }
+
+    for (uint32_t call_i = 0; call_i < state.compute_call_count; ++call_i) {
+      kb_compute_call& call = state.compute_calls[call_i];
+      KB_ASSERT_VALID(call.pipeline);
+
+      compute_call_cache[call.pass][compute_call_cache_pos[call.pass]++] = call;
+    }
+  }
+    
+  // Run passes
+  for (uint32_t pass_i = 0; pass_i < graphics_pipe->pass_count; ++pass_i) {
+    kb_graphics_pass_stats& pass_stats = stats.passes[pass_i];
+    pass_stats = {};
+
+    // Sort draw calls
+    uint64_t sort_start = kb_time_get_fast();
+    if (draw_call_cache_pos[pass_i] > 0) {
+      KB_PROFILE_SCOPE("kb_graphics_sort_draw_calls");
+      kb_sort(draw_call_cache[pass_i], draw_call_cache_pos[pass_i], sizeof(kb_render_call), draw_call_compare);
+    }
+    pass_stats.sort_time = elapsed_seconds(sort_start);
+
+    uint64_t submit_start = kb_time_get_fast();
+
+    // Submit render calls
+    {
+      KB_PROFILE_SCOPE("kb_platform_graphics_submit_render_pass");
+      kb_platform_graphics_submit_render_pass(pass_i, draw_call_cache[pass_i], draw_call_cache_pos[pass_i]);
+    }
+    pass_stats.draw_calls = draw_call_cache_pos[pass_i];
+    stats.draw_calls_used += draw_call_cache_pos[pass_i];
+
+    
+    if (compute_call_cache_pos[pass_i] > 0) {
+      // Submit compute calls
+      KB_PROFILE_SCOPE("kb_platform_graphics_submit_compute_pass");
+      kb_platform_graphics_submit_compute_pass(pass_i, compute_call_cache[pass_i], compute_call_cache_pos[pass_i]);
+      pass_stats.compute_calls = compute_call_cache_pos[pass_i];
+      stats.compute_calls_used += compute_call_cache_pos[pass_i];
+    }
+    pass_stats.submit_time = elapsed_seconds(submit_start);
+    
+    compute_call_cache_pos[pass_i] = 0;
+    draw_call_cache_pos[pass_i] = 0;
+  }
+
+  stats.run_encoders_time = elapsed_seconds(run_start);
+
+  KB_PROFILE_COUNTER("draw_calls", stats.draw_calls_used);
+}
+
+KB_INTERNAL void reset_encoder_pool(kb_encoder_pool& pool) {
+  uint32_t encoder_count = encoder_pool_count(pool);
+
+  for (uint32_t i = 0; i < encoder_count; ++i) {
+    reset_encoder_state(pool.states[i]);
+  }
+  kb_atomic_store_u32(&pool.count, 0);
+}
+
+// Updates the given extent, which is the render thread's own copy when it runs
+KB_INTERNAL void resize_attachments(kb_int2& current_extent) {
+  kb_int2 extent = kb_platform_graphics_surface_extent();
+
+  if (extent.x != current_extent.x || extent.y != current_extent.y) {
+    current_extent = extent;
+    kb::log_debug("Surface resized ({} {})", current_extent.x, current_extent.y);
+
+    // Resize attachments
+    for (uint32_t attachment_i = 0; attachment_i < graphics_pipe->attachment_count; ++attachment_i) {
+      kb_texture texture = graphics_pipe->attachments[attachment_i].texture;
+      if (!KB_IS_VALID(graphics_pipe->attachments[attachment_i].texture)) continue;
+
+      kb_pipe_attachment& attachment = graphics_pipe->attachments[attachment_i];
+
+      if (attachment.flags & (KB_ATTACHMENT_FLAGS_USE_SURFACE_SIZE | KB_ATTACHMENT_FLAGS_SIZE_IS_RELATIVE)) {
+        kb_int2 attachment_size = calculate_attachment_size(current_extent, attachment.size, attachment.flags);
+
+        kb_platform_graphics_texture_destruct(texture);
+        
+        kb_platform_graphics_texture_construct(texture, {
+          .texture = {
+            .width  = (uint32_t) attachment_size.x,
+            .height = (uint32_t) attachment_size.y,
+            .format = attachment.format,
+          },
+          .usage  = attachment.usage,
+        });
+      }
+    }
+  }
+}
+
+KB_INTERNAL double present_frame() {
+  KB_PROFILE_SCOPE("kb_platform_graphics_frame");
+
+  int64_t platform_frame_start = kb_time_get_raw();
+
+  kb_platform_graphics_frame();
+  
+  int64_t platform_frame_time_diff = kb_time_get_raw() - platform_frame_start;
+  return (double) platform_frame_time_diff / (double) kb_time_get_frequency();
+}
+
+// Numbers about recording, gathered on the main thread before the pool is
+// handed off or reset
+KB_INTERNAL void update_frame_stats(double platform_frame_time, kb_encoder_pool& pool) {
+  uint32_t encoders_used = encoder_pool_count(pool);
+
+  stats_cache.uniform_bindings = 0;
+  stats_cache.texture_bindings = 0;
+
+  for (uint32_t i = 0; i < encoders_used; ++i) {
+    stats_cache.uniform_bindings += pool.states[i].uniform_binding_count;
+    stats_cache.texture_bindings += pool.states[i].texture_binding_count;
+  }
+
+  // Position runs past the end on overflow, clamp so the 32 bit stats stay exact
+  uint64_t transient_used = kb_atomic_load_u64(&get_current_transient_buffer().position);
+  if (transient_used > transient_buffer_size) transient_used = transient_buffer_size;
+
+  stats_cache.transient_allocated     = transient_buffer_size;
+  stats_cache.transient_used          = (uint32_t) transient_used;
+  if (transient_used > stats_cache.transient_high_water) stats_cache.transient_high_water = (uint32_t) transient_used;
+  stats_cache.upload_bytes            = kb_atomic_exchange_u64(&upload_bytes, 0);
+
+  platform_frametime_sampler.push(platform_frame_time);
+
+  stats_cache.platform_frametime      = platform_frame_time;
+  stats_cache.platform_frametime_avg  = platform_frametime_sampler.avg();
+  stats_cache.platform_frametime_min  = platform_frametime_sampler.min();
+  stats_cache.platform_frametime_max  = platform_frametime_sampler.max();
+  
+  stats_cache.buffer_count            = kb_buffer_count();
+  stats_cache.texture_count           = kb_texture_count();
+  stats_cache.encoders_used           = encoders_used;
+  stats_cache.encoders_allocated      = KB_CONFIG_MAX_ENCODERS;
+  stats_cache.frametime_avg           = frametime_sampler.avg();
+  stats_cache.frametime_min           = frametime_sampler.min();
+  stats_cache.frametime_max           = frametime_sampler.max();
+  stats_cache.draw_calls_allocated    = max_draw_calls;
+  stats_cache.compute_calls_allocated = max_draw_calls;
+}
+
+KB_INTERNAL void end_frame_timing() {
+  int64_t ctime = kb_time_get_current();
+  int64_t frametime_diff = ctime - frame_timestamp;
+  frame_timestamp = ctime;
+  
+  double frametime = (double) frametime_diff / (double) kb_time_get_frequency();
+  
+  frametime_sampler.push(frametime);
+  stats_cache.frametime = frametime;
+
+  stats_history[stats_history_pos] = stats_cache;
+  stats_history_pos = (stats_history_pos + 1) % KB_CONFIG_STATS_SAMPLE_COUNT;
+  if (stats_history_count < KB_CONFIG_STATS_SAMPLE_COUNT) stats_history_count++;
+}
+
+// The render thread makes the submit, present and attachment resize platform
+// calls, resource construct/destruct stays on the caller's thread (see
+// graphics.h). It runs one frame behind the main thread: while it sorts and
+// submits the pool in render_slot, the main thread records into the next slot.
+// Its extent is handed back under the render_idle handshake.
+KB_INTERNAL void* render_thread_main(void* userdata) {
+  KB_PROFILE_THREAD_NAME("kb render");
+  render_thread_active = true;
+
+  while (true) {
+    kb_counting_semaphore_wait(&render_ready);
+    if (kb_atomic_load_u32(&render_quit)) break;
+
+    kb_encoder_pool& pool = encoder_pools[render_slot];
+
+    run_encoder_pool(pool, render_stats);
+    resize_attachments(render_extent);
+    render_platform_frametime = present_frame();
+    reset_encoder_pool(pool);
+
+    kb_counting_semaphore_post(&render_idle, 1);
+  }
+
+  return NULL;
+}
+
+KB_INTERNAL void start_render_thread() {
+  kb_atomic_store_u32(&render_quit, 0);
+  kb_counting_semaphore_init(&render_ready, 0);
+  kb_counting_semaphore_init(&render_idle, 1);
+  render_extent = current_extent;
+
+  render_thread = kb_thread_create(render_thread_main, NULL);
+}
+
+KB_INTERNAL void stop_render_thread() {
+  kb_counting_semaphore_wait(&render_idle);
+
+  kb_atomic_store_u32(&render_quit, 1);
+  kb_counting_semaphore_post(&render_ready, 1);
+
+  kb_thread_join(render_thread);
+  kb_thread_destroy(render_thread);
+  render_thread = NULL;
+}
+
 KB_API void kb_graphics_init(const kb_graphics_init_info info) {
+  // Capacities have to be in place before platform init creates resources
+  if (info.capacity.buffers   > 0) kb_buffer_set_capacity   (info.capacity.buffers);
+  if (info.capacity.textures  > 0) kb_texture_set_capacity  (info.capacity.textures);
+  if (info.capacity.pipelines > 0) kb_pipeline_set_capacity (info.capacity.pipelines);
+
+  if (info.capacity.draw_calls            > 0) max_draw_calls         = info.capacity.draw_calls;
+  if (info.capacity.transient_buffer_size > 0) transient_buffer_size  = info.capacity.transient_buffer_size;
+
+  // Sized up front so creating pipelines while encoders record only grows it
+  // when the capacity is raised after init
+  grow_pipeline_passes(kb_pipeline_capacity() > 0 ? kb_pipeline_capacity() : KB_CONFIG_MAX_PROGRAMS);
+
   kb_platform_graphics_init(info);
 
   for (uint32_t pass_i = 0; pass_i < KB_CONFIG_MAX_RENDERPASSES; ++pass_i) {
     draw_call_cache_pos[pass_i] = 0;
-    draw_call_cache[pass_i]     = KB_DEFAULT_ALLOC_TYPE(kb_render_call, KB_CONFIG_MAX_DRAW_CALLS);
+    draw_call_cache[pass_i]     = KB_DEFAULT_ALLOC_TYPE(kb_render_call, max_draw_calls);
     
     compute_call_cache_pos[pass_i] = 0;
-    compute_call_cache[pass_i]     = KB_DEFAULT_ALLOC_TYPE(kb_compute_call, KB_CONFIG_MAX_DRAW_CALLS);
+    compute_call_cache[pass_i]     = KB_DEFAULT_ALLOC_TYPE(kb_compute_call, max_draw_calls);
   }
 
+  // Stats and their history start over with every init
+  stats_cache         = {};
+  stats_history_count = 0;
+  stats_history_pos   = 0;
+
   char tmpstr[512] = {0};
 
   // Transient buffers
@@ -240,10 +575,10 @@ KB_API void kb_graphics_init(const kb_graphics_init_info info) {
     kb::strfmt(tmpstr, 512, "Transient buffer ({})", frame_i);
     
     transient_buffers[frame_i] = {};
-    transient_buffers[frame_i].position = 0;
+    kb_atomic_store_u64(&transient_buffers[frame_i].position, 0);
     transient_buffers[frame_i].buffer = kb_buffer_create({
       .rwops        = NULL,
-      .size         = KB_CONFIG_TRANSIENT_BUFFER_SIZE,
+      .size         = transient_buffer_size,
       .usage        = KB_BUFFER_USAGE_VERTEX_BUFFER | KB_BUFFER_USAGE_INDEX_BUFFER | KB_BUFFER_USAGE_UNIFORM_BUFFER | KB_BUFFER_USAGE_CPU_WRITE,
       .debug_label  = tmpstr,
     });
@@ -275,12 +610,10 @@ KB_API void kb_graphics_init(const kb_graphics_init_info info) {
       attachment.usage = attachment_info.usage;
       attachment.texture = kb_texture_create({
         .rwops        = NULL,
-        .debug_label  = tmpstr,
-        .usage        = attachment_info.usage,
         .texture      = {
-          .format = attachment_info.format,
           .width  = (uint32_t) attachment_size.x,
           .height = (uint32_t) attachment_size.y,
+          .format = attachment_info.format,
         },
         .sampler      = {
           .min_filter     = KB_FILTER_NEAREST,
@@ -290,7 +623,9 @@ KB_API void kb_graphics_init(const kb_graphics_init_info info) {
           .address_mode_w = KB_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
           .anisotropy     = 0.0f,
         },
+        .usage        = attachment_info.usage,
         .mipmaps      = false,
+        .debug_label  = tmpstr,
       });
     }
   }
@@ -303,14 +638,26 @@ KB_API void kb_graphics_init(const kb_graphics_init_info info) {
   construct_encoder_pools();
   
   acquire_frame_resources();
+
+  if (info.render_thread) {
+    // Recording runs one frame ahead of submission, which needs a spare slot
+    KB_ASSERT(KB_CONFIG_MAX_FRAMES_IN_FLIGHT >= 3, "Render thread needs at least 3 frames in flight");
+    start_render_thread();
+  }
 }
 
 KB_API void kb_graphics_deinit() {
+  if (render_thread != NULL) {
+    stop_render_thread();
+  }
+
   kb_pipeline_purge();
   kb_texture_purge();
 
   kb_platform_graphics_deinit();
 
+  free_pipeline_passes();
+
   for (uint32_t pass_i = 0; pass_i < KB_CONFIG_MAX_RENDERPASSES; ++pass_i) {
     KB_DEFAULT_FREE(draw_call_cache[pass_i]);
     KB_DEFAULT_FREE(compute_call_cache[pass_i]);
@@ -320,126 +667,54 @@ KB_API void kb_graphics_deinit() {
 }
 
 KB_API void kb_graphics_run_encoders() {
-  stats_cache.draw_calls_used = 0;
-  stats_cache.compute_calls_used = 0;
-  
-  // Fill caches
-  for (uint32_t encoder_i = 0; encoder_i < current_encoder_pool().count; ++encoder_i) {
-    kb_encoder_state& state = current_encoder_pool().states[encoder_i];
-
-    for (uint32_t call_i = 0; call_i < state.draw_call_count; ++call_i) {
-      kb_render_call& call = state.draw_calls[call_i];
-      KB_ASSERT_VALID(call.pipeline);
-      
-      uint32_t pass = pipeline_info_ref(call.pipeline)->pass;
-      draw_call_cache[pass][draw_call_cache_pos[pass]++] = call;
-    }
-
-    for (uint32_t call_i = 0; call_i < state.compute_call_count; ++call_i) {
-      kb_compute_call& call = state.compute_calls[call_i];
-      KB_ASSERT_VALID(call.pipeline);
-
-      uint32_t pass = pipeline_info_ref(call.pipeline)->pass;
-      compute_call_cache[pass][compute_call_cache_pos[pass]++] = call;
-    }
-  }
-    
-  // Run passes
-  for (uint32_t pass_i = 0; pass_i < graphics_pipe->pass_count; ++pass_i) {
-    // Sort draw calls
-    if (draw_call_cache_pos[pass_i] > 0) {
-      kb_sort(draw_call_cache[pass_i], draw_call_cache_pos[pass_i], sizeof(kb_render_call), draw_call_compare);
-    }
-    // Submit render calls
-    kb_platform_graphics_submit_render_pass(pass_i, draw_call_cache[pass_i], draw_call_cache_pos[pass_i]);
-    stats_cache.draw_calls_used += draw_call_cache_pos[pass_i];
+  // The render thread submits the whole frame from kb_graphics_frame
+  if (render_thread != NULL) return;
 
-    
-    if (compute_call_cache_pos[pass_i] > 0) {
-      // Submit compute calls
-      kb_platform_graphics_submit_compute_pass(pass_i, compute_call_cache[pass_i], compute_call_cache_pos[pass_i]);
-      stats_cache.compute_calls_used += compute_call_cache_pos[pass_i];
-    }
-    
-    compute_call_cache_pos[pass_i] = 0;
-    draw_call_cache_pos[pass_i] = 0;
-  }
+  run_encoder_pool(current_encoder_pool(), stats_cache);
 }
 
 KB_API void kb_graphics_frame() {
-  kb_int2 extent = kb_platform_graphics_surface_extent();
-
-  if (extent.x != current_extent.x || extent.y != current_extent.y) {
-    current_extent = extent;
-    kb::log_debug("Surface resized ({} {})", current_extent.x, current_extent.y);
-
-    // Resize attachments
-    for (uint32_t attachment_i = 0; attachment_i < graphics_pipe->attachment_count; ++attachment_i) {
-      kb_texture texture = graphics_pipe->attachments[attachment_i].texture;
-      if (!KB_IS_VALID(graphics_pipe->attachments[attachment_i].texture)) continue;
-
-      kb_pipe_attachment& attachment = graphics_pipe->attachments[attachment_i];
-
-      if (attachment.flags & (KB_ATTACHMENT_FLAGS_USE_SURFACE_SIZE | KB_ATTACHMENT_FLAGS_SIZE_IS_RELATIVE)) {
-        kb_int2 attachment_size = calculate_attachment_size(current_extent, attachment.size, attachment.flags);
-
-        kb_platform_graphics_texture_destruct(texture);
-        
-        kb_platform_graphics_texture_construct(texture, {
-          .usage  = attachment.usage,
-          .texture = {
-            .width  = (uint32_t) attachment_size.x,
-            .height = (uint32_t) attachment_size.y,
-            .format = attachment.format,
-          }
-        });
-      }
-    }
+  KB_PROFILE_FRAME_MARK();
+  kb_metric_frame();
+  kb_alloc_frame_mark();
+
+  if (render_thread != NULL) {
+    // Previous frame has been submitted and its slot reset
+    kb_counting_semaphore_wait(&render_idle);
+
+    // Submission numbers lag recording by one frame in this mode
+    stats_cache.draw_calls_used     = render_stats.draw_calls_used;
+    stats_cache.compute_calls_used  = render_stats.compute_calls_used;
+    stats_cache.run_encoders_time   = render_stats.run_encoders_time;
+    stats_cache.pass_count          = render_stats.pass_count;
+    kb_memcpy(stats_cache.passes, render_stats.passes, sizeof(stats_cache.passes));
+
+    update_frame_stats(render_platform_frametime, current_encoder_pool());
+    current_extent = render_extent;
+
+    render_slot = resource_slot;
+    kb_counting_semaphore_post(&render_ready, 1);
+  } else {
+    resize_attachments(current_extent);
+
+    double platform_frame_time = present_frame();
+
+    kb_encoder_pool& current_pool = current_encoder_pool();
+    update_frame_stats(platform_frame_time, current_pool);
+    reset_encoder_pool(current_pool);
   }
 
-  int64_t platform_frame_start = kb_time_get_raw();
-
-  kb_platform_graphics_frame();
-  
-  int64_t platform_frame_time_diff = kb_time_get_raw() - platform_frame_start;
-  double platform_frame_time = (double) platform_frame_time_diff / (double) kb_time_get_frequency();
-  
-  platform_frametime_sampler.push(platform_frame_time);
-
-  kb_encoder_pool& current_pool = current_encoder_pool();
-
-  stats_cache.platform_frametime      = platform_frame_time;
-  stats_cache.platform_frametime_avg  = platform_frametime_sampler.avg();
-  stats_cache.platform_frametime_min  = platform_frametime_sampler.min();
-  stats_cache.platform_frametime_max  = platform_frametime_sampler.max();
-  
-  // Update stats
-  stats_cache.buffer_count            = kb_buffer_count();
-  stats_cache.texture_count           = kb_texture_count();
-  stats_cache.encoders_used           = current_pool.count;
-  stats_cache.encoders_allocated      = KB_CONFIG_MAX_ENCODERS;
-  stats_cache.frametime_avg           = frametime_sampler.avg();
-  stats_cache.frametime_min           = frametime_sampler.min();
-  stats_cache.frametime_max           = frametime_sampler.max();
-  stats_cache.draw_calls_allocated    = KB_CONFIG_MAX_DRAW_CALLS;
-  stats_cache.compute_calls_allocated = KB_CONFIG_MAX_DRAW_CALLS;
-  
-  // Reset pools
-  for (int i = 0; i < current_pool.count; ++i) {
-    reset_encoder_state(current_pool.states[i]);
-  }
-  current_pool.count = 0;
-  
   acquire_frame_resources();
+  end_frame_timing();
+}
 
-  int64_t ctime = kb_current_time();
-  int64_t frametime_diff = ctime - frame_timestamp;
-  frame_timestamp = ctime;
-  
-  double frametime = (double) frametime_diff / (double) kb_time_get_frequency();
-  
-  frametime_sampler.push(frametime);
-  stats_cache.frametime = frametime;
+KB_API void kb_graphics_flush() {
+  if (render_thread == NULL) return;
+
+  // Park the render thread without handing it a new frame
+  kb_counting_semaphore_wait(&render_idle);
+  current_extent = render_extent;
+  kb_counting_semaphore_post(&render_idle, 1);
 }
 
 KB_API kb_texture kb_graphics_pipe_attachment_texture(uint32_t attachment) {
@@ -477,8 +752,11 @@ KB_API void kb_graphics_pipe_destruct(kb_graphics_pipe handle) {
 KB_API void kb_pipeline_construct(kb_pipeline handle, const kb_pipeline_create_info info) {
   KB_ASSERT_VALID(handle);
   
-  pipeline_info_ref(handle)->uniform_layout = info.uniform_layout;
-  pipeline_info_ref(handle)->pass           = info.pass;
+  pipeline_info* ref = pipeline_info_ref_create(handle);
+  ref->uniform_layout = info.uniform_layout;
+
+  pipeline_pass_table* passes = grow_pipeline_passes(kb_pipeline_capacity());
+  passes->passes[kb_to_arr(handle)] = info.pass;
 
   kb_platform_graphics_pipeline_construct(handle, info);
   kb_pipeline_set_initialized(handle, true);
@@ -574,9 +852,14 @@ KB_API kb_uniform_slot kb_uniform_get_slot(const kb_uniform_layout* layout, kb_h
 KB_API kb_encoder kb_encoder_begin() {
   kb_encoder_pool& pool = current_encoder_pool();
 
-  uint32_t slot = pool.count++;
+  uint32_t slot = kb_atomic_fetch_add_u32(&pool.count, 1);
+  KB_ASSERT(slot < KB_CONFIG_MAX_ENCODERS, "Too many encoders (KB_CONFIG_MAX_ENCODERS)");
+
+  // Past the limit the encoder is invalid and everything recorded into it is
+  // dropped, the pool count is clamped wherever it's read
+  if (slot >= KB_CONFIG_MAX_ENCODERS) return kb_encoder {};
+
   kb_encoder encoder = KB_HANDLE_FROM_ARRAY(slot);
-  kb_encoder_state& state = current_encoder_state(encoder);
   
   kb_encoder_reset_frame(encoder);
 
@@ -585,16 +868,19 @@ KB_API kb_encoder kb_encoder_begin() {
 
 KB_API void kb_encoder_reset_frame(kb_encoder encoder) {
   KB_ASSERT_VALID(encoder);
+  if (!KB_IS_VALID(encoder)) return;
 
   current_encoder_frame(encoder) = {};
 }
 
 KB_API void kb_encoder_end(kb_encoder encoder) {
   KB_ASSERT_VALID(encoder);
+  if (!KB_IS_VALID(encoder)) return;
 }
 
 KB_API void kb_encoder_push(kb_encoder encoder) { 
   KB_ASSERT_VALID(encoder);
+  if (!KB_IS_VALID(encoder)) return;
 
   kb_encoder_state& state = current_encoder_state(encoder);
   KB_ASSERT(state.stack_pos < KB_COUNTOF(state.stack), "Encoder stack overflow!");
@@ -605,6 +891,7 @@ KB_API void kb_encoder_push(kb_encoder encoder) {
 
 KB_API void kb_encoder_pop(kb_encoder encoder) {
   KB_ASSERT_VALID(encoder);
+  if (!KB_IS_VALID(encoder)) return;
 
   kb_encoder_state& state = current_encoder_state(encoder);
   KB_ASSERT(state.stack_pos > 0, "Can't pop when stack at 0");
@@ -614,13 +901,17 @@ KB_API void kb_encoder_pop(kb_encoder encoder) {
 
 KB_API void kb_encoder_bind_pipeline(kb_encoder encoder, kb_pipeline pipeline) {
   KB_ASSERT_VALID(encoder);
+  if (!KB_IS_VALID(encoder)) return;
   KB_ASSERT_VALID(pipeline);
 
-  current_encoder_frame(encoder).pipeline = pipeline;
+  kb_encoder_frame& frame = current_encoder_frame(encoder);
+  frame.pipeline  = pipeline;
+  frame.pass      = ((pipeline_pass_table*) kb_atomic_load_acquire_ptr(&pipeline_passes))->passes[kb_to_arr(pipeline)];
 }
 
 KB_API void kb_encoder_bind_vertex_buffer(kb_encoder encoder, uint32_t slot, kb_buffer_memory memory) {
   KB_ASSERT_VALID(encoder);
+  if (!KB_IS_VALID(encoder)) return;
   KB_ASSERT_VALID(memory.buffer);
 
   current_encoder_frame(encoder).vertex_buffer_bindings[slot].memory = memory;
@@ -628,6 +919,7 @@ KB_API void kb_encoder_bind_vertex_buffer(kb_encoder encoder, uint32_t slot, kb_
 
 KB_API void kb_encoder_bind_index_buffer(kb_encoder encoder, kb_index_type type, kb_buffer_memory memory) {
   KB_ASSERT_VALID(encoder);
+  if (!KB_IS_VALID(encoder)) return;
   KB_ASSERT_VALID(memory.buffer);
 
   current_encoder_frame(encoder).index_buffer.memory      = memory;
@@ -636,56 +928,68 @@ KB_API void kb_encoder_bind_index_buffer(kb_encoder encoder, kb_index_type type,
 
 KB_API void kb_encoder_bind_texture(kb_encoder encoder, const kb_uniform_slot slot, kb_texture texture) {
   KB_ASSERT_VALID(encoder);
+  if (!KB_IS_VALID(encoder)) return;
   KB_ASSERT_VALID(texture);
 
   KB_ASSERT(slot.vertex_slot    < KB_CONFIG_MAX_UNIFORM_BINDINGS, "Vertex slot index too large");
   KB_ASSERT(slot.fragment_slot  < KB_CONFIG_MAX_UNIFORM_BINDINGS, "Fragment slot index too large");
   KB_ASSERT(slot.compute_slot   < KB_CONFIG_MAX_UNIFORM_BINDINGS, "Compute slot index too large");
 
+  kb_encoder_state& state = current_encoder_state(encoder);
+  state.texture_binding_count++;
+
   if (slot.stage & KB_SHADER_STAGE_VERTEX) {
-    kb_texture_binding& binding = current_encoder_frame(current_encoder_state(encoder)).vertex_texture_bindings[slot.vertex_slot];
+    kb_texture_binding& binding = current_encoder_frame(state).vertex_texture_bindings[slot.vertex_slot];
     binding.texture  = texture;
   }
   
   if (slot.stage & KB_SHADER_STAGE_FRAGMENT) {
-    kb_texture_binding& binding = current_encoder_frame(current_encoder_state(encoder)).fragment_texture_bindings[slot.fragment_slot]; 
+    kb_texture_binding& binding = current_encoder_frame(state).fragment_texture_bindings[slot.fragment_slot]; 
     binding.texture  = texture;
   }
 
   if (slot.stage & KB_SHADER_STAGE_COMPUTE) {
-    kb_texture_binding& binding = current_encoder_frame(current_encoder_state(encoder)).compute_texture_bindings[slot.compute_slot]; 
+    kb_texture_binding& binding = current_encoder_frame(state).compute_texture_bindings[slot.compute_slot]; 
     binding.texture  = texture;
   }
 }
 
 KB_API void kb_encoder_bind_uniform(kb_encoder encoder, const kb_uniform_slot slot, kb_buffer_memory memory) {
   KB_ASSERT_VALID(encoder);
+  if (!KB_IS_VALID(encoder)) return;
   KB_ASSERT_VALID(memory.buffer);
 
+  kb_encoder_state& state = current_encoder_state(encoder);
+  state.uniform_binding_count++;
+
   if (slot.stage & KB_SHADER_STAGE_VERTEX) {
-    kb_uniform_binding* binding = &current_encoder_frame(current_encoder_state(encoder)).vertex_uniform_bindings[slot.vertex_slot];
+    kb_uniform_binding* binding = &current_encoder_frame(state).vertex_uniform_bindings[slot.vertex_slot];
     binding->memory = memory;
   }
   
   if (slot.stage & KB_SHADER_STAGE_FRAGMENT) {
-    kb_uniform_binding* binding = &current_encoder_frame(current_encoder_state(encoder)).fragment_uniform_bindings[slot.fragment_slot]; 
+    kb_uniform_binding* binding = &current_encoder_frame(state).fragment_uniform_bindings[slot.fragment_slot]; 
     binding->memory = memory;
   }
   
   if (slot.stage & KB_SHADER_STAGE_COMPUTE) {
-    kb_uniform_binding* binding = &current_encoder_frame(current_encoder_state(encoder)).compute_uniform_bindings[slot.compute_slot]; 
+    kb_uniform_binding* binding = &current_encoder_frame(state).compute_uniform_bindings[slot.compute_slot]; 
     binding->memory = memory;
   }
 }
 
 KB_API void kb_encoder_submit_compute(kb_encoder encoder, kb_int3 group_size, kb_int3 groups) {
   KB_ASSERT_VALID(encoder);
+  if (!KB_IS_VALID(encoder)) return;
+  KB_PROFILE_SCOPE("kb_encoder_submit_compute");
   
   kb_encoder_state& state = current_encoder_state(encoder);
   kb_encoder_frame& frame = current_encoder_frame(encoder);
 
   KB_ASSERT_VALID(frame.pipeline);
 
+  KB_ASSERT(state.compute_call_count < max_draw_calls, "Too many compute calls (kb_graphics_capacity_info.draw_calls)");
+
   kb_compute_call& call = state.compute_calls[state.compute_call_count++];
 
   for (uint32_t binding = 0; binding < KB_CONFIG_MAX_UNIFORM_BINDINGS; ++binding) {
@@ -694,19 +998,22 @@ KB_API void kb_encoder_submit_compute(kb_encoder encoder, kb_int3 group_size, kb
   }
   
   call.pipeline   = frame.pipeline;
+  call.pass       = frame.pass;
   call.group_size = group_size;
   call.groups     = groups;
 }
 
 KB_API void kb_encoder_submit_draw(kb_encoder encoder, uint32_t first_index, uint32_t first_vertex, uint32_t index_count, uint32_t instance_count) {
   KB_ASSERT_VALID(encoder);
+  if (!KB_IS_VALID(encoder)) return;
+  KB_PROFILE_SCOPE("kb_encoder_submit_draw");
 
   kb_encoder_state& state = current_encoder_state(encoder);
   kb_encoder_frame& frame = current_encoder_frame(encoder);
 
   KB_ASSERT_VALID(frame.pipeline);
 
-  KB_ASSERT(state.draw_call_count < KB_CONFIG_MAX_DRAW_CALLS, "Too many draw calls (KB_CONFIG_MAX_DRAW_CALLS)");
+  KB_ASSERT(state.draw_call_count < max_draw_calls, "Too many draw calls (kb_graphics_capacity_info.draw_calls)");
   
   kb_render_call& call = state.draw_calls[state.draw_call_count++];
   
@@ -722,6 +1029,7 @@ KB_API void kb_encoder_submit_draw(kb_encoder encoder, uint32_t first_index, uin
   }
 
   call.pipeline        = frame.pipeline;
+  call.pass            = frame.pass;
   call.index_buffer    = frame.index_buffer;
   call.first_vertex    = first_vertex;
   call.first_index     = first_index;
@@ -747,3 +1055,38 @@ KB_API float kb_graphics_get_aspect() {
 KB_API void kb_graphics_get_stats(kb_graphics_stats* dst) {
   *dst = stats_cache;
 }
+
+KB_API void kb_graphics_write_stats_csv(kb_stream* dst) {
+  char line[256];
+  uint32_t pass_count = graphics_pipe != NULL ? graphics_pipe->pass_count : 0;
+
+  int32_t len = kb_snprintf(line, sizeof(line), "frametime,platform_frametime,run_encoders_time,encoders_used,draw_calls,compute_calls,"
+                                                "transient_used,transient_high_water,upload_bytes,uniform_bindings,texture_bindings");
+  kb_stream_write(dst, line, len, 1);
+
+  for (uint32_t pass_i = 0; pass_i < pass_count; ++pass_i) {
+    len = kb_snprintf(line, sizeof(line), ",pass%u_draw_calls,pass%u_compute_calls,pass%u_sort_time,pass%u_submit_time", pass_i, pass_i, pass_i, pass_i);
+    kb_stream_write(dst, line, len, 1);
+  }
+  kb_stream_write(dst, "\n", 1, 1);
+
+  // Oldest frame first
+  uint32_t first = (stats_history_pos + KB_CONFIG_STATS_SAMPLE_COUNT - stats_history_count) % KB_CONFIG_STATS_SAMPLE_COUNT;
+
+  for (uint32_t i = 0; i < stats_history_count; ++i) {
+    const kb_graphics_stats& stats = stats_history[(first + i) % KB_CONFIG_STATS_SAMPLE_COUNT];
+
+    len = kb_snprintf(line, sizeof(line), "%f,%f,%f,%u,%u,%u,%u,%u,%llu,%u,%u",
+      stats.frametime, stats.platform_frametime, stats.run_encoders_time, stats.encoders_used,
+      stats.draw_calls_used, stats.compute_calls_used, stats.transient_used, stats.transient_high_water,
+      (unsigned long long) stats.upload_bytes, stats.uniform_bindings, stats.texture_bindings);
+    kb_stream_write(dst, line, len, 1);
+
+    for (uint32_t pass_i = 0; pass_i < pass_count; ++pass_i) {
+      const kb_graphics_pass_stats& pass = stats.passes[pass_i];
+      len = kb_snprintf(line, sizeof(line), ",%u,%u,%f,%f", pass.draw_calls, pass.compute_calls, pass.sort_time, pass.submit_time);
+      kb_stream_write(dst, line, len, 1);
+    }
+    kb_stream_write(dst, "\n", 1, 1);
+  }
+}
@@ -7,8 +7,13 @@
 #include <kb/log.h>
 
 #include <kb/foundation/crt.h>
+#include <kb/foundation/profile.h>
+#include <kb/foundation/sync.h>
 #include <kb/foundation/thread.h>
 
+#include <sched.h>
+#include <stdio.h>
+
 auto get_level_str(kb_log_level level) -> const char* {
   switch (level) {
     case KB_LOG_LEVEL_TRACE     : return "trace";
@@ -33,14 +38,40 @@ auto get_level_color(kb_log_level level) -> const char* {
   }
 }
 
+#define KB_LOG_RING_SIZE      1024
+#define KB_LOG_RING_MASK      (KB_LOG_RING_SIZE - 1)
+#define KB_LOG_RECORD_SIZE    512
+#define KB_LOG_BATCH_SIZE     (64 * 1024)
+#define KB_LOG_HEADER_SIZE    32
+
+// One fixed size slot in the ring. Messages longer than the slot are cut.
+typedef struct log_record {
+  kb_atomic_u32     sequence;
+  kb_log_level      level;
+  uint32_t          length;
+  char              text[KB_LOG_RECORD_SIZE - 3 * sizeof(uint32_t)];
+} log_record;
+
 static kb_log_level log_level   = kb_log_level::KB_LOG_LEVEL_TRACE;
 static bool         log_color   = false;
 static bool         log_header  = false;
-static kb_mutex*    log_mutex   = NULL;
+static kb_lock      log_mutex   = {};
 
-inline void print(const char* str) {
-  kb_printf("%s", str);
-}
+// Async backend. Producers claim slots in a bounded MPMC ring, the flush
+// thread is the only consumer.
+static log_record     log_ring[KB_LOG_RING_SIZE];
+static kb_atomic_u32  log_enqueue_pos;
+static uint32_t       log_dequeue_pos;
+static kb_atomic_u32  log_written;
+static kb_atomic_u32  log_flush_waiters;
+static kb_atomic_u32  log_sleeping;
+static kb_atomic_u32  log_quit;
+static kb_atomic_u64  log_dropped;
+static uint64_t       log_dropped_reported;
+static kb_atomic_u32  log_async;      // Producers enqueue while set
+static kb_atomic_u32  log_producers;  // Producers between checking log_async and publishing
+static kb_thread*     log_thread  = NULL;
+static char           log_batch[KB_LOG_BATCH_SIZE];
 
 void kb_log_set_color(bool enabled) {
   log_color = enabled;
@@ -54,30 +85,227 @@ void kb_log_set_level(kb_log_level level) {
   log_level = level;
 };
 
-void kb_log_line(kb_log_level level, const char* msg) {
-  if (level >= log_level) {
-    if (log_mutex) kb_mutex_lock(log_mutex);
-    
-    {
-      if (log_header) {
-        if (log_color) {
-          print("\e[");
-          print(get_level_color(level));
-          print("m");
-        }
-        
-        print("[");
-        print(get_level_str(level));
-        print("] ");
-        
-        if (log_color) print("\e[0;37m");
-        if (log_color) print("\e[0;39m");
-      }
-
-      print(msg);
-      print("\n");
+bool kb_log_enabled(kb_log_level level) {
+  return level >= log_level;
+}
+
+KB_INTERNAL uint32_t format_header(char* dst, kb_log_level level) {
+  if (!log_header) return 0;
+
+  if (log_color) {
+    return kb_snprintf(dst, KB_LOG_HEADER_SIZE, "\e[%sm[%s] \e[0;37m\e[0;39m", get_level_color(level), get_level_str(level));
+  }
+
+  return kb_snprintf(dst, KB_LOG_HEADER_SIZE, "[%s] ", get_level_str(level));
+}
+
+KB_INTERNAL void write_line(kb_log_level level, const char* msg, uint64_t length) {
+  char header[KB_LOG_HEADER_SIZE];
+  uint32_t header_length = format_header(header, level);
+
+  kb_lock_lock(&log_mutex);
+  fwrite(header, 1, header_length, stdout);
+  fwrite(msg, 1, length, stdout);
+  fputc('\n', stdout);
+  kb_lock_unlock(&log_mutex);
+}
+
+KB_INTERNAL void wake_flusher() {
+  if (kb_atomic_load_u32(&log_sleeping) && kb_atomic_exchange_u32(&log_sleeping, 0)) {
+    kb_futex_wake(&log_sleeping, 1);
+  }
+}
+
+KB_INTERNAL bool try_enqueue(kb_log_level level, const char* msg, uint64_t length) {
+  uint32_t pos = kb_atomic_load_relaxed_u32(&log_enqueue_pos);
+  log_record* record;
+
+  while (true) {
+    record = &log_ring[pos & KB_LOG_RING_MASK];
+    int32_t diff = (int32_t) (kb_atomic_load_acquire_u32(&record->sequence) - pos);
+
+    if (diff == 0) {
+      if (kb_atomic_cas_u32(&log_enqueue_pos, &pos, pos + 1)) break;
+    } else if (diff < 0) {
+      return false; // Full
+    } else {
+      pos = kb_atomic_load_relaxed_u32(&log_enqueue_pos);
     }
-    
-    if (log_mutex) kb_mutex_unlock(log_mutex);
+  }
+
+  if (length > sizeof(record->text)) length = sizeof(record->text);
+
+  record->level   = level;
+  record->length  = (uint32_t) length;
+  kb_memcpy(record->text, msg, length);
+
+  kb_atomic_store_u32(&record->sequence, pos + 1);
+  return true;
+}
+
+KB_INTERNAL void enqueue_line(kb_log_level level, const char* msg, uint64_t length) {
+  while (!try_enqueue(level, msg, length)) {
+    // Bounded drop: chatter is discarded when the ring is full, errors wait
+    if (level < KB_LOG_LEVEL_ERROR) {
+      kb_atomic_fetch_add_u64(&log_dropped, 1);
+      break;
+    }
+
+    wake_flusher();
+    sched_yield();
+  }
+
+  wake_flusher();
+}
+
+KB_INTERNAL bool ring_has_data() {
+  const log_record& record = log_ring[log_dequeue_pos & KB_LOG_RING_MASK];
+  return kb_atomic_load_u32(&record.sequence) == log_dequeue_pos + 1;
+}
+
+// Formats everything published so far into large writes. Returns the number
+// of records written.
+KB_INTERNAL uint32_t drain_ring() {
+  uint32_t  count     = 0;
+  uint64_t  batch_pos = 0;
+
+  while (ring_has_data()) {
+    log_record& record = log_ring[log_dequeue_pos & KB_LOG_RING_MASK];
+
+    if (batch_pos + KB_LOG_HEADER_SIZE + record.length + 1 > KB_LOG_BATCH_SIZE) {
+      kb_lock_lock(&log_mutex);
+      fwrite(log_batch, 1, batch_pos, stdout);
+      kb_lock_unlock(&log_mutex);
+      batch_pos = 0;
+    }
+
+    batch_pos += format_header(log_batch + batch_pos, record.level);
+    kb_memcpy(log_batch + batch_pos, record.text, record.length);
+    batch_pos += record.length;
+    log_batch[batch_pos++] = '\n';
+
+    kb_atomic_store_release_u32(&record.sequence, log_dequeue_pos + KB_LOG_RING_SIZE);
+    ++log_dequeue_pos;
+    ++count;
+  }
+
+  if (count == 0) return 0;
+
+  kb_lock_lock(&log_mutex);
+  fwrite(log_batch, 1, batch_pos, stdout);
+
+  uint64_t dropped = kb_atomic_load_u64(&log_dropped);
+  if (dropped > log_dropped_reported) {
+    fprintf(stdout, "[log] %llu messages dropped\n", (unsigned long long) (dropped - log_dropped_reported));
+    log_dropped_reported = dropped;
+  }
+
+  fflush(stdout);
+  kb_lock_unlock(&log_mutex);
+
+  kb_atomic_store_u32(&log_written, log_dequeue_pos);
+  if (kb_atomic_load_u32(&log_flush_waiters) > 0) {
+    kb_futex_wake_all(&log_written);
+  }
+
+  return count;
+}
+
+KB_INTERNAL void* log_thread_main(void* userdata) {
+  KB_PROFILE_THREAD_NAME("kb log");
+
+  while (true) {
+    if (drain_ring() > 0) continue;
+    if (kb_atomic_load_u32(&log_quit)) break;
+
+    // Producers only pay for a wake when we are actually about to sleep
+    kb_atomic_store_u32(&log_sleeping, 1);
+
+    if (ring_has_data() || kb_atomic_load_u32(&log_quit)) {
+      kb_atomic_store_u32(&log_sleeping, 0);
+      continue;
+    }
+
+    kb_futex_wait(&log_sleeping, 1);
+  }
+
+  return NULL;
+}
+
+void kb_log_set_async(bool enabled) {
+  if (enabled == (log_thread != NULL)) return;
+
+  if (enabled) {
+    for (uint32_t i = 0; i < KB_LOG_RING_SIZE; ++i) {
+      kb_atomic_store_u32(&log_ring[i].sequence, i);
+    }
+
+    kb_atomic_store_u32(&log_enqueue_pos, 0);
+    kb_atomic_store_u32(&log_written, 0);
+    kb_atomic_store_u32(&log_quit, 0);
+    log_dequeue_pos = 0;
+
+    log_thread = kb_thread_create(log_thread_main, NULL);
+    kb_atomic_store_u32(&log_async, 1);
+  } else {
+    // New lines go straight to stdout, wait out the ones already on their way
+    // into the ring so the thread drains them before it quits
+    kb_atomic_store_u32(&log_async, 0);
+    while (kb_atomic_load_u32(&log_producers) > 0) {
+      sched_yield();
+    }
+
+    kb_atomic_store_u32(&log_quit, 1);
+    kb_atomic_store_u32(&log_sleeping, 0);
+    kb_futex_wake(&log_sleeping, 1);
+
+    kb_thread_join(log_thread);
+    kb_thread_destroy(log_thread);
+    log_thread = NULL;
+  }
+}
+
+void kb_log_flush() {
+  if (!kb_atomic_load_u32(&log_async)) {
+    kb_lock_lock(&log_mutex);
+    fflush(stdout);
+    kb_lock_unlock(&log_mutex);
+    return;
+  }
+
+  const uint32_t target = kb_atomic_load_u32(&log_enqueue_pos);
+
+  kb_atomic_fetch_add_u32(&log_flush_waiters, 1);
+
+  while (true) {
+    uint32_t written = kb_atomic_load_u32(&log_written);
+    if ((int32_t) (written - target) >= 0) break;
+
+    wake_flusher();
+    kb_futex_wait(&log_written, written);
+  }
+
+  kb_atomic_fetch_sub_u32(&log_flush_waiters, 1);
+}
+
+uint64_t kb_log_dropped() {
+  return kb_atomic_load_u64(&log_dropped);
+}
+
+void kb_log_line(kb_log_level level, const char* msg) {
+  if (level < log_level) return;
+
+  uint64_t length = kb_strlen(msg);
+
+  kb_atomic_fetch_add_u32(&log_producers, 1);
+
+  if (kb_atomic_load_u32(&log_async)) {
+    enqueue_line(level, msg, length);
+    kb_atomic_fetch_sub_u32(&log_producers, 1);
+
+    if (level == KB_LOG_LEVEL_FATAL) kb_log_flush();
+  } else {
+    kb_atomic_fetch_sub_u32(&log_producers, 1);
+    write_line(level, msg, length);
   }
 }
@@ -125,6 +125,10 @@ KB_API uint32_t kb_from_utf8(kb_wchar* dst, const char* src, uint32_t len) {
 KB_API void kb_font_data_read(kb_font_data* font, kb_stream* rwops) {
   KB_ASSERT_NOT_NULL(font);
   KB_ASSERT_NOT_NULL(rwops);
+  KB_PROFILE_SCOPE("kb_font_data_read");
+
+  static kb::counter fonts_read("font.reads");
+  fonts_read.add();
 
   if (!kb_stream_check_magic(rwops, KB_CONFIG_FILE_MAGIC_FONT)) {
     kb_printf("Did not find correct magic number!\n");
@@ -321,12 +325,13 @@ struct kb_font_ref {
   kb_uniform_slot atlas_slot;
 };
 
-KB_RESOURCE_STORAGE_DEF       (font, kb_font, kb_font_ref, KB_CONFIG_MAX_FONTS);
+KB_RESOURCE_STORAGE_DEF       (font, kb_font, kb_font_ref);
 KB_RESOURCE_ALLOC_FUNC_DEF    (font, kb_font, kb_font_create_info, KB_CONFIG_MAX_FONTS);
 KB_RESOURCE_DATA_HASHED_DEF   (font, kb_font);
 
 void kb_font_construct(kb_font handle, const kb_font_create_info info) {
   kb_font_data font_data;
+  font_ref_create(handle);
   
   kb_font_data_read(&font_data, info.data);
   kb_stream* texture_data = kb_stream_open_mem(font_data.atlas_bitmap, font_data.atlas_bitmap_size);
@@ -339,7 +344,6 @@ void kb_font_construct(kb_font handle, const kb_font_create_info info) {
   font_ref(handle)->atlas_slot    = info.atlas_slot;
   font_ref(handle)->atlas_texture = kb_texture_create({
     .rwops    = texture_data,
-    .usage    = KB_TEXTURE_USAGE_SHADER_READ,
     .texture  = {
       .width  = font_data.atlas_bitmap_width,
       .height = font_data.atlas_bitmap_height,
@@ -353,7 +357,8 @@ void kb_font_construct(kb_font handle, const kb_font_create_info info) {
       .address_mode_w = KB_SAMPLER_ADDRESS_MODE_REPEAT,
       .anisotropy     = 16.0f,
     },
-    .mipmaps = false,
+    .usage    = KB_TEXTURE_USAGE_SHADER_READ,
+    .mipmaps  = false,
   });
 }
 
@@ -8,6 +8,7 @@
 
 #include <kb/foundation.h>
 #include <kb/graphics.h>
+#include <kb/log.h>
 
 void kb_geometry_data_dump_info(const kb_geometry_data* geom) {
   KB_ASSERT_NOT_NULL(geom);
@@ -45,6 +46,10 @@ void kb_geometry_data_dump_info(const kb_geometry_data* geom) {
 void kb_geometry_data_read(kb_geometry_data* geom, kb_stream* rwops) {
   KB_ASSERT_NOT_NULL(geom);
   KB_ASSERT_NOT_NULL(rwops);
+  KB_PROFILE_SCOPE("kb_geometry_data_read");
+
+  static kb::counter geometry_read("geometry.reads");
+  geometry_read.add();
 
   if (!kb_stream_check_magic(rwops, KB_CONFIG_FILE_MAGIC_GEOM)) {
     kb::log_debug("Did not find correct magic number!");
@@ -192,16 +197,17 @@ struct kb_geometry_ref {
   uint32_t            mesh_count;
 };
 
-KB_RESOURCE_STORAGE_DEF     (mesh, kb_mesh, kb_mesh_ref, KB_CONFIG_MAX_MESHES);
+KB_RESOURCE_STORAGE_DEF     (mesh, kb_mesh, kb_mesh_ref);
 KB_RESOURCE_ALLOC_FUNC_DEF  (mesh, kb_mesh, kb_mesh_create_info, KB_CONFIG_MAX_MESHES);
 KB_RESOURCE_DATA_HASHED_DEF (mesh, kb_mesh);
 
-KB_RESOURCE_STORAGE_DEF     (geometry, kb_geometry, kb_geometry_ref, KB_CONFIG_MAX_GEOMS);
+KB_RESOURCE_STORAGE_DEF     (geometry, kb_geometry, kb_geometry_ref);
 KB_RESOURCE_ALLOC_FUNC_DEF  (geometry, kb_geometry, kb_geometry_create_info, KB_CONFIG_MAX_GEOMS);
 KB_RESOURCE_DATA_HASHED_DEF (geometry, kb_geometry);
 
 void kb_mesh_construct(kb_mesh handle, const kb_mesh_create_info info) {
   KB_ASSERT_VALID(handle);
+  mesh_ref_create(handle);
 
   mesh_ref(handle)->vertex_memory  = info.vertex_memory;
   mesh_ref(handle)->index_memory   = info.index_memory;
@@ -233,6 +239,7 @@ void kb_mesh_destruct(kb_mesh handle) {
 
 void kb_geometry_construct(kb_geometry handle, const kb_geometry_create_info info) {
   KB_ASSERT_VALID(handle);
+  geometry_ref_create(handle);
   
   kb_geometry_data geom {};
   
@@ -272,8 +279,8 @@ void kb_geometry_construct(kb_geometry handle, const kb_geometry_create_info inf
   
   for (uint32_t i = 0; i < geom.mesh_count; i++) {
     geometry_ref(handle)->meshes[i] = kb_mesh_create({
-      .index_memory     = geometry_ref(handle)->index_memory,
       .vertex_memory    = geometry_ref(handle)->vertex_memory,
+      .index_memory     = geometry_ref(handle)->index_memory,
       .primitive_count  = geom.meshes[i].primitive_count,
       .primitives       = geom.meshes[i].primitives,
       .material_count   = geom.material_count,
@@ -23,12 +23,12 @@ struct kb_material_ref {
   kb_material_texture       textures[KB_CONFIG_MAX_UNIFORM_BINDINGS];
 };
 
-KB_RESOURCE_STORAGE_DEF     (material, kb_material, kb_material_ref, KB_CONFIG_MAX_MATERIALS);
+KB_RESOURCE_STORAGE_DEF     (material, kb_material, kb_material_ref);
 KB_RESOURCE_ALLOC_FUNC_DEF  (material, kb_material, kb_material_create_info, KB_CONFIG_MAX_MATERIALS);
 KB_RESOURCE_DATA_HASHED_DEF (material, kb_material);
 
 void kb_material_construct(kb_material handle, const kb_material_create_info info) {  
-  kb_material_ref* ref = material_ref(handle);
+  kb_material_ref* ref = material_ref_create(handle);
 
   ref->pipeline = info.pipeline;
     
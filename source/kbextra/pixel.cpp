@@ -0,0 +1,683 @@
+// ============================================================================
+//  Kimberlite
+//
+//  Copyright 2020 Toni Pesola. All Rights Reserved.
+// ============================================================================
+
+#include <kbextra/pixel.h>
+
+#include <kb/foundation/crt.h>
+
+#include <math.h>
+
+#if KB_SIMD_SSE2
+  #include <emmintrin.h>
+  #if defined(__SSSE3__) || KB_COMPILER_GCC || KB_COMPILER_CLANG
+    #include <tmmintrin.h>
+    #define KB_PIXEL_SSSE3 1
+  #endif
+#elif KB_SIMD_NEON
+  #include <arm_neon.h>
+#endif
+
+#ifndef KB_PIXEL_SSSE3
+  #define KB_PIXEL_SSSE3 0
+#endif
+
+// Byte shuffles need SSSE3, which baseline x86-64 doesn't have. Without
+// -mssse3 the shuffle kernels are compiled for it anyway and picked at runtime.
+#if KB_PIXEL_SSSE3 && !defined(__SSSE3__)
+  #include <cpuid.h>
+  #define KB_PIXEL_SSSE3_TARGET __attribute__((target("ssse3")))
+#else
+  #define KB_PIXEL_SSSE3_TARGET
+#endif
+
+#define LINEAR_TO_SRGB_LUT_SIZE 4096
+
+typedef struct srgb_luts {
+  float   to_linear [256];
+  uint8_t to_srgb   [LINEAR_TO_SRGB_LUT_SIZE];
+} srgb_luts;
+
+KB_INTERNAL inline float srgb_decode(float c) {
+  return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+KB_INTERNAL inline float srgb_encode(float c) {
+  return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+}
+
+KB_INTERNAL inline float saturate(float f) {
+  return f < 0.0f ? 0.0f : (f > 1.0f ? 1.0f : f);
+}
+
+KB_INTERNAL inline uint8_t to_unorm8(float f) {
+  return (uint8_t) (saturate(f) * 255.0f + 0.5f);
+}
+
+KB_INTERNAL inline uint8_t mul_unorm8(uint32_t a, uint32_t b) {
+  uint32_t t = a * b + 128;
+  return (uint8_t) ((t + (t >> 8)) >> 8);
+}
+
+KB_INTERNAL inline void store_u32(uint8_t* dst, uint32_t value) {
+  kb_memcpy(dst, &value, sizeof(uint32_t));
+}
+
+KB_INTERNAL const srgb_luts& get_srgb_luts() {
+  static const srgb_luts luts = [] {
+    srgb_luts l;
+
+    for (uint32_t i = 0; i < 256; ++i) {
+      l.to_linear[i] = srgb_decode(float(i) / 255.0f);
+    }
+
+    for (uint32_t i = 0; i < LINEAR_TO_SRGB_LUT_SIZE; ++i) {
+      l.to_srgb[i] = to_unorm8(srgb_encode(float(i) / float(LINEAR_TO_SRGB_LUT_SIZE - 1)));
+    }
+
+    return l;
+  }();
+
+  return luts;
+}
+
+KB_INTERNAL bool has_ssse3() {
+#if KB_PIXEL_SSSE3 && defined(__SSSE3__)
+  return true;
+#elif KB_PIXEL_SSSE3
+  static const bool supported = [] {
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSSE3) != 0;
+  }();
+
+  return supported;
+#else
+  return false;
+#endif
+}
+
+#if KB_PIXEL_SSSE3
+
+// SSSE3 kernels process whole blocks and return how many pixels they did,
+// the callers finish the tail
+
+KB_PIXEL_SSSE3_TARGET KB_INTERNAL uint64_t swizzle_ssse3(uint8_t* dst, const uint8_t* src, uint64_t count, const uint8_t swizzle[4]) {
+  const __m128i shuffle = _mm_setr_epi8(
+     0 + swizzle[0],  0 + swizzle[1],  0 + swizzle[2],  0 + swizzle[3],
+     4 + swizzle[0],  4 + swizzle[1],  4 + swizzle[2],  4 + swizzle[3],
+     8 + swizzle[0],  8 + swizzle[1],  8 + swizzle[2],  8 + swizzle[3],
+    12 + swizzle[0], 12 + swizzle[1], 12 + swizzle[2], 12 + swizzle[3]
+  );
+
+  uint64_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    __m128i x = _mm_loadu_si128((const __m128i*) (src + i * 4));
+    _mm_storeu_si128((__m128i*) (dst + i * 4), _mm_shuffle_epi8(x, shuffle));
+  }
+
+  return i;
+}
+
+KB_PIXEL_SSSE3_TARGET KB_INTERNAL uint64_t expand_rgb_ssse3(uint8_t* dst, const uint8_t* src, uint64_t count) {
+  const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m128i alpha   = _mm_set1_epi32((int) 0xFF000000u);
+
+  uint64_t i = 0;
+
+  // Each load reads 16 bytes but consumes 12, stop while a full load is still in bounds
+  for (; i + 6 <= count; i += 4) {
+    __m128i x = _mm_loadu_si128((const __m128i*) (src + i * 3));
+    _mm_storeu_si128((__m128i*) (dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(x, shuffle), alpha));
+  }
+
+  return i;
+}
+
+KB_PIXEL_SSSE3_TARGET KB_INTERNAL uint64_t reduce_rgb_ssse3(uint8_t* dst, const uint8_t* src, uint64_t count) {
+  const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+  uint64_t i = 0;
+
+  // Each store writes 16 bytes but produces 12, stop while a full store is still in bounds
+  for (; i + 6 <= count; i += 4) {
+    __m128i x = _mm_loadu_si128((const __m128i*) (src + i * 4));
+    _mm_storeu_si128((__m128i*) (dst + i * 3), _mm_shuffle_epi8(x, shuffle));
+  }
+
+  return i;
+}
+
+#endif
+
+// Widens 8-bit values to 32-bit pixels as (value << shift) | fill
+KB_INTERNAL void expand_r8(uint8_t* dst, const uint8_t* src, uint64_t count, uint32_t shift, uint32_t fill) {
+  uint64_t i = 0;
+
+#if KB_SIMD_SSE2
+  const __m128i zero  = _mm_setzero_si128();
+  const __m128i or_v  = _mm_set1_epi32((int) fill);
+  const __m128i sh    = _mm_cvtsi32_si128((int) shift);
+
+  for (; i + 16 <= count; i += 16) {
+    __m128i x  = _mm_loadu_si128((const __m128i*) (src + i));
+    __m128i lo = _mm_unpacklo_epi8(x, zero);
+    __m128i hi = _mm_unpackhi_epi8(x, zero);
+
+    __m128i p0 = _mm_or_si128(_mm_sll_epi32(_mm_unpacklo_epi16(lo, zero), sh), or_v);
+    __m128i p1 = _mm_or_si128(_mm_sll_epi32(_mm_unpackhi_epi16(lo, zero), sh), or_v);
+    __m128i p2 = _mm_or_si128(_mm_sll_epi32(_mm_unpacklo_epi16(hi, zero), sh), or_v);
+    __m128i p3 = _mm_or_si128(_mm_sll_epi32(_mm_unpackhi_epi16(hi, zero), sh), or_v);
+
+    _mm_storeu_si128((__m128i*) (dst + i * 4 +  0), p0);
+    _mm_storeu_si128((__m128i*) (dst + i * 4 + 16), p1);
+    _mm_storeu_si128((__m128i*) (dst + i * 4 + 32), p2);
+    _mm_storeu_si128((__m128i*) (dst + i * 4 + 48), p3);
+  }
+#elif KB_SIMD_NEON
+  const uint32x4_t or_v = vdupq_n_u32(fill);
+  const int32x4_t  sh   = vdupq_n_s32((int32_t) shift);
+
+  for (; i + 16 <= count; i += 16) {
+    uint8x16_t x  = vld1q_u8(src + i);
+    uint16x8_t lo = vmovl_u8(vget_low_u8(x));
+    uint16x8_t hi = vmovl_u8(vget_high_u8(x));
+
+    uint32x4_t p0 = vorrq_u32(vshlq_u32(vmovl_u16(vget_low_u16(lo)),  sh), or_v);
+    uint32x4_t p1 = vorrq_u32(vshlq_u32(vmovl_u16(vget_high_u16(lo)), sh), or_v);
+    uint32x4_t p2 = vorrq_u32(vshlq_u32(vmovl_u16(vget_low_u16(hi)),  sh), or_v);
+    uint32x4_t p3 = vorrq_u32(vshlq_u32(vmovl_u16(vget_high_u16(hi)), sh), or_v);
+
+    vst1q_u8(dst + i * 4 +  0, vreinterpretq_u8_u32(p0));
+    vst1q_u8(dst + i * 4 + 16, vreinterpretq_u8_u32(p1));
+    vst1q_u8(dst + i * 4 + 32, vreinterpretq_u8_u32(p2));
+    vst1q_u8(dst + i * 4 + 48, vreinterpretq_u8_u32(p3));
+  }
+#endif
+
+  for (; i < count; ++i) {
+    store_u32(dst + i * 4, ((uint32_t) src[i] << shift) | fill);
+  }
+}
+
+KB_API uint32_t kb_pixel_format_size(kb_format format) {
+  switch (format) {
+    case KB_FORMAT_R8_UNORM:
+    case KB_FORMAT_R8_SNORM:
+    case KB_FORMAT_R8_UINT:
+    case KB_FORMAT_R8_SINT:       return 1;
+    case KB_FORMAT_R16_UNORM:
+    case KB_FORMAT_R16_SNORM:
+    case KB_FORMAT_R16_UINT:
+    case KB_FORMAT_R16_SINT:
+    case KB_FORMAT_R16_FLOAT:
+    case KB_FORMAT_RG8_UNORM:
+    case KB_FORMAT_RG8_SNORM:
+    case KB_FORMAT_RG8_UINT:
+    case KB_FORMAT_RG8_SINT:      return 2;
+    case KB_FORMAT_R32_UINT:
+    case KB_FORMAT_R32_SINT:
+    case KB_FORMAT_R32_FLOAT:
+    case KB_FORMAT_RG16_UNORM:
+    case KB_FORMAT_RG16_SNORM:
+    case KB_FORMAT_RG16_UINT:
+    case KB_FORMAT_RG16_SINT:
+    case KB_FORMAT_RG16_FLOAT:
+    case KB_FORMAT_RGBA8_UNORM:
+    case KB_FORMAT_RGBA8_SNORM:
+    case KB_FORMAT_RGBA8_UINT:
+    case KB_FORMAT_RGBA8_SINT:    return 4;
+    case KB_FORMAT_RG32_UINT:
+    case KB_FORMAT_RG32_SINT:
+    case KB_FORMAT_RG32_FLOAT:
+    case KB_FORMAT_RGBA16_UNORM:
+    case KB_FORMAT_RGBA16_SNORM:
+    case KB_FORMAT_RGBA16_UINT:
+    case KB_FORMAT_RGBA16_SINT:
+    case KB_FORMAT_RGBA16_FLOAT:  return 8;
+    case KB_FORMAT_RGBA32_UINT:
+    case KB_FORMAT_RGBA32_SINT:
+    case KB_FORMAT_RGBA32_FLOAT:  return 16;
+    default:                      return 0;
+  }
+}
+
+KB_API bool kb_pixel_convert(void* dst, kb_format dst_format, const void* src, kb_format src_format, uint64_t count) {
+  KB_ASSERT_NOT_NULL(dst);
+  KB_ASSERT_NOT_NULL(src);
+
+  if (dst_format == src_format) {
+    uint32_t size = kb_pixel_format_size(src_format);
+    if (size == 0) return false;
+
+    kb_memcpy(dst, src, size * count);
+    return true;
+  }
+
+  if (src_format == KB_FORMAT_R8_UNORM && dst_format == KB_FORMAT_RGBA8_UNORM) {
+    kb_pixel_r8_to_rgba8((uint8_t*) dst, (const uint8_t*) src, count);
+    return true;
+  }
+
+  if (src_format == KB_FORMAT_RGBA8_UNORM && dst_format == KB_FORMAT_R8_UNORM) {
+    kb_pixel_rgba8_to_r8((uint8_t*) dst, (const uint8_t*) src, count, 0);
+    return true;
+  }
+
+  if (src_format == KB_FORMAT_RGBA8_UNORM && dst_format == KB_FORMAT_RGBA32_FLOAT) {
+    kb_pixel_rgba8_to_rgba32f((float*) dst, (const uint8_t*) src, count);
+    return true;
+  }
+
+  if (src_format == KB_FORMAT_RGBA32_FLOAT && dst_format == KB_FORMAT_RGBA8_UNORM) {
+    kb_pixel_rgba32f_to_rgba8((uint8_t*) dst, (const float*) src, count);
+    return true;
+  }
+
+  return false;
+}
+
+KB_API void kb_pixel_r8_to_rgba8(uint8_t* dst, const uint8_t* src, uint64_t count) {
+  expand_r8(dst, src, count, 0, 0xFF000000u);
+}
+
+KB_API void kb_pixel_r8_to_rgba8_alpha(uint8_t* dst, const uint8_t* src, uint64_t count, uint32_t rgb) {
+  expand_r8(dst, src, count, 24, rgb & 0x00FFFFFFu);
+}
+
+KB_API void kb_pixel_rgba8_to_r8(uint8_t* dst, const uint8_t* src, uint64_t count, uint32_t channel) {
+  KB_ASSERT(channel < 4, "Invalid channel");
+
+  uint64_t i = 0;
+
+#if KB_SIMD_SSE2
+  const __m128i mask  = _mm_set1_epi32(0xFF);
+  const __m128i sh    = _mm_cvtsi32_si128((int) channel * 8);
+
+  for (; i + 16 <= count; i += 16) {
+    __m128i p0 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i*) (src + i * 4 +  0)), sh), mask);
+    __m128i p1 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i*) (src + i * 4 + 16)), sh), mask);
+    __m128i p2 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i*) (src + i * 4 + 32)), sh), mask);
+    __m128i p3 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i*) (src + i * 4 + 48)), sh), mask);
+
+    __m128i lo = _mm_packs_epi32(p0, p1);
+    __m128i hi = _mm_packs_epi32(p2, p3);
+
+    _mm_storeu_si128((__m128i*) (dst + i), _mm_packus_epi16(lo, hi));
+  }
+#elif KB_SIMD_NEON
+  for (; i + 16 <= count; i += 16) {
+    uint8x16x4_t p = vld4q_u8(src + i * 4);
+    vst1q_u8(dst + i, p.val[channel]);
+  }
+#endif
+
+  for (; i < count; ++i) {
+    dst[i] = src[i * 4 + channel];
+  }
+}
+
+KB_API void kb_pixel_rgba8_to_rgba32f(float* dst, const uint8_t* src, uint64_t count) {
+  const uint64_t n = count * 4;
+  uint64_t i = 0;
+
+#if KB_SIMD_SSE2
+  const __m128i zero  = _mm_setzero_si128();
+  const __m128  scale = _mm_set1_ps(1.0f / 255.0f);
+
+  for (; i + 16 <= n; i += 16) {
+    __m128i x  = _mm_loadu_si128((const __m128i*) (src + i));
+    __m128i lo = _mm_unpacklo_epi8(x, zero);
+    __m128i hi = _mm_unpackhi_epi8(x, zero);
+
+    _mm_storeu_ps(dst + i +  0, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));
+    _mm_storeu_ps(dst + i +  4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));
+    _mm_storeu_ps(dst + i +  8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));
+    _mm_storeu_ps(dst + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));
+  }
+#elif KB_SIMD_NEON
+  const float32x4_t scale = vdupq_n_f32(1.0f / 255.0f);
+
+  for (; i + 16 <= n; i += 16) {
+    uint8x16_t x  = vld1q_u8(src + i);
+    uint16x8_t lo = vmovl_u8(vget_low_u8(x));
+    uint16x8_t hi = vmovl_u8(vget_high_u8(x));
+
+    vst1q_f32(dst + i +  0, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))),  scale));
+    vst1q_f32(dst + i +  4, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), scale));
+    vst1q_f32(dst + i +  8, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))),  scale));
+    vst1q_f32(dst + i + 12, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), scale));
+  }
+#endif
+
+  for (; i < n; ++i) {
+    dst[i] = float(src[i]) * (1.0f / 255.0f);
+  }
+}
+
+KB_API void kb_pixel_rgba32f_to_rgba8(uint8_t* dst, const float* src, uint64_t count) {
+  const uint64_t n = count * 4;
+  uint64_t i = 0;
+
+#if KB_SIMD_SSE2
+  const __m128 zero   = _mm_setzero_ps();
+  const __m128 one    = _mm_set1_ps(1.0f);
+  const __m128 scale  = _mm_set1_ps(255.0f);
+  const __m128 half   = _mm_set1_ps(0.5f);
+
+  for (; i + 16 <= n; i += 16) {
+    __m128i i0 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i +  0), zero), one), scale), half));
+    __m128i i1 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i +  4), zero), one), scale), half));
+    __m128i i2 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i +  8), zero), one), scale), half));
+    __m128i i3 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 12), zero), one), scale), half));
+
+    _mm_storeu_si128((__m128i*) (dst + i), _mm_packus_epi16(_mm_packs_epi32(i0, i1), _mm_packs_epi32(i2, i3)));
+  }
+#elif KB_SIMD_NEON
+  const float32x4_t zero  = vdupq_n_f32(0.0f);
+  const float32x4_t one   = vdupq_n_f32(1.0f);
+  const float32x4_t scale = vdupq_n_f32(255.0f);
+  const float32x4_t half  = vdupq_n_f32(0.5f);
+
+  for (; i + 16 <= n; i += 16) {
+    uint32x4_t i0 = vcvtq_u32_f32(vmlaq_f32(half, vminq_f32(vmaxq_f32(vld1q_f32(src + i +  0), zero), one), scale));
+    uint32x4_t i1 = vcvtq_u32_f32(vmlaq_f32(half, vminq_f32(vmaxq_f32(vld1q_f32(src + i +  4), zero), one), scale));
+    uint32x4_t i2 = vcvtq_u32_f32(vmlaq_f32(half, vminq_f32(vmaxq_f32(vld1q_f32(src + i +  8), zero), one), scale));
+    uint32x4_t i3 = vcvtq_u32_f32(vmlaq_f32(half, vminq_f32(vmaxq_f32(vld1q_f32(src + i + 12), zero), one), scale));
+
+    uint16x8_t lo = vcombine_u16(vmovn_u32(i0), vmovn_u32(i1));
+    uint16x8_t hi = vcombine_u16(vmovn_u32(i2), vmovn_u32(i3));
+
+    vst1q_u8(dst + i, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+  }
+#endif
+
+  for (; i < n; ++i) {
+    dst[i] = to_unorm8(src[i]);
+  }
+}
+
+KB_API void kb_pixel_srgb_to_linear(float* dst, const uint8_t* src, uint64_t count) {
+  const srgb_luts& luts = get_srgb_luts();
+
+  for (uint64_t i = 0; i < count; ++i) {
+    const uint8_t* s = src + i * 4;
+    float*         d = dst + i * 4;
+
+    d[0] = luts.to_linear[s[0]];
+    d[1] = luts.to_linear[s[1]];
+    d[2] = luts.to_linear[s[2]];
+    d[3] = float(s[3]) * (1.0f / 255.0f);
+  }
+}
+
+KB_API void kb_pixel_linear_to_srgb(uint8_t* dst, const float* src, uint64_t count) {
+  const srgb_luts& luts = get_srgb_luts();
+  const float lut_scale = float(LINEAR_TO_SRGB_LUT_SIZE - 1);
+
+  for (uint64_t i = 0; i < count; ++i) {
+    const float*  s = src + i * 4;
+    uint8_t*      d = dst + i * 4;
+
+    d[0] = luts.to_srgb[(uint32_t) (saturate(s[0]) * lut_scale + 0.5f)];
+    d[1] = luts.to_srgb[(uint32_t) (saturate(s[1]) * lut_scale + 0.5f)];
+    d[2] = luts.to_srgb[(uint32_t) (saturate(s[2]) * lut_scale + 0.5f)];
+    d[3] = to_unorm8(s[3]);
+  }
+}
+
+KB_API void kb_pixel_premultiply_rgba8(uint8_t* dst, const uint8_t* src, uint64_t count) {
+  uint64_t i = 0;
+
+#if KB_SIMD_SSE2
+  const __m128i zero    = _mm_setzero_si128();
+  const __m128i round   = _mm_set1_epi16(128);
+  const __m128i amask   = _mm_set1_epi32((int) 0xFF000000u);
+
+  for (; i + 4 <= count; i += 4) {
+    __m128i x  = _mm_loadu_si128((const __m128i*) (src + i * 4));
+    __m128i lo = _mm_unpacklo_epi8(x, zero);
+    __m128i hi = _mm_unpackhi_epi8(x, zero);
+
+    __m128i alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+    // x * a / 255 with rounding
+    lo = _mm_add_epi16(_mm_mullo_epi16(lo, alo), round);
+    hi = _mm_add_epi16(_mm_mullo_epi16(hi, ahi), round);
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+    __m128i res = _mm_packus_epi16(lo, hi);
+    res = _mm_or_si128(_mm_andnot_si128(amask, res), _mm_and_si128(amask, x));
+
+    _mm_storeu_si128((__m128i*) (dst + i * 4), res);
+  }
+#elif KB_SIMD_NEON
+  for (; i + 8 <= count; i += 8) {
+    uint8x8x4_t p = vld4_u8(src + i * 4);
+
+    for (uint32_t c = 0; c < 3; ++c) {
+      uint16x8_t t = vmull_u8(p.val[c], p.val[3]);
+      p.val[c] = vrshrn_n_u16(vrsraq_n_u16(t, t, 8), 8);
+    }
+
+    vst4_u8(dst + i * 4, p);
+  }
+#endif
+
+  for (; i < count; ++i) {
+    const uint8_t* s = src + i * 4;
+    uint8_t*       d = dst + i * 4;
+    const uint8_t  a = s[3];
+
+    d[0] = mul_unorm8(s[0], a);
+    d[1] = mul_unorm8(s[1], a);
+    d[2] = mul_unorm8(s[2], a);
+    d[3] = a;
+  }
+}
+
+KB_API void kb_pixel_swizzle_rgba8(uint8_t* dst, const uint8_t* src, uint64_t count, const uint8_t swizzle[4]) {
+  KB_ASSERT(swizzle[0] < 4 && swizzle[1] < 4 && swizzle[2] < 4 && swizzle[3] < 4, "Invalid swizzle");
+
+  uint64_t i = 0;
+
+#if KB_SIMD_SSE2
+#if KB_PIXEL_SSSE3
+  if (has_ssse3()) i = swizzle_ssse3(dst, src, count, swizzle);
+#endif
+
+  // Moves each channel into place with a shift and a mask
+  const __m128i mask = _mm_set1_epi32(0xFF);
+  __m128i from[4];
+  __m128i to[4];
+
+  for (uint32_t c = 0; c < 4; ++c) {
+    from[c] = _mm_cvtsi32_si128((int) swizzle[c] * 8);
+    to[c]   = _mm_cvtsi32_si128((int) c * 8);
+  }
+
+  for (; i + 4 <= count; i += 4) {
+    __m128i x = _mm_loadu_si128((const __m128i*) (src + i * 4));
+
+    __m128i r = _mm_sll_epi32(_mm_and_si128(_mm_srl_epi32(x, from[0]), mask), to[0]);
+    __m128i g = _mm_sll_epi32(_mm_and_si128(_mm_srl_epi32(x, from[1]), mask), to[1]);
+    __m128i b = _mm_sll_epi32(_mm_and_si128(_mm_srl_epi32(x, from[2]), mask), to[2]);
+    __m128i a = _mm_sll_epi32(_mm_and_si128(_mm_srl_epi32(x, from[3]), mask), to[3]);
+
+    _mm_storeu_si128((__m128i*) (dst + i * 4), _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, a)));
+  }
+#elif KB_SIMD_NEON
+  for (; i + 16 <= count; i += 16) {
+    uint8x16x4_t s = vld4q_u8(src + i * 4);
+    uint8x16x4_t d;
+
+    d.val[0] = s.val[swizzle[0]];
+    d.val[1] = s.val[swizzle[1]];
+    d.val[2] = s.val[swizzle[2]];
+    d.val[3] = s.val[swizzle[3]];
+
+    vst4q_u8(dst + i * 4, d);
+  }
+#endif
+
+  for (; i < count; ++i) {
+    uint8_t p[4];
+    kb_memcpy(p, src + i * 4, 4);
+
+    dst[i * 4 + 0] = p[swizzle[0]];
+    dst[i * 4 + 1] = p[swizzle[1]];
+    dst[i * 4 + 2] = p[swizzle[2]];
+    dst[i * 4 + 3] = p[swizzle[3]];
+  }
+}
+
+KB_API void kb_pixel_expand_rgba8(uint8_t* dst, const uint8_t* src, uint64_t count, uint32_t src_channels) {
+  KB_ASSERT(src_channels >= 1 && src_channels <= 4, "Invalid channel count");
+
+  uint64_t i = 0;
+
+  switch (src_channels) {
+    case 1: {
+      // Luminance to (l, l, l, 255)
+#if KB_SIMD_SSE2
+      const __m128i ones = _mm_set1_epi8((char) 0xFF);
+
+      for (; i + 16 <= count; i += 16) {
+        __m128i x   = _mm_loadu_si128((const __m128i*) (src + i));
+        __m128i llo = _mm_unpacklo_epi8(x, x);
+        __m128i lhi = _mm_unpackhi_epi8(x, x);
+        __m128i alo = _mm_unpacklo_epi8(x, ones);
+        __m128i ahi = _mm_unpackhi_epi8(x, ones);
+
+        _mm_storeu_si128((__m128i*) (dst + i * 4 +  0), _mm_unpacklo_epi16(llo, alo));
+        _mm_storeu_si128((__m128i*) (dst + i * 4 + 16), _mm_unpackhi_epi16(llo, alo));
+        _mm_storeu_si128((__m128i*) (dst + i * 4 + 32), _mm_unpacklo_epi16(lhi, ahi));
+        _mm_storeu_si128((__m128i*) (dst + i * 4 + 48), _mm_unpackhi_epi16(lhi, ahi));
+      }
+#elif KB_SIMD_NEON
+      for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t d;
+        d.val[0] = vld1q_u8(src + i);
+        d.val[1] = d.val[0];
+        d.val[2] = d.val[0];
+        d.val[3] = vdupq_n_u8(0xFF);
+        vst4q_u8(dst + i * 4, d);
+      }
+#endif
+      for (; i < count; ++i) {
+        store_u32(dst + i * 4, (uint32_t) src[i] * 0x010101u | 0xFF000000u);
+      }
+    } break;
+
+    case 2: {
+      // Luminance + alpha to (l, l, l, a)
+#if KB_SIMD_SSE2
+      const __m128i lmask = _mm_set1_epi16(0xFF);
+
+      // Low half of each pixel is (l, l), high half is the source (l, a) pair
+      for (; i + 8 <= count; i += 8) {
+        __m128i x  = _mm_loadu_si128((const __m128i*) (src + i * 2));
+        __m128i l  = _mm_and_si128(x, lmask);
+        __m128i ll = _mm_or_si128(l, _mm_slli_epi16(l, 8));
+
+        _mm_storeu_si128((__m128i*) (dst + i * 4 +  0), _mm_unpacklo_epi16(ll, x));
+        _mm_storeu_si128((__m128i*) (dst + i * 4 + 16), _mm_unpackhi_epi16(ll, x));
+      }
+#elif KB_SIMD_NEON
+      for (; i + 16 <= count; i += 16) {
+        uint8x16x2_t s = vld2q_u8(src + i * 2);
+        uint8x16x4_t d;
+        d.val[0] = s.val[0];
+        d.val[1] = s.val[0];
+        d.val[2] = s.val[0];
+        d.val[3] = s.val[1];
+        vst4q_u8(dst + i * 4, d);
+      }
+#endif
+      for (; i < count; ++i) {
+        store_u32(dst + i * 4, (uint32_t) src[i * 2] * 0x010101u | (uint32_t) src[i * 2 + 1] << 24);
+      }
+    } break;
+
+    case 3: {
+      // RGB to (r, g, b, 255)
+#if KB_PIXEL_SSSE3
+      if (has_ssse3()) i = expand_rgb_ssse3(dst, src, count);
+#elif KB_SIMD_NEON
+      for (; i + 16 <= count; i += 16) {
+        uint8x16x3_t s = vld3q_u8(src + i * 3);
+        uint8x16x4_t d;
+        d.val[0] = s.val[0];
+        d.val[1] = s.val[1];
+        d.val[2] = s.val[2];
+        d.val[3] = vdupq_n_u8(0xFF);
+        vst4q_u8(dst + i * 4, d);
+      }
+#endif
+      for (; i < count; ++i) {
+        const uint8_t* s = src + i * 3;
+        store_u32(dst + i * 4, (uint32_t) s[0] | (uint32_t) s[1] << 8 | (uint32_t) s[2] << 16 | 0xFF000000u);
+      }
+    } break;
+
+    case 4: {
+      kb_memcpy(dst, src, count * 4);
+    } break;
+  }
+}
+
+KB_API void kb_pixel_reduce_rgba8(uint8_t* dst, const uint8_t* src, uint64_t count, uint32_t dst_channels) {
+  KB_ASSERT(dst_channels >= 1 && dst_channels <= 4, "Invalid channel count");
+
+  uint64_t i = 0;
+
+  switch (dst_channels) {
+    case 1: {
+      kb_pixel_rgba8_to_r8(dst, src, count, 0);
+    } break;
+
+    case 2: {
+#if KB_SIMD_NEON
+      for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t s = vld4q_u8(src + i * 4);
+        uint8x16x2_t d;
+        d.val[0] = s.val[0];
+        d.val[1] = s.val[1];
+        vst2q_u8(dst + i * 2, d);
+      }
+#endif
+      for (; i < count; ++i) {
+        dst[i * 2 + 0] = src[i * 4 + 0];
+        dst[i * 2 + 1] = src[i * 4 + 1];
+      }
+    } break;
+
+    case 3: {
+#if KB_PIXEL_SSSE3
+      if (has_ssse3()) i = reduce_rgb_ssse3(dst, src, count);
+#elif KB_SIMD_NEON
+      for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t s = vld4q_u8(src + i * 4);
+        uint8x16x3_t d;
+        d.val[0] = s.val[0];
+        d.val[1] = s.val[1];
+        d.val[2] = s.val[2];
+        vst3q_u8(dst + i * 3, d);
+      }
+#endif
+      for (; i < count; ++i) {
+        dst[i * 3 + 0] = src[i * 4 + 0];
+        dst[i * 3 + 1] = src[i * 4 + 1];
+        dst[i * 3 + 2] = src[i * 4 + 2];
+      }
+    } break;
+
+    case 4: {
+      kb_memcpy(dst, src, count * 4);
+    } break;
+  }
+}
@@ -6,10 +6,18 @@
 
 #include <kbextra/texture.h>
 
+#include <kb/foundation/metrics.h>
+#include <kb/foundation/profile.h>
+
 void kb_texture_read(kb_texture_data* dst, kb_stream* src) {
+  KB_PROFILE_SCOPE("kb_texture_read");
+
   kb_read(src, dst->header);
   dst->data = KB_DEFAULT_ALLOC(dst->data_size);
   kb_stream_read(src, dst->data, 1, dst->data_size);
+
+  static kb::counter texture_bytes_read("texture.bytes_read");
+  texture_bytes_read.add(dst->data_size);
 }
 
 void kb_texture_write(const kb_texture_data* src, kb_stream* dst) {  
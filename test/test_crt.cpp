@@ -0,0 +1,169 @@
+#include <catch.hpp>
+
+#include <kb/foundation/crt.h>
+
+#include <vector>
+
+// Element sizes cover every fixed size kernel and the memcpy fallback on both
+// sides of them, counts cover the unrolled loops, SIMD blocks and their tails.
+static const size_t elem_sizes[] = { 1, 3, 4, 5, 8, 12, 16, 20 };
+static const size_t paddings[]   = { 0, 1, 4, 13 };
+static const size_t counts[]     = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 31, 257, 600 };
+
+static std::vector<uint8_t> pattern(size_t size, uint32_t seed) {
+  std::vector<uint8_t> bytes(size);
+
+  uint32_t state = seed * 2654435761u + 1;
+  for (uint8_t& b : bytes) {
+    state = state * 1664525u + 1013904223u;
+    b = (uint8_t) (state >> 24);
+  }
+
+  return bytes;
+}
+
+static size_t count_diff(const uint8_t* a, const uint8_t* b, size_t size) {
+  size_t diff = 0;
+  for (size_t i = 0; i < size; ++i) {
+    if (a[i] != b[i]) diff++;
+  }
+  return diff;
+}
+
+TEST_CASE("strided copy should match per element copies", "[crt]") {
+  for (size_t elem_size : elem_sizes) {
+    for (size_t src_pad : paddings) {
+      for (size_t dst_pad : paddings) {
+        for (size_t count : counts) {
+          size_t src_stride = elem_size + src_pad;
+          size_t dst_stride = elem_size + dst_pad;
+
+          std::vector<uint8_t> src       = pattern(src_stride * count, (uint32_t) (elem_size * 31 + count));
+          std::vector<uint8_t> dst       = pattern(dst_stride * count, (uint32_t) count);
+          std::vector<uint8_t> expected  = dst;
+
+          for (size_t i = 0; i < count; ++i) {
+            kb_memcpy(expected.data() + i * dst_stride, src.data() + i * src_stride, elem_size);
+          }
+
+          kb_memcpy_strided(dst.data(), dst_stride, src.data(), src_stride, elem_size, count);
+
+          INFO("elem " << elem_size << " src stride " << src_stride << " dst stride " << dst_stride << " count " << count);
+          REQUIRE(count_diff(dst.data(), expected.data(), dst.size()) == 0);
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("gather and scatter should follow the index list", "[crt]") {
+  for (size_t elem_size : elem_sizes) {
+    for (size_t pad : paddings) {
+      for (size_t count : counts) {
+        size_t stride = elem_size + pad;
+
+        // Jumps around the table, repeats included when count is a multiple
+        // of 5. Repeated scatter targets keep the last write, as in the loop.
+        std::vector<uint32_t> indices(count);
+        for (size_t i = 0; i < count; ++i) {
+          indices[i] = (uint32_t) ((i * 5 + 3) % count);
+        }
+
+        std::vector<uint8_t> table = pattern(stride * count, (uint32_t) (elem_size + count));
+
+        std::vector<uint8_t> gathered = pattern(elem_size * count, 3);
+        std::vector<uint8_t> expected = gathered;
+        for (size_t i = 0; i < count; ++i) {
+          kb_memcpy(expected.data() + i * elem_size, table.data() + indices[i] * stride, elem_size);
+        }
+
+        kb_memcpy_gather(gathered.data(), elem_size, table.data(), stride, indices.data(), elem_size, count);
+
+        INFO("gather elem " << elem_size << " stride " << stride << " count " << count);
+        REQUIRE(count_diff(gathered.data(), expected.data(), gathered.size()) == 0);
+
+        std::vector<uint8_t> scattered = pattern(stride * count, 5);
+        std::vector<uint8_t> expected_scatter = scattered;
+        for (size_t i = 0; i < count; ++i) {
+          kb_memcpy(expected_scatter.data() + indices[i] * stride, gathered.data() + i * elem_size, elem_size);
+        }
+
+        kb_memcpy_scatter(scattered.data(), stride, gathered.data(), elem_size, indices.data(), elem_size, count);
+
+        INFO("scatter elem " << elem_size << " stride " << stride << " count " << count);
+        REQUIRE(count_diff(scattered.data(), expected_scatter.data(), scattered.size()) == 0);
+      }
+    }
+  }
+}
+
+TEST_CASE("interleave and deinterleave should round trip every layout", "[crt]") {
+  // Packed equal 4 and 8 byte streams take the transpose kernels, the rest
+  // and padded strides take the chunked strided path
+  const std::vector<std::vector<size_t>> layouts = {
+    { 4, 4 },
+    { 4, 4, 4, 4 },
+    { 8, 8 },
+    { 4, 4, 4 },
+    { 8, 8, 8, 8 },
+    { 16, 16 },
+    { 12, 12, 8 },
+    { 12, 4, 8, 16 },
+    { 1, 3, 5 },
+  };
+
+  for (const std::vector<size_t>& sizes : layouts) {
+    size_t packed = 0;
+    for (size_t size : sizes) packed += size;
+
+    for (size_t pad : { (size_t) 0, (size_t) 4 }) {
+      for (size_t count : counts) {
+        size_t   stride       = packed + pad;
+        uint32_t stream_count = (uint32_t) sizes.size();
+
+        std::vector<std::vector<uint8_t>> streams;
+        std::vector<const void*> srcs;
+        for (uint32_t s = 0; s < stream_count; ++s) {
+          streams.push_back(pattern(sizes[s] * count, (uint32_t) (s * 1000 + count)));
+          srcs.push_back(streams[s].data());
+        }
+
+        std::vector<uint8_t> interleaved = pattern(stride * count, 9);
+        std::vector<uint8_t> expected    = interleaved;
+
+        for (size_t i = 0; i < count; ++i) {
+          size_t offset = 0;
+          for (uint32_t s = 0; s < stream_count; ++s) {
+            kb_memcpy(expected.data() + i * stride + offset, streams[s].data() + i * sizes[s], sizes[s]);
+            offset += sizes[s];
+          }
+        }
+
+        kb_interleave(interleaved.data(), stride, srcs.data(), sizes.data(), stream_count, count);
+
+        INFO("interleave streams " << stream_count << " stride " << stride << " count " << count);
+        REQUIRE(count_diff(interleaved.data(), expected.data(), interleaved.size()) == 0);
+
+        std::vector<std::vector<uint8_t>> outputs;
+        std::vector<void*> dsts;
+        for (uint32_t s = 0; s < stream_count; ++s) {
+          outputs.push_back(std::vector<uint8_t>(sizes[s] * count + 1, 0xCD));
+        }
+        for (uint32_t s = 0; s < stream_count; ++s) {
+          dsts.push_back(outputs[s].data());
+        }
+
+        kb_deinterleave(dsts.data(), sizes.data(), interleaved.data(), stride, stream_count, count);
+
+        size_t diff = 0;
+        for (uint32_t s = 0; s < stream_count; ++s) {
+          diff += count_diff(outputs[s].data(), streams[s].data(), sizes[s] * count);
+          if (outputs[s][sizes[s] * count] != 0xCD) diff++;
+        }
+
+        INFO("deinterleave streams " << stream_count << " stride " << stride << " count " << count);
+        REQUIRE(diff == 0);
+      }
+    }
+  }
+}
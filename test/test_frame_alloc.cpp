@@ -0,0 +1,178 @@
+#include <catch.hpp>
+
+#include <kb/foundation/alloc.h>
+#include <kb/foundation/parallel.h>
+#include <kb/foundation/thread.h>
+#include <kb/graphics.h>
+
+#include "../bench/frame_scene.h"
+
+#include <vector>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+TEST_CASE("frame mode should count allocations between marks", "[alloc]") {
+  kb_alloc_set_frame_mode(KB_ALLOC_FRAME_COUNT);
+
+  void* a = KB_DEFAULT_ALLOC(64);
+  a = KB_DEFAULT_REALLOC(a, 128);
+  kb_alloc_frame_mark();
+
+  REQUIRE(kb_alloc_frame_count() == 2);
+
+  KB_DEFAULT_FREE(a);
+  kb_alloc_frame_mark();
+
+  REQUIRE(kb_alloc_frame_count() == 0);
+  REQUIRE(kb_alloc_frame_total() == 2);
+
+  kb_alloc_set_frame_mode(KB_ALLOC_FRAME_OFF);
+
+  void* b = KB_DEFAULT_ALLOC(64);
+  kb_alloc_frame_mark();
+  KB_DEFAULT_FREE(b);
+
+  REQUIRE(kb_alloc_frame_total() == 0);
+}
+
+TEST_CASE("trap mode should abort on the first allocation", "[alloc]") {
+  pid_t pid = fork();
+  REQUIRE(pid >= 0);
+
+  if (pid == 0) {
+    kb_alloc_set_frame_mode(KB_ALLOC_FRAME_TRAP);
+    void* ptr = KB_DEFAULT_ALLOC(16);
+    _exit(ptr != NULL ? 0 : 1);
+  }
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+
+  REQUIRE(WIFSIGNALED(status));
+  REQUIRE(WTERMSIG(status) == SIGABRT);
+}
+
+KB_INTERNAL void empty_job(void* userdata) {}
+
+// Job blocks are recycled, so once the pool has seen a frame's worth of jobs
+// submission is heap free
+TEST_CASE("steady state job submission should not allocate", "[alloc][thread]") {
+  kb_thread_pool* pool = kb_threadpool_create(2);
+
+  for (uint32_t frame = 0; frame < 110; ++frame) {
+    if (frame == 10) kb_alloc_set_frame_mode(KB_ALLOC_FRAME_COUNT);
+
+    kb_job_counter counter {};
+    for (uint32_t i = 0; i < 256; ++i) {
+      kb_threadpool_add_counted_job(pool, NULL, empty_job, &counter);
+    }
+    kb_job_wait(pool, &counter);
+
+    kb_alloc_frame_mark();
+  }
+
+  uint64_t total = kb_alloc_frame_total();
+  kb_alloc_set_frame_mode(KB_ALLOC_FRAME_OFF);
+
+  kb_threadpool_destroy(pool);
+
+  REQUIRE(total == 0);
+}
+
+// Parallel tasks live on the caller's stack and scratch buffers are kept per
+// thread, so repeated calls of the same size are heap free
+TEST_CASE("steady state parallel algorithms should not allocate", "[alloc][parallel]") {
+  kb_thread_pool* pool = kb_threadpool_create(3);
+
+  std::vector<uint32_t> keys(20000);
+  std::vector<uint32_t> offsets(keys.size());
+
+  for (uint32_t frame = 0; frame < 60; ++frame) {
+    if (frame == 10) kb_alloc_set_frame_mode(KB_ALLOC_FRAME_COUNT);
+
+    for (size_t i = 0; i < keys.size(); ++i) keys[i] = (uint32_t) ((i * 2654435761u + frame) % 1000);
+
+    kb::parallel_for(pool, keys.size(), 0, [&](uint64_t begin, uint64_t end) {
+      for (uint64_t i = begin; i < end; ++i) keys[i] += 1;
+    });
+
+    kb::parallel_reduce(pool, keys.size(), 0, (uint64_t) 0,
+      [&](uint64_t begin, uint64_t end, uint64_t& partial) {
+        for (uint64_t i = begin; i < end; ++i) partial += keys[i];
+      },
+      [](uint64_t& dst, const uint64_t& src) { dst += src; }
+    );
+
+    kb_parallel_prefix_sum_u32(pool, offsets.data(), keys.data(), keys.size());
+    kb_parallel_sort_u32(pool, keys.data(), keys.size());
+
+    kb_alloc_frame_mark();
+  }
+
+  uint64_t total = kb_alloc_frame_total();
+  kb_alloc_set_frame_mode(KB_ALLOC_FRAME_OFF);
+
+  kb_threadpool_destroy(pool);
+
+  REQUIRE(total == 0);
+}
+
+// Runs the benchmark scene against the null backend. Warm-up frames may grow
+// buffers, after that no frame should touch the heap.
+KB_INTERNAL void run_scene(bool render_thread) {
+  frame_options options {};
+  options.meshes        = 256;
+  options.materials     = 16;
+  options.text_lines    = 8;
+  options.gizmos        = 16;
+  options.encoders      = 4;
+  options.frames        = 200;
+  options.warmup        = 10;
+  options.render_thread = render_thread;
+
+  kb_graphics_init_info init_info {};
+  init_info.resolution    = { 1280, 720 };
+  init_info.render_thread = render_thread;
+  frame_scene_init_info(&init_info, options);
+
+  kb_graphics_init(init_info);
+
+  frame_scene scene {};
+  frame_scene_create(&scene, options);
+
+  for (uint32_t frame = 0; frame < options.warmup; ++frame) {
+    frame_scene_record(&scene, options, frame);
+    kb_graphics_run_encoders();
+    kb_graphics_frame();
+  }
+
+  kb_alloc_set_frame_mode(KB_ALLOC_FRAME_COUNT);
+
+  uint32_t dirty_frames = 0;
+  for (uint32_t frame = 0; frame < options.frames; ++frame) {
+    frame_scene_record(&scene, options, options.warmup + frame);
+    kb_graphics_run_encoders();
+    kb_graphics_frame();
+
+    if (kb_alloc_frame_count() > 0) dirty_frames++;
+  }
+
+  uint64_t total = kb_alloc_frame_total();
+  kb_alloc_set_frame_mode(KB_ALLOC_FRAME_OFF);
+
+  frame_scene_destroy(&scene, options);
+  kb_graphics_deinit();
+
+  REQUIRE(dirty_frames == 0);
+  REQUIRE(total == 0);
+}
+
+TEST_CASE("steady state frames should not allocate", "[alloc][graphics]") {
+  run_scene(false);
+}
+
+TEST_CASE("steady state frames should not allocate with a render thread", "[alloc][graphics]") {
+  run_scene(true);
+}
@@ -0,0 +1,107 @@
+#include <catch.hpp>
+
+#include <kb/graphics.h>
+#include <kb/foundation/stream.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+static std::vector<std::string> split(const std::string& text, char separator) {
+  std::vector<std::string> parts;
+  std::stringstream stream(text);
+  std::string part;
+
+  while (std::getline(stream, part, separator)) parts.push_back(part);
+
+  return parts;
+}
+
+static std::vector<std::string> write_csv_lines() {
+  static char buffer[256 * 1024];
+  kb_memset(buffer, 0, sizeof(buffer));
+
+  kb_stream* stream = kb_stream_open_mem(buffer, sizeof(buffer));
+  kb_graphics_write_stats_csv(stream);
+  int64_t size = kb_stream_tell(stream);
+  kb_stream_close(stream);
+
+  return split(std::string(buffer, (size_t) size), '\n');
+}
+
+TEST_CASE("stats csv should hold one row per frame with per pass columns", "[graphics]") {
+  kb_graphics_init_info init_info {};
+  init_info.resolution      = { 1280, 720 };
+  init_info.pipe.pass_count = 2;
+
+  kb_graphics_init(init_info);
+
+  kb_pipeline_create_info pipeline_info {};
+  pipeline_info.pass        = 1;
+  pipeline_info.debug_label = "stats csv test";
+
+  kb_pipeline pipeline = kb_pipeline_create(pipeline_info);
+
+  const uint32_t frames = 5;
+
+  for (uint32_t frame = 0; frame < frames; ++frame) {
+    // Peaks in the second frame, the high water mark has to remember it
+    kb_graphics_transient_alloc(frame == 1 ? 64 * 1024 : 1024, KB_BUFFER_USAGE_UNIFORM_BUFFER);
+
+    kb_encoder encoder = kb_encoder_begin();
+    kb_encoder_bind_pipeline(encoder, pipeline);
+    for (uint32_t i = 0; i < frame + 1; ++i) {
+      kb_encoder_submit_draw(encoder, 0, 0, 3, 1);
+    }
+    kb_encoder_end(encoder);
+
+    kb_graphics_run_encoders();
+    kb_graphics_frame();
+  }
+
+  std::vector<std::string> lines = write_csv_lines();
+  REQUIRE(lines.size() == frames + 1);
+
+  std::vector<std::string> header = split(lines[0], ',');
+  REQUIRE(header.size() == 11 + 2 * 4);
+  REQUIRE(header[0] == "frametime");
+  REQUIRE(header[7] == "transient_high_water");
+  REQUIRE(header[11] == "pass0_draw_calls");
+  REQUIRE(header[15] == "pass1_draw_calls");
+  REQUIRE(header[18] == "pass1_submit_time");
+
+  for (uint32_t frame = 0; frame < frames; ++frame) {
+    std::vector<std::string> row = split(lines[frame + 1], ',');
+    REQUIRE(row.size() == header.size());
+
+    REQUIRE(std::stoul(row[4])  == frame + 1);  // draw_calls
+    REQUIRE(std::stoul(row[11]) == 0);          // pass0_draw_calls
+    REQUIRE(std::stoul(row[15]) == frame + 1);  // pass1_draw_calls
+
+    uint32_t used       = (uint32_t) std::stoul(row[6]);
+    uint32_t high_water = (uint32_t) std::stoul(row[7]);
+
+    REQUIRE(used < (frame == 1 ? 64 * 1024 + 256 : 2048));
+    REQUIRE(high_water >= (frame >= 1 ? 64 * 1024 : used));
+  }
+
+  // History is a ring of the last KB_CONFIG_STATS_SAMPLE_COUNT frames
+  for (uint32_t frame = 0; frame < KB_CONFIG_STATS_SAMPLE_COUNT + 10; ++frame) {
+    kb_graphics_run_encoders();
+    kb_graphics_frame();
+  }
+
+  lines = write_csv_lines();
+  REQUIRE(lines.size() == KB_CONFIG_STATS_SAMPLE_COUNT + 1);
+
+  kb_pipeline_destroy(pipeline);
+  kb_graphics_deinit();
+
+  // A new init starts with an empty history
+  kb_graphics_init(init_info);
+
+  lines = write_csv_lines();
+  REQUIRE(lines.size() == 1);
+
+  kb_graphics_deinit();
+}
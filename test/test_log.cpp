@@ -0,0 +1,305 @@
+#include <catch.hpp>
+
+#include <kb/log.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Points stdout at a temporary file for the lifetime of the capture
+struct stdout_capture {
+  char  path[32];
+  int   saved;
+
+  stdout_capture() {
+    snprintf(path, sizeof(path), "/tmp/kblogXXXXXX");
+    int fd = mkstemp(path);
+
+    fflush(stdout);
+    saved = dup(STDOUT_FILENO);
+    dup2(fd, STDOUT_FILENO);
+    close(fd);
+  }
+
+  ~stdout_capture() {
+    restore();
+    unlink(path);
+  }
+
+  void restore() {
+    if (saved < 0) return;
+
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    saved = -1;
+  }
+
+  // Lines written so far, drop reports from the logger excluded
+  std::vector<std::string> lines() {
+    std::vector<std::string> result;
+
+    FILE* file = fopen(path, "r");
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+      std::string text(line);
+      if (!text.empty() && text.back() == '\n') text.pop_back();
+      if (text.compare(0, 6, "[log] ") == 0) continue;
+      result.push_back(text);
+    }
+    fclose(file);
+
+    return result;
+  }
+};
+
+static std::vector<uint32_t> count_lines(const std::vector<std::string>& lines, uint32_t threads, uint32_t per_thread) {
+  std::vector<uint32_t> seen(threads * per_thread, 0);
+
+  for (const std::string& line : lines) {
+    uint32_t thread, index;
+    if (sscanf(line.c_str(), "t%u %u", &thread, &index) != 2) continue;
+    if (thread < threads && index < per_thread) seen[thread * per_thread + index]++;
+  }
+
+  return seen;
+}
+
+TEST_CASE("async log should write or count every line from every thread", "[log]") {
+  const uint32_t threads    = 4;
+  const uint32_t per_thread = 5000;
+
+  stdout_capture capture;
+
+  uint64_t dropped_before = kb_log_dropped();
+  kb_log_set_async(true);
+
+  std::vector<std::thread> producers;
+  for (uint32_t t = 0; t < threads; ++t) {
+    producers.emplace_back([t]() {
+      char line[64];
+      for (uint32_t i = 0; i < per_thread; ++i) {
+        snprintf(line, sizeof(line), "t%u %u", t, i);
+        kb_log_line(KB_LOG_LEVEL_INFO, line);
+      }
+    });
+  }
+  for (auto& p : producers) p.join();
+
+  kb_log_flush();
+  kb_log_set_async(false);
+  capture.restore();
+
+  std::vector<uint32_t> seen = count_lines(capture.lines(), threads, per_thread);
+
+  uint32_t written    = 0;
+  uint32_t duplicates = 0;
+  for (uint32_t count : seen) {
+    written += count > 0;
+    duplicates += count > 1;
+  }
+
+  uint64_t dropped = kb_log_dropped() - dropped_before;
+
+  REQUIRE(duplicates == 0);
+  REQUIRE(written + dropped == threads * per_thread);
+}
+
+TEST_CASE("async log should never drop errors", "[log]") {
+  const uint32_t threads    = 4;
+  const uint32_t per_thread = 3000;
+
+  stdout_capture capture;
+
+  uint64_t dropped_before = kb_log_dropped();
+  kb_log_set_async(true);
+
+  std::vector<std::thread> producers;
+  for (uint32_t t = 0; t < threads; ++t) {
+    producers.emplace_back([t]() {
+      char line[64];
+      for (uint32_t i = 0; i < per_thread; ++i) {
+        snprintf(line, sizeof(line), "t%u %u", t, i);
+        kb_log_line(KB_LOG_LEVEL_ERROR, line);
+      }
+    });
+  }
+  for (auto& p : producers) p.join();
+
+  kb_log_flush();
+  kb_log_set_async(false);
+  capture.restore();
+
+  std::vector<uint32_t> seen = count_lines(capture.lines(), threads, per_thread);
+
+  uint32_t missing = 0;
+  for (uint32_t count : seen) missing += count != 1;
+
+  REQUIRE(missing == 0);
+  REQUIRE(kb_log_dropped() == dropped_before);
+}
+
+TEST_CASE("log flush should wait for every earlier line", "[log]") {
+  const uint32_t threads    = 3;
+  const uint32_t per_thread = 2000;
+
+  stdout_capture capture;
+  kb_log_set_async(true);
+
+  std::atomic<uint32_t> short_flushes { 0 };
+
+  std::vector<std::thread> producers;
+  for (uint32_t t = 0; t < threads; ++t) {
+    producers.emplace_back([&, t]() {
+      char line[64];
+      for (uint32_t i = 0; i < per_thread; ++i) {
+        snprintf(line, sizeof(line), "t%u %u", t, i);
+        kb_log_line(KB_LOG_LEVEL_ERROR, line);
+
+        if (i % 500 != 499) continue;
+
+        // Everything this thread logged so far is in the file once flush returns
+        kb_log_flush();
+
+        std::vector<uint32_t> seen = count_lines(capture.lines(), threads, per_thread);
+        for (uint32_t j = 0; j <= i; ++j) {
+          if (seen[t * per_thread + j] != 1) {
+            short_flushes++;
+            break;
+          }
+        }
+      }
+    });
+  }
+  for (auto& p : producers) p.join();
+
+  kb_log_set_async(false);
+  capture.restore();
+
+  REQUIRE(short_flushes == 0);
+}
+
+TEST_CASE("disabling async log should keep lines logged during shutdown", "[log]") {
+  const uint32_t threads    = 4;
+  const uint32_t per_thread = 4000;
+
+  stdout_capture capture;
+  kb_log_set_async(true);
+
+  std::atomic<uint32_t> started { 0 };
+
+  std::vector<std::thread> producers;
+  for (uint32_t t = 0; t < threads; ++t) {
+    producers.emplace_back([&, t]() {
+      char line[64];
+      for (uint32_t i = 0; i < per_thread; ++i) {
+        snprintf(line, sizeof(line), "t%u %u", t, i);
+        kb_log_line(KB_LOG_LEVEL_ERROR, line);
+        if (i == 0) started++;
+      }
+    });
+  }
+
+  // Switch back to synchronous writes while every producer is mid stream
+  while (started < threads) std::this_thread::yield();
+  kb_log_set_async(false);
+
+  for (auto& p : producers) p.join();
+  capture.restore();
+
+  std::vector<uint32_t> seen = count_lines(capture.lines(), threads, per_thread);
+
+  uint32_t missing = 0;
+  for (uint32_t count : seen) missing += count != 1;
+
+  REQUIRE(missing == 0);
+}
+
+TEST_CASE("strfmt should truncate, terminate and return the written length", "[log]") {
+  char dst[8];
+
+  REQUIRE(kb::strfmt(dst, sizeof(dst), "{} {}", 12, "ab") == 5);
+  REQUIRE(std::string(dst) == "12 ab");
+
+  // Seven characters and the terminator fill the buffer exactly
+  REQUIRE(kb::strfmt(dst, sizeof(dst), "{}", "1234567") == 7);
+  REQUIRE(std::string(dst) == "1234567");
+
+  REQUIRE(kb::strfmt(dst, sizeof(dst), "{} world", "hello") == 7);
+  REQUIRE(std::string(dst) == "hello w");
+
+  REQUIRE(kb::strfmt(dst, 1, "{}", 42) == 0);
+  REQUIRE(dst[0] == '\0');
+
+  // Nothing is written without room for the terminator
+  dst[0] = 'x';
+  REQUIRE(kb::strfmt(dst, 0, "{}", 42) == 0);
+  REQUIRE(kb::strfmt(dst, -1, "{}", 42) == 0);
+  REQUIRE(dst[0] == 'x');
+}
+
+struct format_counter {
+  uint32_t* count;
+};
+
+namespace fmt {
+  template <>
+  struct formatter<format_counter> {
+    auto parse(format_parse_context& ctx) -> decltype(ctx.begin()) {
+      return ctx.begin();
+    }
+
+    template <typename FormatContext>
+    auto format(const format_counter& counter, FormatContext& ctx) -> decltype(ctx.out()) {
+      (*counter.count)++;
+      return format_to(ctx.out(), "counted");
+    }
+  };
+}
+
+TEST_CASE("filtered log lines should not be formatted", "[log]") {
+  uint32_t count = 0;
+  format_counter counter { &count };
+
+  stdout_capture capture;
+  kb_log_set_level(KB_LOG_LEVEL_WARN);
+
+  kb::log_trace("{}", counter);
+  kb::log_debug("{}", counter);
+  kb::log_info("{}", counter);
+
+  REQUIRE(count == 0);
+
+  kb::log_warn("{}", counter);
+  kb::log_error("{}", counter);
+
+  kb_log_set_level(KB_LOG_LEVEL_TRACE);
+  capture.restore();
+
+  REQUIRE(count == 2);
+
+  std::vector<std::string> lines = capture.lines();
+  REQUIRE(lines.size() == 2);
+  REQUIRE(lines[0] == "counted");
+}
+
+TEST_CASE("log lines longer than the format buffer should be cut", "[log]") {
+  std::string text(KB_LOG_FORMAT_BUFFER_SIZE * 2, 'x');
+
+  stdout_capture capture;
+  kb::log_info("{}", text);
+  capture.restore();
+
+  std::vector<std::string> lines = capture.lines();
+  REQUIRE(lines.size() > 0);
+
+  size_t length = 0;
+  for (const std::string& line : lines) length += line.size();
+
+  REQUIRE(length == KB_LOG_FORMAT_BUFFER_SIZE - 1);
+}
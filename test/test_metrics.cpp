@@ -0,0 +1,65 @@
+#include <catch.hpp>
+
+#include <kb/foundation/metrics.h>
+#include <kb/foundation/thread.h>
+
+#include <thread>
+#include <vector>
+
+TEST_CASE("metric registration should return the same handle for the same name", "[metrics]") {
+  kb_metric a = kb_metric_register("test.registration", KB_METRIC_COUNTER);
+  kb_metric b = kb_metric_register("test.registration", KB_METRIC_COUNTER);
+
+  REQUIRE(a == b);
+  REQUIRE(kb_metric_find(kb_hash_string("test.registration")) == a);
+  REQUIRE(kb_metric_find(kb_hash_string("test.not_registered")) == KB_METRIC_INVALID);
+  REQUIRE(a < kb_metric_count());
+}
+
+TEST_CASE("counter shards should sum across threads", "[metrics]") {
+  kb::counter counter("test.counter_threads");
+
+  const uint32_t thread_count = 4;
+  const uint32_t adds         = 100000;
+
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    threads.emplace_back([&] {
+      for (uint32_t j = 0; j < adds; ++j) counter.add();
+      kb_thread_unregister();
+    });
+  }
+
+  for (auto& thread : threads) thread.join();
+
+  REQUIRE(counter.value() == thread_count * adds);
+}
+
+TEST_CASE("frame snapshots should sample counter deltas and gauge values", "[metrics]") {
+  kb::counter counter ("test.counter_frames");
+  kb::gauge   gauge   ("test.gauge_frames");
+
+  kb_metric_frame();
+
+  counter.add(10);
+  gauge.set(7);
+  kb_metric_frame();
+
+  counter.add(30);
+  gauge.add(-2);
+  kb_metric_frame();
+
+  kb_metric_info info;
+
+  kb_metric_get_info(counter.id, &info);
+  REQUIRE(info.type   == KB_METRIC_COUNTER);
+  REQUIRE(info.value  == 40);
+  REQUIRE(info.frame  == 30);
+  REQUIRE(info.max    == 30.0f);
+
+  kb_metric_get_info(gauge.id, &info);
+  REQUIRE(info.type   == KB_METRIC_GAUGE);
+  REQUIRE(info.value  == 5);
+  REQUIRE(info.frame  == 5);
+  REQUIRE(info.max    == 7.0f);
+}
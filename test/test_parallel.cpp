@@ -0,0 +1,88 @@
+#include <catch.hpp>
+
+#include <kb/foundation/parallel.h>
+#include <kb/foundation/rand.h>
+
+#include <vector>
+#include <algorithm>
+#include <atomic>
+
+TEST_CASE("parallel for should visit every index exactly once", "[parallel]") {
+  kb_thread_pool* pool = kb_threadpool_create(4);
+
+  std::vector<std::atomic<uint32_t>> visits(10007);
+  for (auto& v : visits) v = 0;
+
+  kb::parallel_for(pool, visits.size(), 64, [&](uint64_t begin, uint64_t end) {
+    for (uint64_t i = begin; i < end; ++i) visits[i]++;
+  });
+
+  for (auto& v : visits) REQUIRE(v == 1);
+
+  kb_threadpool_destroy(pool);
+}
+
+TEST_CASE("parallel for without pool should run on calling thread", "[parallel]") {
+  uint64_t sum = 0;
+
+  kb::parallel_for(nullptr, 100, 0, [&](uint64_t begin, uint64_t end) {
+    for (uint64_t i = begin; i < end; ++i) sum += i;
+  });
+
+  REQUIRE(sum == 4950);
+}
+
+TEST_CASE("parallel reduce should match serial result", "[parallel]") {
+  kb_thread_pool* pool = kb_threadpool_create(4);
+
+  uint64_t sum = kb::parallel_reduce(pool, 100000, 0, (uint64_t) 0,
+    [](uint64_t begin, uint64_t end, uint64_t& partial) {
+      for (uint64_t i = begin; i < end; ++i) partial += i;
+    },
+    [](uint64_t& dst, const uint64_t& src) { dst += src; }
+  );
+
+  REQUIRE(sum == 100000ull * 99999ull / 2);
+
+  kb_threadpool_destroy(pool);
+}
+
+TEST_CASE("parallel prefix sum should be exclusive and return total", "[parallel]") {
+  kb_thread_pool* pool = kb_threadpool_create(4);
+
+  std::vector<uint32_t> src(50000);
+  std::vector<uint32_t> dst(src.size());
+  for (uint32_t i = 0; i < src.size(); ++i) src[i] = i % 7;
+
+  uint64_t total = kb_parallel_prefix_sum_u32(pool, dst.data(), src.data(), src.size());
+
+  uint32_t acc = 0;
+  for (uint32_t i = 0; i < src.size(); ++i) {
+    REQUIRE(dst[i] == acc);
+    acc += src[i];
+  }
+  REQUIRE(total == acc);
+
+  kb_threadpool_destroy(pool);
+}
+
+TEST_CASE("parallel sort should order keys", "[parallel]") {
+  kb_thread_pool* pool = kb_threadpool_create(3);
+
+  kb_rng rng { 1234 };
+
+  std::vector<uint64_t> data(100003);
+  for (auto& v : data) v = ((uint64_t) kb_rand_gen(&rng) << 32) | kb_rand_gen(&rng);
+
+  std::vector<uint64_t> expected = data;
+  std::sort(expected.begin(), expected.end());
+
+  kb_parallel_sort_u64(pool, data.data(), data.size());
+  REQUIRE(data == expected);
+
+  std::vector<uint32_t> small { 5, 3, 9, 1, 1, 0 };
+  kb_parallel_sort_u32(pool, small.data(), small.size());
+  REQUIRE(small == std::vector<uint32_t>({ 0, 1, 1, 3, 5, 9 }));
+
+  kb_threadpool_destroy(pool);
+}
@@ -0,0 +1,171 @@
+#include <catch.hpp>
+
+#include <kbextra/pixel.h>
+
+#include <vector>
+
+// SIMD paths run in blocks of 4, 8 or 16 pixels and finish with a scalar tail,
+// every count up to a few blocks past the widest hits each split. Sources are
+// offset by a byte so loads are never aligned.
+static const uint32_t max_count = 70;
+
+static std::vector<uint8_t> random_bytes(uint32_t count, uint32_t seed) {
+  std::vector<uint8_t> bytes(count + 1);
+
+  uint32_t state = seed * 2654435761u + 1;
+  for (uint8_t& b : bytes) {
+    state = state * 1664525u + 1013904223u;
+    b = (uint8_t) (state >> 24);
+  }
+
+  return bytes;
+}
+
+static uint8_t mul_unorm8(uint32_t a, uint32_t b) {
+  uint32_t t = a * b + 128;
+  return (uint8_t) ((t + (t >> 8)) >> 8);
+}
+
+TEST_CASE("pixel expand and reduce should match scalar for every count", "[pixel]") {
+  for (uint32_t channels = 1; channels <= 4; ++channels) {
+    for (uint32_t count = 0; count <= max_count; ++count) {
+      std::vector<uint8_t> src = random_bytes(count * channels, count + channels);
+      const uint8_t* s = src.data() + 1;
+
+      std::vector<uint8_t> expanded(count * 4 + 1, 0xCD);
+      kb_pixel_expand_rgba8(expanded.data(), s, count, channels);
+
+      uint32_t mismatches = 0;
+      for (uint32_t i = 0; i < count; ++i) {
+        const uint8_t* p = s + i * channels;
+        uint8_t expected[4];
+
+        switch (channels) {
+          case 1: expected[0] = p[0]; expected[1] = p[0]; expected[2] = p[0]; expected[3] = 0xFF; break;
+          case 2: expected[0] = p[0]; expected[1] = p[0]; expected[2] = p[0]; expected[3] = p[1]; break;
+          case 3: expected[0] = p[0]; expected[1] = p[1]; expected[2] = p[2]; expected[3] = 0xFF; break;
+          case 4: expected[0] = p[0]; expected[1] = p[1]; expected[2] = p[2]; expected[3] = p[3]; break;
+        }
+
+        for (uint32_t c = 0; c < 4; ++c) {
+          if (expanded[i * 4 + c] != expected[c]) mismatches++;
+        }
+      }
+
+      INFO("expand channels " << channels << " count " << count);
+      REQUIRE(mismatches == 0);
+      REQUIRE(expanded[count * 4] == 0xCD);
+
+      std::vector<uint8_t> rgba = random_bytes(count * 4, count * 7 + channels);
+      std::vector<uint8_t> reduced(count * channels + 1, 0xCD);
+      kb_pixel_reduce_rgba8(reduced.data(), rgba.data() + 1, count, channels);
+
+      for (uint32_t i = 0; i < count; ++i) {
+        for (uint32_t c = 0; c < channels; ++c) {
+          if (reduced[i * channels + c] != rgba[1 + i * 4 + c]) mismatches++;
+        }
+      }
+
+      INFO("reduce channels " << channels << " count " << count);
+      REQUIRE(mismatches == 0);
+      REQUIRE(reduced[count * channels] == 0xCD);
+    }
+  }
+}
+
+TEST_CASE("pixel swizzle should match scalar for every count", "[pixel]") {
+  const uint8_t swizzles[][4] = {
+    { 0, 1, 2, 3 },
+    { 2, 1, 0, 3 },
+    { 3, 2, 1, 0 },
+    { 1, 1, 1, 3 },
+    { 3, 0, 3, 0 },
+  };
+
+  for (const uint8_t* swizzle : swizzles) {
+    for (uint32_t count = 0; count <= max_count; ++count) {
+      std::vector<uint8_t> src = random_bytes(count * 4, count + swizzle[0] * 4 + swizzle[3]);
+      std::vector<uint8_t> dst(count * 4 + 1, 0xCD);
+
+      kb_pixel_swizzle_rgba8(dst.data(), src.data() + 1, count, swizzle);
+
+      uint32_t mismatches = 0;
+      for (uint32_t i = 0; i < count; ++i) {
+        for (uint32_t c = 0; c < 4; ++c) {
+          if (dst[i * 4 + c] != src[1 + i * 4 + swizzle[c]]) mismatches++;
+        }
+      }
+
+      INFO("swizzle " << (int) swizzle[0] << (int) swizzle[1] << (int) swizzle[2] << (int) swizzle[3] << " count " << count);
+      REQUIRE(mismatches == 0);
+      REQUIRE(dst[count * 4] == 0xCD);
+    }
+  }
+}
+
+TEST_CASE("pixel channel conversions should match scalar for every count", "[pixel]") {
+  for (uint32_t count = 0; count <= max_count; ++count) {
+    std::vector<uint8_t> r8   = random_bytes(count, count);
+    std::vector<uint8_t> rgba = random_bytes(count * 4, count + 100);
+
+    uint32_t mismatches = 0;
+
+    std::vector<uint8_t> wide(count * 4);
+    kb_pixel_r8_to_rgba8(wide.data(), r8.data() + 1, count);
+    for (uint32_t i = 0; i < count; ++i) {
+      if (wide[i * 4 + 0] != r8[1 + i] || wide[i * 4 + 1] != 0 || wide[i * 4 + 2] != 0 || wide[i * 4 + 3] != 0xFF) mismatches++;
+    }
+
+    kb_pixel_r8_to_rgba8_alpha(wide.data(), r8.data() + 1, count, 0x00332211u);
+    for (uint32_t i = 0; i < count; ++i) {
+      if (wide[i * 4 + 0] != 0x11 || wide[i * 4 + 1] != 0x22 || wide[i * 4 + 2] != 0x33 || wide[i * 4 + 3] != r8[1 + i]) mismatches++;
+    }
+
+    std::vector<uint8_t> narrow(count);
+    for (uint32_t channel = 0; channel < 4; ++channel) {
+      kb_pixel_rgba8_to_r8(narrow.data(), rgba.data() + 1, count, channel);
+      for (uint32_t i = 0; i < count; ++i) {
+        if (narrow[i] != rgba[1 + i * 4 + channel]) mismatches++;
+      }
+    }
+
+    kb_pixel_premultiply_rgba8(wide.data(), rgba.data() + 1, count);
+    for (uint32_t i = 0; i < count; ++i) {
+      const uint8_t* s = rgba.data() + 1 + i * 4;
+      for (uint32_t c = 0; c < 3; ++c) {
+        if (wide[i * 4 + c] != mul_unorm8(s[c], s[3])) mismatches++;
+      }
+      if (wide[i * 4 + 3] != s[3]) mismatches++;
+    }
+
+    // Exact round trip, every byte is representable
+    std::vector<float> floats(count * 4);
+    kb_pixel_rgba8_to_rgba32f(floats.data(), rgba.data() + 1, count);
+    for (uint32_t i = 0; i < count * 4; ++i) {
+      if (floats[i] != float(rgba[1 + i]) * (1.0f / 255.0f)) mismatches++;
+    }
+
+    kb_pixel_rgba32f_to_rgba8(wide.data(), floats.data(), count);
+    for (uint32_t i = 0; i < count * 4; ++i) {
+      if (wide[i] != rgba[1 + i]) mismatches++;
+    }
+
+    INFO("count " << count);
+    REQUIRE(mismatches == 0);
+  }
+}
+
+TEST_CASE("pixel float conversion should saturate out of range values", "[pixel]") {
+  float src[20 * 4];
+  for (uint32_t i = 0; i < 20 * 4; ++i) {
+    src[i] = float(i % 7) * 0.5f - 1.0f;
+  }
+
+  uint8_t dst[20 * 4];
+  kb_pixel_rgba32f_to_rgba8(dst, src, 20);
+
+  for (uint32_t i = 0; i < 20 * 4; ++i) {
+    float f = src[i] < 0.0f ? 0.0f : (src[i] > 1.0f ? 1.0f : src[i]);
+    REQUIRE(dst[i] == (uint8_t) (f * 255.0f + 0.5f));
+  }
+}
@@ -0,0 +1,114 @@
+#include <catch.hpp>
+
+#include <kb/foundation/profile.h>
+#include <kb/foundation/alloc.h>
+#include <kb/foundation/thread.h>
+#include <kb/foundation/crt.h>
+
+#include <string>
+#include <thread>
+
+static void profiled_job(void* userdata) {
+  kb::profile_scope scope("test_job");
+  kb_profile_counter("test_counter", 1.0);
+}
+
+static std::string profile_json() {
+  static char buffer[1 << 20];
+  kb_stream* stream = kb_stream_open_mem(buffer, sizeof(buffer));
+  REQUIRE(kb_profile_write_json(stream));
+  std::string out(buffer, kb_stream_tell(stream));
+  kb_stream_close(stream);
+  return out;
+}
+
+static uint32_t count_of(const std::string& str, const std::string& needle) {
+  uint32_t count = 0;
+  for (size_t pos = str.find(needle); pos != std::string::npos; pos = str.find(needle, pos + 1)) ++count;
+  return count;
+}
+
+TEST_CASE("profiler should record zones from every thread into a chrome trace", "[profile]") {
+  kb_thread_pool* pool = kb_threadpool_create(4);
+
+  kb_profile_start();
+  kb_profile_set_thread_name("test main");
+  kb_profile_frame_mark();
+
+  kb_job_counter jobs = {};
+  for (uint32_t i = 0; i < 100; ++i) {
+    kb_threadpool_add_counted_job(pool, NULL, profiled_job, &jobs);
+  }
+  kb_job_wait(pool, &jobs);
+
+  kb_profile_stop();
+
+  // Nothing is recorded once stopped
+  profiled_job(NULL);
+
+  std::string json = profile_json();
+
+  REQUIRE(json.find("\"traceEvents\"") != std::string::npos);
+  REQUIRE(json.find("\"test main\"") != std::string::npos);
+  REQUIRE(count_of(json, "\"name\":\"test_job\",\"ph\":\"B\"") == 100);
+  REQUIRE(count_of(json, "\"name\":\"test_counter\",\"ph\":\"C\"") == 100);
+  REQUIRE(count_of(json, "\"name\":\"frame\"") == 1);
+
+  // A new capture starts empty
+  kb_profile_start();
+  kb_profile_stop();
+  REQUIRE(count_of(profile_json(), "test_job") == 0);
+
+  kb_threadpool_destroy(pool);
+}
+
+TEST_CASE("profiler binary export should start with its magic and name table", "[profile]") {
+  kb_profile_start();
+  for (uint32_t i = 0; i < 10000; ++i) {
+    kb::profile_scope scope("binary_zone");
+  }
+  kb_profile_stop();
+
+  static char buffer[1 << 20];
+  kb_stream* stream = kb_stream_open_mem(buffer, sizeof(buffer));
+  REQUIRE(kb_profile_write_binary(stream));
+  int64_t size = kb_stream_tell(stream);
+  kb_stream_close(stream);
+
+  uint32_t header[4];
+  kb_memcpy(header, buffer, sizeof(header));
+
+  REQUIRE(header[0] == KB_FOURCC('K', 'B', 'P', 'F'));
+  REQUIRE(header[2] == 1);
+
+  // 20000 events of 28 bytes each after the name and thread tables
+  REQUIRE(size > 20000 * 28);
+}
+
+// Short lived threads hand their buffers on, so only the first capture
+// allocates even though every round uses new threads
+TEST_CASE("profiler should reuse buffers of exited threads", "[profile]") {
+  const uint32_t threads = 8;
+
+  for (uint32_t round = 0; round < 3; ++round) {
+    if (round == 1) kb_alloc_set_frame_mode(KB_ALLOC_FRAME_COUNT);
+
+    kb_profile_start();
+
+    for (uint32_t i = 0; i < threads; ++i) {
+      std::thread thread([] { profiled_job(NULL); });
+      thread.join();
+    }
+
+    kb_profile_stop();
+    kb_alloc_frame_mark();
+  }
+
+  uint64_t total = kb_alloc_frame_total();
+  kb_alloc_set_frame_mode(KB_ALLOC_FRAME_OFF);
+
+  REQUIRE(total == 0);
+
+  // Events of exited threads stay until the next capture
+  REQUIRE(count_of(profile_json(), "\"name\":\"test_job\",\"ph\":\"B\"") == threads);
+}
@@ -0,0 +1,249 @@
+#include <catch.hpp>
+
+#include <kb/graphics.h>
+#include <kb/foundation/thread.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Pipelines created every frame grow the pipeline tables while the render
+// thread sorts and submits the previous frame. Draws have to land in the
+// pass of the pipeline they were recorded with.
+TEST_CASE("pipelines can be created while the render thread runs", "[graphics]") {
+  const uint32_t frames = 200;
+
+  kb_graphics_init_info init_info {};
+  init_info.resolution          = { 1280, 720 };
+  init_info.render_thread       = true;
+  init_info.pipe.pass_count     = 2;
+  init_info.capacity.pipelines  = frames + 1;
+
+  kb_graphics_init(init_info);
+
+  kb_pipeline* pipelines = new kb_pipeline[frames];
+  kb_graphics_stats stats;
+
+  uint32_t mismatches = 0;
+
+  for (uint32_t frame = 0; frame < frames; ++frame) {
+    kb_pipeline_create_info info {};
+    info.pass         = frame % 2;
+    info.debug_label  = "render thread test";
+
+    pipelines[frame] = kb_pipeline_create(info);
+
+    kb_encoder encoder = kb_encoder_begin();
+    kb_encoder_bind_pipeline(encoder, pipelines[frame]);
+    for (uint32_t i = 0; i < frame % 5 + 1; ++i) {
+      kb_encoder_submit_draw(encoder, 0, 0, 3, 1);
+    }
+    kb_encoder_end(encoder);
+
+    kb_graphics_frame();
+
+    // Submission stats lag recording by one frame
+    if (frame == 0) continue;
+
+    kb_graphics_get_stats(&stats);
+
+    uint32_t previous = frame - 1;
+    if (stats.passes[previous % 2].draw_calls != previous % 5 + 1) mismatches++;
+    if (stats.passes[(previous + 1) % 2].draw_calls != 0) mismatches++;
+  }
+
+  kb_graphics_flush();
+
+  kb_int2 extent = kb_graphics_get_extent();
+  REQUIRE(extent.x == 1280);
+  REQUIRE(extent.y == 720);
+
+  for (uint32_t frame = 0; frame < frames; ++frame) {
+    kb_pipeline_destroy(pipelines[frame]);
+  }
+  delete[] pipelines;
+
+  kb_graphics_deinit();
+
+  REQUIRE(mismatches == 0);
+}
+
+// Debug builds assert on the extra encoder, release builds hand back an
+// invalid one and drop whatever is recorded into it
+TEST_CASE("encoders past the limit should not corrupt the pool", "[graphics]") {
+  pid_t pid = fork();
+  REQUIRE(pid >= 0);
+
+  if (pid == 0) {
+    kb_graphics_init_info init_info {};
+    init_info.resolution      = { 1280, 720 };
+    init_info.pipe.pass_count = 1;
+
+    kb_graphics_init(init_info);
+
+    kb_pipeline_create_info pipeline_info {};
+    pipeline_info.debug_label = "encoder limit test";
+
+    kb_pipeline pipeline = kb_pipeline_create(pipeline_info);
+
+    kb_encoder encoders[KB_CONFIG_MAX_ENCODERS + 2];
+    for (uint32_t i = 0; i < KB_CONFIG_MAX_ENCODERS + 2; ++i) {
+      encoders[i] = kb_encoder_begin();
+    }
+
+    for (uint32_t i = 0; i < KB_CONFIG_MAX_ENCODERS + 2; ++i) {
+      kb_encoder_bind_pipeline(encoders[i], pipeline);
+      kb_encoder_submit_draw(encoders[i], 0, 0, 3, 1);
+      kb_encoder_end(encoders[i]);
+    }
+
+    kb_graphics_run_encoders();
+    kb_graphics_frame();
+
+    kb_graphics_stats stats;
+    kb_graphics_get_stats(&stats);
+
+    bool valid = !KB_IS_VALID(encoders[KB_CONFIG_MAX_ENCODERS]) && !KB_IS_VALID(encoders[KB_CONFIG_MAX_ENCODERS + 1]);
+    bool clamped = stats.encoders_used == KB_CONFIG_MAX_ENCODERS && stats.draw_calls_used == KB_CONFIG_MAX_ENCODERS;
+
+    kb_pipeline_destroy(pipeline);
+    kb_graphics_deinit();
+
+    _exit(valid && clamped ? 0 : 1);
+  }
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+
+#ifdef NDEBUG
+  REQUIRE(WIFEXITED(status));
+  REQUIRE(WEXITSTATUS(status) == 0);
+#else
+  REQUIRE(WIFSIGNALED(status));
+  REQUIRE(WTERMSIG(status) == SIGABRT);
+#endif
+}
+
+struct record_job {
+  kb_pipeline       pipeline;
+  uint32_t          draws;
+  kb_buffer_memory* writes;
+};
+
+KB_INTERNAL void record_encoder_job(void* param) {
+  record_job* job = (record_job*) param;
+
+  kb_uniform_slot slot {};
+  slot.stage  = KB_SHADER_STAGE_VERTEX;
+  slot.type   = KB_BINDING_TYPE_UNIFORM_BUFFER;
+
+  kb_encoder encoder = kb_encoder_begin();
+  kb_encoder_bind_pipeline(encoder, job->pipeline);
+
+  for (uint32_t i = 0; i < job->draws; ++i) {
+    float uniforms[16] = { float(i) };
+    job->writes[i] = kb_graphics_transient_write(uniforms, sizeof(uniforms), KB_BUFFER_USAGE_UNIFORM_BUFFER);
+
+    kb_encoder_bind_uniform(encoder, slot, job->writes[i]);
+    kb_encoder_submit_draw(encoder, 0, 0, 3, 1);
+  }
+
+  kb_encoder_end(encoder);
+}
+
+// Encoders recorded by pool jobs have to add up to the same frame as serial
+// recording, while the main thread keeps creating pipelines past the capacity
+// the pass table was sized for at init
+TEST_CASE("encoders recorded in parallel should match serial totals", "[graphics]") {
+  const uint32_t jobs   = KB_CONFIG_MAX_ENCODERS;
+  const uint32_t draws  = 64;
+  const uint32_t extra  = 600;
+
+  kb_graphics_init_info init_info {};
+  init_info.resolution            = { 1280, 720 };
+  init_info.pipe.pass_count       = 2;
+  init_info.capacity.pipelines    = 4;
+  init_info.capacity.draw_calls   = jobs * draws;
+
+  kb_graphics_init(init_info);
+
+  kb_pipeline_create_info pipeline_info {};
+  pipeline_info.debug_label = "parallel encoder test";
+
+  kb_pipeline pipelines[2];
+  for (uint32_t pass = 0; pass < 2; ++pass) {
+    pipeline_info.pass  = pass;
+    pipelines[pass]     = kb_pipeline_create(pipeline_info);
+  }
+
+  kb_pipeline_set_capacity(extra + 2);
+
+  kb_buffer_memory* writes = new kb_buffer_memory[jobs * draws];
+  record_job* params = new record_job[jobs];
+
+  uint32_t expected[2] = { 0, 0 };
+  for (uint32_t i = 0; i < jobs; ++i) {
+    params[i].pipeline  = pipelines[i % 2];
+    params[i].draws     = draws - i % 3;
+    params[i].writes    = writes + i * draws;
+    expected[i % 2] += params[i].draws;
+  }
+
+  kb_thread_pool* pool = kb_threadpool_create(4);
+  kb_job_counter counter;
+  kb_job_counter_init(&counter);
+
+  for (uint32_t i = 0; i < jobs; ++i) {
+    kb_threadpool_add_counted_job(pool, &params[i], record_encoder_job, &counter);
+  }
+
+  kb_pipeline* created = new kb_pipeline[extra];
+  pipeline_info.pass = 1;
+  for (uint32_t i = 0; i < extra; ++i) {
+    created[i] = kb_pipeline_create(pipeline_info);
+  }
+
+  kb_job_wait(pool, &counter);
+  kb_threadpool_destroy(pool);
+
+  kb_graphics_run_encoders();
+  kb_graphics_frame();
+
+  kb_graphics_stats stats;
+  kb_graphics_get_stats(&stats);
+
+  REQUIRE(stats.encoders_used == jobs);
+  REQUIRE(stats.draw_calls_used == expected[0] + expected[1]);
+  REQUIRE(stats.passes[0].draw_calls == expected[0]);
+  REQUIRE(stats.passes[1].draw_calls == expected[1]);
+
+  // Every write got its own range of the transient buffer
+  std::vector<uint64_t> offsets;
+  for (uint32_t i = 0; i < jobs; ++i) {
+    for (uint32_t d = 0; d < params[i].draws; ++d) {
+      offsets.push_back(params[i].writes[d].offset);
+    }
+  }
+  std::sort(offsets.begin(), offsets.end());
+
+  uint32_t overlaps = 0;
+  for (size_t i = 1; i < offsets.size(); ++i) {
+    if (offsets[i] < offsets[i - 1] + sizeof(float) * 16) overlaps++;
+  }
+  REQUIRE(overlaps == 0);
+
+  for (uint32_t i = 0; i < extra; ++i) {
+    kb_pipeline_destroy(created[i]);
+  }
+  kb_pipeline_destroy(pipelines[0]);
+  kb_pipeline_destroy(pipelines[1]);
+
+  delete[] created;
+  delete[] params;
+  delete[] writes;
+
+  kb_graphics_deinit();
+}
@@ -0,0 +1,78 @@
+#include <catch.hpp>
+
+#include <kb/foundation/handle.h>
+#include <kb/foundation/resource.h>
+
+KB_HANDLE(test_handle);
+
+typedef struct test_create_info {
+  uint32_t value;
+} test_create_info;
+
+typedef struct test_payload {
+  uint32_t value;
+} test_payload;
+
+KB_RESOURCE_HASHED_FUNC_DECLS (test, test_handle, test_create_info)
+KB_RESOURCE_ALLOC_FUNC_DECLS  (test, test_handle, test_create_info)
+
+KB_RESOURCE_STORAGE_DEF     (test, test_handle, test_payload);
+KB_RESOURCE_ALLOC_FUNC_DEF  (test, test_handle, test_create_info, 4);
+KB_RESOURCE_DATA_HASHED_DEF (test, test_handle);
+
+void kb_test_construct(test_handle handle, const test_create_info info) {
+  test_ref_create(handle)->value = info.value;
+  kb_test_set_initialized(handle, true);
+}
+
+void kb_test_destruct(test_handle handle) {
+  kb_test_set_initialized(handle, false);
+}
+
+TEST_CASE("resource storage should not allocate before first use", "[resource]") {
+  REQUIRE(kb_test_capacity() == 0);
+  REQUIRE(kb_test_count()    == 0);
+  REQUIRE_FALSE(kb_test_has(1234));
+}
+
+TEST_CASE("resource capacity should grow and keep live handles", "[resource]") {
+  test_handle a = kb_test_create({ 1 });
+  test_handle b = kb_test_create({ 2 });
+  kb_test_mark(b, 42);
+
+  REQUIRE(kb_test_capacity() == 4);
+
+  test_payload* ref_a = test_ref(a);
+
+  kb_test_set_capacity(1000);
+
+  REQUIRE(kb_test_capacity() == 1000);
+  REQUIRE(kb_test_count() == 2);
+  REQUIRE(kb_test_is_initialized(a));
+  REQUIRE(kb_test_get_existing(42).idx == b.idx);
+
+  for (uint32_t i = 0; i < 500; ++i) {
+    test_handle h = kb_test_create({ i });
+    REQUIRE(kb_is_valid(h));
+    REQUIRE(h.idx != a.idx);
+    REQUIRE(h.idx != b.idx);
+  }
+
+  REQUIRE(test_ref(a) == ref_a);
+  REQUIRE(ref_a->value == 1);
+  REQUIRE(test_ref(b)->value == 2);
+
+  kb_test_purge();
+  REQUIRE(kb_test_count() == 0);
+}
+
+TEST_CASE("resource lookups should not grow storage", "[resource]") {
+  test_handle handle = kb_test_create({ 7 });
+  uint64_t count = test_refs.count();
+
+  REQUIRE(count > handle.idx);
+  REQUIRE(test_ref(handle)->value == 7);
+  REQUIRE(test_refs.count() == count);
+
+  kb_test_destroy(handle);
+}
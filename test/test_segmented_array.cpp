@@ -0,0 +1,74 @@
+#include <catch.hpp>
+
+#include <kb/foundation/segmented_array.h>
+
+TEST_CASE("zero initialized segmented array should be empty and not freak out", "[segmented_array]") {
+  kb_segmented_array arr {};
+
+  REQUIRE(kb_segmented_array_count    (&arr)    == 0);
+  REQUIRE(kb_segmented_array_capacity (&arr)    == 0);
+  REQUIRE(kb_segmented_array_at       (&arr, 5) == nullptr);
+}
+
+TEST_CASE("segmented array block size should be rounded up to power of two", "[segmented_array]") {
+  kb_segmented_array arr {};
+
+  kb_segmented_array_create(&arr, sizeof(uint32_t), 100);
+
+  REQUIRE(kb_segmented_array_block_size(&arr) == 128);
+  REQUIRE(kb_segmented_array_capacity(&arr) == 0);
+
+  kb_segmented_array_destroy(&arr);
+}
+
+TEST_CASE("segmented array reserve should allocate whole blocks", "[segmented_array]") {
+  kb_segmented_array arr {};
+
+  kb_segmented_array_create(&arr, sizeof(uint32_t), 16);
+  kb_segmented_array_reserve(&arr, 17);
+
+  REQUIRE(kb_segmented_array_capacity(&arr) == 32);
+  REQUIRE(kb_segmented_array_count(&arr) == 0);
+
+  kb_segmented_array_destroy(&arr);
+}
+
+TEST_CASE("segmented array push_back should keep element addresses stable", "[segmented_array]") {
+  kb_segmented_array arr {};
+
+  kb_segmented_array_create(&arr, sizeof(uint32_t), 4);
+
+  uint32_t d = 0;
+  uint32_t* first = (uint32_t*) kb_segmented_array_push_back(&arr, &d);
+
+  for (d = 1; d < 1000; ++d) {
+    kb_segmented_array_push_back(&arr, &d);
+  }
+
+  REQUIRE(kb_segmented_array_count(&arr) == 1000);
+  REQUIRE(first == kb_segmented_array_at(&arr, 0));
+
+  for (uint32_t i = 0; i < 1000; ++i) {
+    REQUIRE(*(uint32_t*) kb_segmented_array_at(&arr, i) == i);
+  }
+
+  kb_segmented_array_destroy(&arr);
+}
+
+TEST_CASE("segmented array pop_back should decrease count, but not capacity", "[segmented_array]") {
+  kb::segmented_array<uint32_t, 2> arr;
+
+  arr.push_back(1);
+  arr.push_back(2);
+  arr.push_back(3);
+
+  REQUIRE(arr.count() == 3);
+  REQUIRE(arr.capacity() == 4);
+  REQUIRE(arr.back() == 3);
+
+  arr.pop_back();
+  REQUIRE(arr.count() == 2);
+  REQUIRE(arr.back() == 2);
+
+  REQUIRE(arr.capacity() == 4);
+}
@@ -0,0 +1,155 @@
+#include <catch.hpp>
+
+#include <kb/foundation/sync.h>
+
+#include <thread>
+#include <vector>
+
+TEST_CASE("atomics should return previous values", "[sync]") {
+  kb_atomic_u32 a = {};
+
+  REQUIRE(kb_atomic_fetch_add_u32(&a, 5) == 0);
+  REQUIRE(kb_atomic_fetch_sub_u32(&a, 2) == 5);
+  REQUIRE(kb_atomic_exchange_u32(&a, 10) == 3);
+
+  uint32_t expected = 7;
+  REQUIRE_FALSE(kb_atomic_cas_u32(&a, &expected, 1));
+  REQUIRE(expected == 10);
+  REQUIRE(kb_atomic_cas_u32(&a, &expected, 1));
+  REQUIRE(kb_atomic_load_u32(&a) == 1);
+
+  kb_atomic_u64 b = {};
+  kb_atomic_store_u64(&b, 1ull << 40);
+  REQUIRE(kb_atomic_fetch_add_u64(&b, 1) == 1ull << 40);
+  REQUIRE(kb_atomic_load_u64(&b) == (1ull << 40) + 1);
+}
+
+template <typename F>
+static void run_threads(uint32_t count, F func) {
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < count; ++i) threads.emplace_back(func, i);
+  for (auto& t : threads) t.join();
+}
+
+TEST_CASE("spinlock and lock should serialize critical sections", "[sync]") {
+  kb_spinlock spin  = {};
+  kb_lock     lock  = {};
+  uint64_t    a     = 0;
+  uint64_t    b     = 0;
+
+  run_threads(4, [&](uint32_t) {
+    for (uint32_t i = 0; i < 20000; ++i) {
+      kb_spinlock_lock(&spin);
+      a++;
+      kb_spinlock_unlock(&spin);
+
+      kb_lock_lock(&lock);
+      b++;
+      kb_lock_unlock(&lock);
+    }
+  });
+
+  REQUIRE(a == 80000);
+  REQUIRE(b == 80000);
+
+  REQUIRE(kb_lock_try_lock(&lock));
+  REQUIRE_FALSE(kb_lock_try_lock(&lock));
+  kb_lock_unlock(&lock);
+}
+
+TEST_CASE("counting semaphore should hand out every post once", "[sync]") {
+  kb_counting_semaphore sem       = {};
+  kb_atomic_u32         consumed  = {};
+
+  std::thread producer([&]() {
+    for (uint32_t i = 0; i < 1000; ++i) kb_counting_semaphore_post(&sem, 3);
+  });
+
+  run_threads(3, [&](uint32_t) {
+    for (uint32_t i = 0; i < 1000; ++i) {
+      kb_counting_semaphore_wait(&sem);
+      kb_atomic_fetch_add_u32(&consumed, 1);
+    }
+  });
+
+  producer.join();
+
+  REQUIRE(kb_atomic_load_u32(&consumed) == 3000);
+  REQUIRE_FALSE(kb_counting_semaphore_try_wait(&sem));
+}
+
+TEST_CASE("rwlock should keep writers exclusive", "[sync]") {
+  kb_rwlock lock  = {};
+  uint32_t  pair[2] = { 0, 0 };
+  bool      torn    = false;
+
+  run_threads(4, [&](uint32_t index) {
+    for (uint32_t i = 0; i < 5000; ++i) {
+      if (index == 0 || i % 16 == 0) {
+        kb_rwlock_write_lock(&lock);
+        pair[0]++;
+        pair[1]++;
+        kb_rwlock_write_unlock(&lock);
+      } else {
+        kb_rwlock_read_lock(&lock);
+        if (pair[0] != pair[1]) torn = true;
+        kb_rwlock_read_unlock(&lock);
+      }
+    }
+  });
+
+  REQUIRE_FALSE(torn);
+  REQUIRE(pair[0] == 5000 + 3 * (5000 / 16 + 1));
+}
+
+TEST_CASE("event should release every waiter", "[sync]") {
+  kb_event      event = {};
+  kb_atomic_u32 woken = {};
+
+  std::thread signaler([&]() { kb_event_signal(&event); });
+
+  run_threads(3, [&](uint32_t) {
+    kb_event_wait(&event);
+    kb_atomic_fetch_add_u32(&woken, 1);
+  });
+
+  signaler.join();
+
+  REQUIRE(kb_atomic_load_u32(&woken) == 3);
+  REQUIRE(kb_event_is_signaled(&event));
+
+  // Already signaled, returns right away
+  kb_event_wait(&event);
+}
+
+// Waits may return early, and without a native futex any wake in the process
+// does so. Callers loop on their own word and only leave once it changes.
+TEST_CASE("futex waiters should recheck their word after unrelated wakes", "[sync]") {
+  kb_atomic_u32 word  = {};
+  kb_atomic_u32 other = {};
+  kb_atomic_u32 done  = {};
+
+  std::thread waiter([&]() {
+    while (kb_atomic_load_u32(&word) == 0) {
+      kb_futex_wait(&word, 0);
+    }
+    kb_atomic_store_u32(&done, 1);
+  });
+
+  for (uint32_t i = 0; i < 1000; ++i) {
+    kb_futex_wake_all(&other);
+    if (i % 100 == 0) std::this_thread::yield();
+  }
+
+  REQUIRE(kb_atomic_load_u32(&done) == 0);
+
+  // A mismatched expected value returns right away
+  kb_futex_wait(&other, 1);
+
+  kb_atomic_store_u32(&word, 1);
+  kb_futex_wake(&word, 1);
+
+  waiter.join();
+
+  REQUIRE(kb_atomic_load_u32(&done) == 1);
+}
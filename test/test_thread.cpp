@@ -0,0 +1,530 @@
+#include <catch.hpp>
+
+#include <kb/foundation/thread.h>
+#include <kb/foundation/crt.h>
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+static void increment_job(void* userdata) {
+  ((std::atomic<uint32_t>*) userdata)->fetch_add(1);
+}
+
+TEST_CASE("threadpool should run every added job before wait returns", "[thread]") {
+  kb_thread_pool* pool = kb_threadpool_create(4);
+
+  std::atomic<uint32_t> counter { 0 };
+
+  for (uint32_t i = 0; i < 10000; ++i) {
+    REQUIRE(kb_threadpool_add_job(pool, &counter, increment_job) == 0);
+  }
+
+  kb_threadpool_wait(pool);
+
+  REQUIRE(counter == 10000);
+  REQUIRE(kb_threadpool_queue_length(pool) == 0);
+
+  kb_threadpool_destroy(pool);
+}
+
+struct spawn_ctx {
+  kb_thread_pool*       pool;
+  std::atomic<uint32_t> counter;
+};
+
+static void spawn_job(void* userdata) {
+  spawn_ctx* ctx = (spawn_ctx*) userdata;
+
+  for (uint32_t i = 0; i < 100; ++i) {
+    kb_threadpool_add_job(ctx->pool, &ctx->counter, increment_job);
+  }
+}
+
+TEST_CASE("threadpool jobs should be able to add jobs", "[thread]") {
+  spawn_ctx ctx;
+  ctx.pool    = kb_threadpool_create(3);
+  ctx.counter = 0;
+
+  for (uint32_t i = 0; i < 50; ++i) {
+    kb_threadpool_add_job(ctx.pool, &ctx, spawn_job);
+  }
+
+  kb_threadpool_wait(ctx.pool);
+
+  REQUIRE(ctx.counter == 5000);
+
+  kb_threadpool_destroy(ctx.pool);
+}
+
+TEST_CASE("threadpool without threads should run jobs on wait", "[thread]") {
+  kb_thread_pool* pool = kb_threadpool_create(0);
+
+  std::atomic<uint32_t> counter { 0 };
+  kb_threadpool_add_job(pool, &counter, increment_job);
+  kb_threadpool_wait(pool);
+
+  REQUIRE(counter == 1);
+
+  kb_threadpool_destroy(pool);
+}
+
+TEST_CASE("job wait should return once counted jobs are done", "[thread]") {
+  kb_thread_pool* pool = kb_threadpool_create(3);
+
+  std::atomic<uint32_t> counter { 0 };
+  kb_job_counter        jobs    = {};
+
+  for (uint32_t i = 0; i < 1000; ++i) {
+    kb_threadpool_add_counted_job(pool, &counter, increment_job, &jobs);
+  }
+
+  kb_job_wait(pool, &jobs);
+
+  REQUIRE(counter == 1000);
+  REQUIRE(kb_job_counter_done(&jobs));
+
+  kb_threadpool_destroy(pool);
+}
+
+struct stage_ctx {
+  std::atomic<uint32_t> first;
+  std::atomic<uint32_t> second_saw;
+};
+
+static void first_stage_job(void* userdata) {
+  ((stage_ctx*) userdata)->first.fetch_add(1);
+}
+
+static void second_stage_job(void* userdata) {
+  stage_ctx* ctx = (stage_ctx*) userdata;
+  ctx->second_saw = ctx->first.load();
+}
+
+TEST_CASE("continuations should run after their dependency", "[thread]") {
+  kb_thread_pool* pool = kb_threadpool_create(3);
+
+  stage_ctx ctx;
+  ctx.first       = 0;
+  ctx.second_saw  = 0;
+
+  kb_job_counter first  = {};
+  kb_job_counter second = {};
+
+  for (uint32_t i = 0; i < 100; ++i) {
+    kb_threadpool_add_counted_job(pool, &ctx, first_stage_job, &first);
+  }
+
+  kb_job_then(pool, &first, &ctx, second_stage_job, &second);
+  kb_job_wait(pool, &second);
+
+  REQUIRE(ctx.second_saw == 100);
+
+  // Dependency already done, continuation runs right away
+  kb_job_then(pool, &first, &ctx, second_stage_job, &second);
+  kb_job_wait(pool, &second);
+
+  REQUIRE(ctx.second_saw == 100);
+
+  kb_threadpool_destroy(pool);
+}
+
+struct nested_ctx {
+  kb_thread_pool*       pool;
+  std::atomic<uint32_t> counter;
+};
+
+static void nested_wait_job(void* userdata) {
+  nested_ctx* ctx = (nested_ctx*) userdata;
+
+  kb_job_counter children = {};
+
+  for (uint32_t i = 0; i < 100; ++i) {
+    kb_threadpool_add_counted_job(ctx->pool, &ctx->counter, increment_job, &children);
+  }
+
+  kb_job_wait(ctx->pool, &children);
+}
+
+TEST_CASE("jobs should be able to wait on their own counters", "[thread]") {
+  nested_ctx ctx;
+  ctx.pool    = kb_threadpool_create(3);
+  ctx.counter = 0;
+
+  kb_job_counter parents = {};
+
+  for (uint32_t i = 0; i < 50; ++i) {
+    kb_threadpool_add_counted_job(ctx.pool, &ctx, nested_wait_job, &parents);
+  }
+
+  kb_job_wait(ctx.pool, &parents);
+
+  REQUIRE(ctx.counter == 5000);
+
+  kb_threadpool_destroy(ctx.pool);
+}
+
+TEST_CASE("threadpool should run a batch of added jobs", "[thread]") {
+  kb_thread_pool* pool = kb_threadpool_create(3);
+
+  std::atomic<uint32_t> counter { 0 };
+  kb_job_counter        batch   = {};
+
+  kb_job_info jobs[1000];
+  for (uint32_t i = 0; i < 1000; ++i) {
+    jobs[i].func      = increment_job;
+    jobs[i].userdata  = &counter;
+    jobs[i].priority  = i % 2 ? KB_JOB_PRIORITY_HIGH : KB_JOB_PRIORITY_NORMAL;
+  }
+
+  // Second round runs on recycled descriptors
+  for (uint32_t round = 0; round < 2; ++round) {
+    REQUIRE(kb_threadpool_add_counted_jobs(pool, jobs, 1000, &batch) == 0);
+    kb_job_wait(pool, &batch);
+  }
+
+  REQUIRE(counter == 2000);
+  REQUIRE(kb_threadpool_add_jobs(pool, jobs, 0) == 0);
+
+  kb_threadpool_destroy(pool);
+}
+
+TEST_CASE("paused threadpool should not start jobs until resumed", "[thread]") {
+  kb_thread_pool* pool = kb_threadpool_create(2);
+
+  std::atomic<uint32_t> counter { 0 };
+
+  kb_threadpool_pause(pool);
+  kb_threadpool_add_job(pool, &counter, increment_job);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  REQUIRE(counter == 0);
+
+  kb_threadpool_resume(pool);
+  kb_threadpool_wait(pool);
+
+  REQUIRE(counter == 1);
+
+  kb_threadpool_destroy(pool);
+}
+
+struct priority_ctx {
+  std::atomic<uint32_t> high_done;
+  std::atomic<uint32_t> low_saw_pending_high;
+};
+
+static void high_priority_job(void* userdata) {
+  ((priority_ctx*) userdata)->high_done.fetch_add(1);
+}
+
+static void low_priority_job(void* userdata) {
+  priority_ctx* ctx = (priority_ctx*) userdata;
+  if (ctx->high_done != 100) ctx->low_saw_pending_high.fetch_add(1);
+}
+
+TEST_CASE("high priority jobs should run before background jobs", "[thread]") {
+  kb_thread_pool* pool = kb_threadpool_create(1);
+
+  priority_ctx ctx;
+  ctx.high_done             = 0;
+  ctx.low_saw_pending_high  = 0;
+
+  kb_job_counter jobs = {};
+
+  // Queue everything up front so the single worker has to pick
+  kb_threadpool_pause(pool);
+
+  for (uint32_t i = 0; i < 100; ++i) {
+    kb_threadpool_add_prioritized_job(pool, &ctx, low_priority_job, KB_JOB_PRIORITY_LOW, &jobs);
+    kb_threadpool_add_prioritized_job(pool, &ctx, high_priority_job, KB_JOB_PRIORITY_HIGH, &jobs);
+  }
+
+  kb_threadpool_resume(pool);
+
+  // Poll instead of helping so only the worker runs jobs
+  while (!kb_job_counter_done(&jobs)) {
+    std::this_thread::yield();
+  }
+
+  REQUIRE(ctx.high_done == 100);
+  REQUIRE(ctx.low_saw_pending_high == 0);
+
+  kb_threadpool_destroy(pool);
+}
+
+struct fiber_ctx {
+  kb_thread_pool*       pool;
+  kb_job_counter        io;
+  std::atomic<uint32_t> resumed;
+  std::atomic<uint32_t> on_fiber;
+};
+
+static void fiber_wait_job(void* userdata) {
+  fiber_ctx* ctx = (fiber_ctx*) userdata;
+
+  if (kb_fiber_is_current()) ctx->on_fiber.fetch_add(1);
+
+  kb_fiber_wait(ctx->pool, &ctx->io);
+  ctx->resumed.fetch_add(1);
+}
+
+TEST_CASE("suspended fiber jobs should not block their worker", "[thread]") {
+  fiber_ctx ctx;
+  ctx.pool      = kb_threadpool_create(1);
+  ctx.io        = {};
+  ctx.resumed   = 0;
+  ctx.on_fiber  = 0;
+
+  std::atomic<uint32_t> other { 0 };
+
+  // Pending I/O completed by this thread later
+  kb_job_counter_add(&ctx.io, 1);
+
+  for (uint32_t i = 0; i < 4; ++i) {
+    kb_threadpool_add_fiber_job(ctx.pool, &ctx, fiber_wait_job, KB_JOB_PRIORITY_NORMAL, NULL);
+  }
+  kb_threadpool_add_job(ctx.pool, &other, increment_job);
+
+  // The single worker gets to the plain job while every fiber is suspended
+  while (other == 0) {
+    std::this_thread::yield();
+  }
+
+  REQUIRE(ctx.resumed == 0);
+
+  kb_job_counter_signal(ctx.pool, &ctx.io);
+  kb_threadpool_wait(ctx.pool);
+
+  REQUIRE(ctx.resumed == 4);
+
+  // Without fibers the waits nest on the worker's stack instead
+#if KB_PLATFORM_LINUX
+  REQUIRE(ctx.on_fiber == 4);
+#else
+  REQUIRE(ctx.on_fiber == 0);
+#endif
+
+  kb_threadpool_destroy(ctx.pool);
+}
+
+struct fiber_spawn_ctx {
+  kb_thread_pool*       pool;
+  std::atomic<uint32_t> counter;
+  std::atomic<uint32_t> complete;
+};
+
+static void fiber_spawn_job(void* userdata) {
+  fiber_spawn_ctx* ctx = (fiber_spawn_ctx*) userdata;
+
+  kb_job_counter children = {};
+
+  for (uint32_t i = 0; i < 50; ++i) {
+    kb_threadpool_add_counted_job(ctx->pool, &ctx->counter, increment_job, &children);
+  }
+
+  kb_fiber_wait(ctx->pool, &children);
+
+  if (kb_job_counter_done(&children)) ctx->complete.fetch_add(1);
+}
+
+TEST_CASE("fiber jobs should resume after their children finish", "[thread]") {
+  fiber_spawn_ctx ctx;
+  ctx.pool      = kb_threadpool_create(3);
+  ctx.counter   = 0;
+  ctx.complete  = 0;
+
+  kb_threadpool_reserve_fibers(ctx.pool, 8);
+
+  kb_job_counter fibers = {};
+
+  for (uint32_t i = 0; i < 100; ++i) {
+    kb_threadpool_add_fiber_job(ctx.pool, &ctx, fiber_spawn_job, KB_JOB_PRIORITY_NORMAL, &fibers);
+  }
+
+  kb_job_wait(ctx.pool, &fibers);
+
+  REQUIRE(ctx.counter == 5000);
+  REQUIRE(ctx.complete == 100);
+
+  kb_threadpool_destroy(ctx.pool);
+}
+
+struct fiber_nested_ctx {
+  kb_thread_pool*       pool;
+  kb_job_counter        gate;
+  std::atomic<uint32_t> depth;
+  std::atomic<uint32_t> max_depth;
+  std::atomic<uint32_t> resumed;
+  std::atomic<uint32_t> not_fiber;
+};
+
+static void fiber_nested_job(void* userdata) {
+  fiber_nested_ctx* ctx = (fiber_nested_ctx*) userdata;
+
+  if (!kb_fiber_is_current()) ctx->not_fiber.fetch_add(1);
+
+  uint32_t depth = ctx->depth.fetch_add(1) + 1;
+  if (depth > ctx->max_depth) ctx->max_depth = depth;
+
+  kb_fiber_wait(ctx->pool, &ctx->gate);
+
+  ctx->depth.fetch_sub(1);
+  ctx->resumed.fetch_add(1);
+}
+
+static void fiber_gate_job(void* userdata) {
+  fiber_nested_ctx* ctx = (fiber_nested_ctx*) userdata;
+
+  kb_job_counter_signal(ctx->pool, &ctx->gate);
+}
+
+// Outside a fiber job kb_fiber_wait takes the same path every fiber wait
+// takes without fiber support, the waits nest on the waiting thread's stack
+TEST_CASE("fiber wait without a fiber should run other jobs nested", "[thread]") {
+  fiber_nested_ctx ctx;
+  ctx.pool      = kb_threadpool_create(0);
+  ctx.gate      = {};
+  ctx.depth     = 0;
+  ctx.max_depth = 0;
+  ctx.resumed   = 0;
+  ctx.not_fiber = 0;
+
+  kb_job_counter_add(&ctx.gate, 1);
+
+  for (uint32_t i = 0; i < 3; ++i) {
+    kb_threadpool_add_job(ctx.pool, &ctx, fiber_nested_job);
+  }
+  kb_threadpool_add_job(ctx.pool, &ctx, fiber_gate_job);
+
+  // Without workers every job runs on this thread, inside the first wait
+  kb_threadpool_wait(ctx.pool);
+
+  REQUIRE(ctx.resumed == 3);
+  REQUIRE(ctx.not_fiber == 3);
+  REQUIRE(ctx.max_depth == 3);
+
+  kb_threadpool_destroy(ctx.pool);
+}
+
+struct tls_ctx {
+  kb_tls_slot           slot;
+  std::atomic<uint32_t> bad_index;
+};
+
+static void tls_accumulate_job(void* userdata) {
+  tls_ctx* ctx = (tls_ctx*) userdata;
+
+  uint32_t* value = (uint32_t*) kb_tls_get(ctx->slot);
+  if (value == NULL) {
+    value = new uint32_t(0);
+    kb_tls_set(ctx->slot, value);
+  }
+  (*value)++;
+
+  if (kb_thread_index() >= kb_thread_count()) ctx->bad_index.fetch_add(1);
+}
+
+TEST_CASE("tls slots should accumulate per thread without locking", "[thread]") {
+  const uint32_t main_index = kb_thread_index();
+  REQUIRE(main_index < kb_thread_count());
+
+  kb_thread_pool* pool = kb_threadpool_create(3);
+
+  tls_ctx ctx;
+  ctx.slot      = kb_tls_alloc();
+  ctx.bad_index = 0;
+
+  kb_job_counter jobs = {};
+  for (uint32_t i = 0; i < 1000; ++i) {
+    kb_threadpool_add_counted_job(pool, &ctx, tls_accumulate_job, &jobs);
+  }
+  kb_job_wait(pool, &jobs);
+
+  REQUIRE(kb_thread_count() >= 4);
+  REQUIRE(ctx.bad_index == 0);
+  REQUIRE(kb_thread_index() == main_index);
+
+  // Gather from every thread
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < kb_thread_count(); ++i) {
+    uint32_t* value = (uint32_t*) kb_tls_get_thread(ctx.slot, i);
+    if (value) {
+      total += *value;
+      delete value;
+    }
+  }
+
+  REQUIRE(total == 1000);
+
+  kb_tls_free(ctx.slot);
+  kb_threadpool_destroy(pool);
+}
+
+static void* thread_index_main(void* userdata) {
+  *(uint32_t*) userdata = kb_thread_index();
+  return NULL;
+}
+
+TEST_CASE("threads from kb_thread_create should give their index back", "[thread]") {
+  const uint32_t main_index = kb_thread_index();
+
+  // Several times more threads than there are indices, one at a time
+  uint32_t highest = 0;
+  for (uint32_t i = 0; i < KB_MAX_THREADS * 3; ++i) {
+    uint32_t index = UINT32_MAX;
+
+    kb_thread* thread = kb_thread_create(thread_index_main, &index);
+    kb_thread_join(thread);
+    kb_thread_destroy(thread);
+
+    REQUIRE(index < KB_MAX_THREADS);
+    REQUIRE(index != main_index);
+    highest = index > highest ? index : highest;
+  }
+
+  REQUIRE(highest < KB_MAX_THREADS / 2);
+  REQUIRE(kb_thread_index() == main_index);
+}
+
+static void locked_increment_job(void* userdata) {
+  static kb_mutex* mutex = kb_mutex_create_named("test.profiled");
+
+  kb_mutex_lock(mutex);
+  ++*(uint32_t*) userdata;
+  kb_mutex_unlock(mutex);
+}
+
+TEST_CASE("lock profile should count acquisitions per lock name", "[thread]") {
+  kb_lock_profile_reset();
+
+  kb_thread_pool* pool = kb_threadpool_create(4);
+
+  uint32_t value = 0;
+  kb_job_counter jobs = {};
+  for (uint32_t i = 0; i < 1000; ++i) {
+    kb_threadpool_add_counted_job(pool, &value, locked_increment_job, &jobs);
+  }
+  kb_job_wait(pool, &jobs);
+
+  REQUIRE(value == 1000);
+
+  kb_lock_stats stats[128];
+  uint32_t count = kb_lock_profile_report(stats, 128);
+
+#if KB_CONFIG_LOCK_PROFILE
+  const kb_lock_stats* found = NULL;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (kb_strcmp(stats[i].name, "test.profiled") == 0) found = &stats[i];
+  }
+
+  REQUIRE(found != NULL);
+  REQUIRE(found->acquisitions == 1000);
+  REQUIRE(found->contended <= found->acquisitions);
+  REQUIRE(found->wait_max_ns <= found->wait_total_ns);
+  REQUIRE(found->hold_max_ns <= found->hold_total_ns);
+#else
+  REQUIRE(count == 0);
+#endif
+
+  kb_threadpool_destroy(pool);
+}
@@ -0,0 +1,108 @@
+#include <catch.hpp>
+
+#include <kb/foundation/time.h>
+
+#include <thread>
+#include <chrono>
+
+TEST_CASE("monotonic clock should never go backwards and count nanoseconds", "[time]") {
+  REQUIRE(kb_time_get_frequency() == 1000000000LL);
+
+  int64_t prev = kb_time_get_raw();
+  for (uint32_t i = 0; i < 100000; ++i) {
+    int64_t now = kb_time_get_raw();
+    REQUIRE(now >= prev);
+    prev = now;
+  }
+
+  int64_t start = kb_time_get_raw();
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  int64_t elapsed = kb_time_get_raw() - start;
+
+  REQUIRE(elapsed >= 20000000LL);
+  REQUIRE(elapsed <  2000000000LL);
+}
+
+TEST_CASE("fast timer should agree with the monotonic clock", "[time]") {
+  REQUIRE(kb_time_get_fast_frequency() > 0);
+
+  int64_t   clock_start = kb_time_get_raw();
+  uint64_t  fast_start  = kb_time_get_fast();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  uint64_t  fast_end    = kb_time_get_fast();
+  int64_t   clock_end   = kb_time_get_raw();
+
+  int64_t clock_ns  = clock_end - clock_start;
+  int64_t fast_ns   = kb_time_fast_to_ns(fast_end - fast_start);
+
+  // Calibration error plus the reads not being simultaneous
+  REQUIRE(fast_ns > clock_ns * 9 / 10);
+  REQUIRE(fast_ns < clock_ns * 11 / 10);
+}
+
+TEST_CASE("frame limiter should pace frames to the interval", "[time]") {
+  kb_frame_limiter limiter;
+  kb_frame_limiter_create(&limiter, 200.0, 64);
+
+  const uint32_t frames = 40;
+
+  int64_t first = kb_frame_limiter_wait(&limiter);
+  int64_t last  = first;
+  for (uint32_t i = 0; i < frames; ++i) {
+    last = kb_frame_limiter_wait(&limiter);
+  }
+
+  // Every frame starts on or after its deadline, so the run can't be short
+  REQUIRE(last - first >= frames * limiter.interval);
+
+  REQUIRE(limiter.error.count == frames);
+  REQUIRE(limiter.error.min >= 0.0f);
+
+  kb_frame_limiter_destroy(&limiter);
+}
+
+// Upper bounds depend on scheduler latency and fail on loaded machines, so
+// this is hidden by default. Run with "[.timing]" on an otherwise idle box.
+TEST_CASE("frame limiter should wake close to its deadlines", "[time][.timing]") {
+  kb_frame_limiter limiter;
+  kb_frame_limiter_create(&limiter, 200.0, 64);
+
+  const uint32_t frames = 40;
+
+  int64_t first = kb_frame_limiter_wait(&limiter);
+  int64_t last  = first;
+  for (uint32_t i = 0; i < frames; ++i) {
+    last = kb_frame_limiter_wait(&limiter);
+  }
+
+  REQUIRE(last - first < frames * limiter.interval * 2);
+  REQUIRE(limiter.error.avg < 1000.0f);
+
+  kb_frame_limiter_destroy(&limiter);
+}
+
+TEST_CASE("frame limiter should restart the schedule after a long frame", "[time]") {
+  kb_frame_limiter limiter;
+  kb_frame_limiter_create(&limiter, 100.0, 16);
+
+  kb_frame_limiter_wait(&limiter);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  // Late frame goes through at once, the next one waits a full interval
+  // instead of catching up
+  int64_t late = kb_frame_limiter_wait(&limiter);
+  int64_t next = kb_frame_limiter_wait(&limiter);
+
+  REQUIRE(next - late >= limiter.interval);
+
+  kb_frame_limiter_set_rate(&limiter, 0.0);
+
+  int64_t start = kb_time_get_raw();
+  for (uint32_t i = 0; i < 100; ++i) {
+    kb_frame_limiter_wait(&limiter);
+  }
+
+  REQUIRE(kb_time_get_raw() - start < 10000000LL);
+
+  kb_frame_limiter_destroy(&limiter);
+}
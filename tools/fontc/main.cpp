@@ -13,12 +13,14 @@
 
 #include <kbextra/cliargs.h>
 #include <kbextra/font.h>
+#include <kbextra/pixel.h>
 
 #include "kb/foundation.cpp"
 #include "kb/log.cpp"
 
 #include "kbextra/cliargs.cpp"
 #include "kbextra/font.cpp"
+#include "kbextra/pixel.cpp"
 
 #include "platform/platform_rwops_stdio.cpp"
 
@@ -227,18 +229,13 @@ int main(int argc, const char* argv[]) {
       if (rects[i].was_packed) {
         // Copy bitmap to atlas
         for (uint32_t y = 0; y < font.info.chars[i].rect.size.y; y++) {
-          for (uint32_t x = 0; x < font.info.chars[i].rect.size.x; x++) {
-            uint32_t i_dst = (rects[i].y + y) * font.atlas_bitmap_width + (rects[i].x + x);
-            i_dst *= channels;
-
-            uint32_t i_src = (y * font.info.chars[i].rect.size.x + x);
-            
-            ((char*) font.atlas_bitmap)[i_dst + 0] = 0xff;
-            ((char*) font.atlas_bitmap)[i_dst + 1] = 0xff;
-            ((char*) font.atlas_bitmap)[i_dst + 2] = 0xff;
-            ((char*) font.atlas_bitmap)[i_dst + 3] = fontchar_data[i][i_src];
-          }
-        } 
+          uint32_t i_dst = ((rects[i].y + y) * font.atlas_bitmap_width + rects[i].x) * channels;
+          uint32_t i_src = y * font.info.chars[i].rect.size.x;
+
+          kb_pixel_r8_to_rgba8_alpha(
+            (uint8_t*) font.atlas_bitmap + i_dst, fontchar_data[i] + i_src, font.info.chars[i].rect.size.x, 0x00FFFFFF
+          );
+        }
 
       } else {
         kb::log_warn("Char {} not packed!", i);
@@ -544,76 +544,41 @@ int main(int argc, const char* argv[]) {
         uint8_t*    prim_vert_data    = KB_DEFAULT_ALLOC_TYPE(uint8_t, prim_index_count * vertex_stride);
         IndexType*  prim_ind_data     = KB_DEFAULT_ALLOC_TYPE(IndexType, prim_index_count);
         
-        uint32_t    prim_vert         = 0;
-        uint32_t    prim_index        = 0;
+        uint32_t*   attrib_indices    = KB_DEFAULT_ALLOC_TYPE(uint32_t, prim_vertex_count);
 
-        for (uint32_t tri_i = prim->first_triangle; tri_i < prim->first_triangle + prim->triangle_count; ++tri_i) {
-          IndexTriangle& tri = vertex_data.triangles.at(tri_i);
+        // Gather one attribute stream at a time into the interleaved vertex data
+        auto gather_attrib = [&](int32_t attrib, const kb_array* src, IndexType VertexIndices::* member) {
+          uint32_t prim_vert = 0;
 
-          for (uint32_t v = 0; v < 3; ++v) {
-            const VertexIndices& vert = tri.vert[v];
+          for (uint32_t tri_i = prim->first_triangle; tri_i < prim->first_triangle + prim->triangle_count; ++tri_i) {
+            IndexTriangle& tri = vertex_data.triangles.at(tri_i);
 
-            if (has_position) {
-              uint32_t idx = vert.position == UINT32_MAX ? 0 : vert.position;
-              uint32_t attrib_size   = kb_vertex_layout_size(&vertex_layout, attrib_position);
-              uint32_t attrib_offset = kb_vertex_layout_offset(&vertex_layout, attrib_position);
-              
-              kb_memcpy_with_stride(prim_vert_data, &vertex_data.positions.at(idx), attrib_size, prim_vert, vertex_stride, attrib_offset);
-            }
-
-            if (has_normal) {
-              uint32_t idx = vert.normal == UINT32_MAX ? 0 : vert.normal;
-              uint32_t attrib_size   = kb_vertex_layout_size(&vertex_layout, attrib_normal);
-              uint32_t attrib_offset = kb_vertex_layout_offset(&vertex_layout, attrib_normal);
-
-              kb_memcpy_with_stride(prim_vert_data, &vertex_data.normals.at(idx), attrib_size, prim_vert, vertex_stride, attrib_offset);
-            }
-            
-            if (has_tangent) {
-              uint32_t idx = vert.tangent == UINT32_MAX ? 0 : vert.tangent;
-              uint32_t attrib_size   = kb_vertex_layout_size(&vertex_layout, attrib_tangent);
-              uint32_t attrib_offset = kb_vertex_layout_offset(&vertex_layout, attrib_tangent);
-
-              kb_memcpy_with_stride(prim_vert_data, &vertex_data.tangents.at(idx), attrib_size, prim_vert, vertex_stride, attrib_offset);
-            }
-
-            if (has_texcoord) {
-              uint32_t idx = vert.texcoords == UINT32_MAX ? 0 : vert.texcoords;
-              uint32_t attrib_size   = kb_vertex_layout_size(&vertex_layout, attrib_texcoord);
-              uint32_t attrib_offset = kb_vertex_layout_offset(&vertex_layout, attrib_texcoord);
-
-              kb_memcpy_with_stride(prim_vert_data, &vertex_data.texcoords.at(idx), attrib_size, prim_vert, vertex_stride, attrib_offset);
+            for (uint32_t v = 0; v < 3; ++v) {
+              IndexType idx = tri.vert[v].*member;
+              attrib_indices[prim_vert++] = idx == UINT32_MAX ? 0 : idx;
             }
-            
-            if (has_color) {
-              uint32_t idx = vert.colors == UINT32_MAX ? 0 : vert.colors;
-              uint32_t attrib_size   = kb_vertex_layout_size(&vertex_layout, attrib_color);
-              uint32_t attrib_offset = kb_vertex_layout_offset(&vertex_layout, attrib_color);
+          }
 
-              kb_memcpy_with_stride(prim_vert_data, &vertex_data.colors.at(idx), attrib_size, prim_vert, vertex_stride, attrib_offset);
-            }
-            
-            if (has_weights) {
-              uint32_t idx = vert.weights == UINT32_MAX ? 0 : vert.weights;
-              uint32_t attrib_size   = kb_vertex_layout_size(&vertex_layout, attrib_weights);
-              uint32_t attrib_offset = kb_vertex_layout_offset(&vertex_layout, attrib_weights);
+          uint32_t attrib_size   = kb_vertex_layout_size(&vertex_layout, attrib);
+          uint32_t attrib_offset = kb_vertex_layout_offset(&vertex_layout, attrib);
 
-              kb_memcpy_with_stride(prim_vert_data, &vertex_data.weights.at(idx), attrib_size, prim_vert, vertex_stride, attrib_offset);
-            }
-            
-            if (has_joints) {
-              uint32_t idx = vert.joints == UINT32_MAX ? 0 : vert.joints;
-              uint32_t attrib_size   = kb_vertex_layout_size(&vertex_layout, attrib_joints);
-              uint32_t attrib_offset = kb_vertex_layout_offset(&vertex_layout, attrib_joints);
+          kb_memcpy_gather(prim_vert_data + attrib_offset, vertex_stride, src->data, src->elem_size, attrib_indices, attrib_size, prim_vertex_count);
+        };
 
-              kb_memcpy_with_stride(prim_vert_data, &vertex_data.joints.at(idx), attrib_size, prim_vert, vertex_stride, attrib_offset);
-            }
+        if (has_position) gather_attrib(attrib_position, &vertex_data.positions, &VertexIndices::position);
+        if (has_normal)   gather_attrib(attrib_normal,   &vertex_data.normals,   &VertexIndices::normal);
+        if (has_tangent)  gather_attrib(attrib_tangent,  &vertex_data.tangents,  &VertexIndices::tangent);
+        if (has_texcoord) gather_attrib(attrib_texcoord, &vertex_data.texcoords, &VertexIndices::texcoords);
+        if (has_color)    gather_attrib(attrib_color,    &vertex_data.colors,    &VertexIndices::colors);
+        if (has_weights)  gather_attrib(attrib_weights,  &vertex_data.weights,   &VertexIndices::weights);
+        if (has_joints)   gather_attrib(attrib_joints,   &vertex_data.joints,    &VertexIndices::joints);
 
-            prim_ind_data[prim_index++] = prim_vert;
-            prim_vert++;
-          }
+        for (uint32_t prim_index = 0; prim_index < prim_index_count; ++prim_index) {
+          prim_ind_data[prim_index] = prim_index;
         }
 
+        KB_DEFAULT_FREE(attrib_indices);
+
         // Optimize primitive
         uint64_t opt_start_time = kb_time_get_raw();
 
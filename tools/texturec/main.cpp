@@ -10,11 +10,13 @@
 #include <kb/foundation/time.h>
 
 #include <kbextra/cliargs.h>
+#include <kbextra/pixel.h>
 
 #include "kb/foundation.cpp"
 
 #include "kbextra/texture.cpp"
 #include "kbextra/cliargs.cpp"
+#include "kbextra/pixel.cpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
@@ -75,6 +77,7 @@ int main(int argc, const char* argv[]) {
   int             tex_height    = 0;
   int             tex_channels  = 0;
   stbi_uc*        pixel_data    = nullptr;
+  uint8_t*        rgba_data     = nullptr;
   uint64_t        data_size     = 0;
   kb_texture_data texture       = {};
   
@@ -110,20 +113,22 @@ int main(int argc, const char* argv[]) {
     goto end;
   }
   
-  // Load
-  pixel_data = stbi_load_from_callbacks(&stb_io_callbacks, rwops_in, &tex_width, &tex_height, &tex_channels, STBI_rgb_alpha);
-  data_size = tex_width * tex_height * STBI_rgb_alpha;
-
+  // Load in source channel count and expand to RGBA ourselves
+  pixel_data = stbi_load_from_callbacks(&stb_io_callbacks, rwops_in, &tex_width, &tex_height, &tex_channels, 0);
   if (!pixel_data) {
     goto end;
   }
+
+  data_size = (uint64_t) tex_width * tex_height * STBI_rgb_alpha;
+  rgba_data = KB_DEFAULT_ALLOC_TYPE(uint8_t, data_size);
+  kb_pixel_expand_rgba8(rgba_data, pixel_data, (uint64_t) tex_width * tex_height, tex_channels);
   
   // Fill info
   texture.header.format = KB_FORMAT_RGBA8_UNORM;
   texture.header.width  = tex_width;
   texture.header.height = tex_height;
   texture.data_size     = data_size;
-  texture.data          = pixel_data;
+  texture.data          = rgba_data;
 
   kb_texture_write(&texture, rwops_out);
     
@@ -131,6 +136,7 @@ int main(int argc, const char* argv[]) {
 
 end:
   stbi_image_free(pixel_data);
+  if (rgba_data) KB_DEFAULT_FREE(rgba_data);
   kb_stream_close(rwops_in);
   kb_stream_close(rwops_out);
 